@@ -0,0 +1,103 @@
+/*
+ * Micro-benchmark for Buffer emit throughput.
+ *
+ * Replays the write pattern of the code generator: mostly single byte
+ * opcodes followed by 1-4 byte operands, with the occasional string. Each
+ * pass writes into a fresh Buffer, so growth and allocation costs are part
+ * of the measurement, same as compiling a script.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "encoding/buffer.h"
+#include "encoding/graalencoding.h"
+
+struct Sample
+{
+	double nanosecondsPerWrite;
+	double megabytesPerSecond;
+};
+
+template<typename Fn>
+Sample measure(int iterations, size_t writesPerPass, Fn&& fn)
+{
+	size_t bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		bytes += fn();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return {
+		elapsed.count() * 1e9 / (double(iterations) * writesPerPass),
+		double(bytes) / (1024.0 * 1024.0) / elapsed.count()
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+	const size_t ops = 100000;
+
+	// Keeps the compiler from discarding the buffers
+	volatile uint8_t sink = 0;
+
+	auto singleBytes = measure(iterations, ops, [&]() {
+		Buffer buf;
+		for (size_t i = 0; i < ops; i++)
+			buf.write(char(i));
+
+		sink = sink + buf.buffer()[buf.length() - 1];
+		return buf.length();
+	});
+
+	// op, 0xF3 prefix, 1 byte operand / op, 0xF4 prefix, 2 byte operand / op
+	auto emitPattern = measure(iterations, ops * 2, [&]() {
+		Buffer buf;
+		for (size_t i = 0; i < ops; i++)
+		{
+			buf.write(char(20));
+			switch (i % 3)
+			{
+				case 0:
+					buf.write(char(0xF3));
+					buf.write(char(i));
+					break;
+
+				case 1:
+					buf.write(char(0xF4));
+					buf.Write<encoding::Int16>(uint16_t(i));
+					break;
+
+				default:
+					buf.write("name", 5);
+					break;
+			}
+		}
+
+		sink = sink + buf.buffer()[buf.length() - 1];
+		return buf.length();
+	});
+
+	// Many small buffers, ex: the empty response of a failed compile or a tiny script
+	auto smallBuffers = measure(iterations, ops, [&]() {
+		size_t bytes = 0;
+		for (size_t i = 0; i < ops / 10; i++)
+		{
+			Buffer buf;
+			for (int j = 0; j < 10; j++)
+				buf.write(char(j));
+
+			Buffer moved(std::move(buf));
+			sink = sink + moved.buffer()[0];
+			bytes += moved.length();
+		}
+		return bytes;
+	});
+
+	printf("%-16s %14s %14s\n", "pattern", "ns/write", "MB/s");
+	printf("%-16s %14.2f %14.1f\n", "single bytes", singleBytes.nanosecondsPerWrite, singleBytes.megabytesPerSecond);
+	printf("%-16s %14.2f %14.1f\n", "emit pattern", emitPattern.nanosecondsPerWrite, emitPattern.megabytesPerSecond);
+	printf("%-16s %14.2f %14.1f\n", "small buffers", smallBuffers.nanosecondsPerWrite, smallBuffers.megabytesPerSecond);
+	return 0;
+}
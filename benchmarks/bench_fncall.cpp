@@ -0,0 +1,109 @@
+/*
+ * Micro-benchmark for function call resolution in the code generator.
+ *
+ * Parses scripts made of call statements once, then repeatedly walks the
+ * AST with GS2CompilerVisitor while counting heap allocations. Comparing a
+ * script against one with twice the call sites gives the allocations and
+ * time spent per call site, independent of the fixed cost of a compile.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "compiler/GS2BuiltInFunctions.h"
+#include "compiler/GS2CompilerVisitor.h"
+#include "parser/Parser.h"
+
+static size_t allocationCount = 0;
+
+void* operator new(std::size_t size)
+{
+	++allocationCount;
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+struct Sample
+{
+	double allocations;
+	double nanoseconds;
+};
+
+/*
+ * Average allocations and time for one code generation pass over the script
+ */
+Sample measure(const std::string& script, int iterations)
+{
+	GS2ErrorService errorService([](GS2CompilerError& err) {
+		fprintf(stderr, "%s\n", err.msg().c_str());
+		std::exit(1);
+	});
+
+	ParserContext parserContext(errorService);
+	if (!parserContext.parse(script))
+		std::exit(1);
+
+	const auto& builtIn = GS2BuiltInFunctions::getBuiltIn();
+	auto root = parserContext.getRootStatement();
+
+	size_t allocations = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		size_t before = allocationCount;
+		GS2CompilerVisitor visitor(parserContext, builtIn);
+		visitor.Visit(root);
+		allocations += allocationCount - before;
+	}
+
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return { double(allocations) / iterations, elapsed.count() / iterations };
+}
+
+std::string makeScript(const char* statement, int count)
+{
+	std::string script = "function onCreated() {\n";
+	for (int i = 0; i < count; i++)
+		script.append("\t").append(statement).append("\n");
+	script.append("}\n");
+	return script;
+}
+
+int main(int argc, char* argv[])
+{
+	const int callSites = 1000;
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+
+	const char* cases[][2] = {
+		{ "builtin", "sin(1);" },
+		{ "script function", "triggerserverfunctionwithalongname(1);" },
+		{ "object builtin", "str.substring(1, 2);" },
+		{ "object function", "this.player.clientrpcwithalongname(1);" },
+	};
+
+	printf("%-16s %14s %14s\n", "call", "allocs/site", "ns/site");
+	for (const auto& [name, statement] : cases)
+	{
+		auto single = measure(makeScript(statement, callSites), iterations);
+		auto twice = measure(makeScript(statement, callSites * 2), iterations);
+
+		printf("%-16s %14.3f %14.1f\n", name,
+			(twice.allocations - single.allocations) / callSites,
+			(twice.nanoseconds - single.nanoseconds) / callSites);
+	}
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Lexer throughput over the test script corpus.
+ *
+ * Tokenizes every script with the hand-written lexer, and with the flex
+ * scanner unless the library was configured without it. Both run through
+ * the same ParserContext so interning the identifiers and strings costs the
+ * same, the difference is the scanning itself.
+ *
+ * Usage: bench_lexer [iterations] [scripts dir]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+#include "gs2parser.tab.hh"
+#include "GS2Lexer.h"
+#ifndef GS2PARSER_HANDWRITTEN_LEXER
+#include "lex.yy.h"
+#endif
+
+#ifndef GS2BENCH_SCRIPTS_DIR
+#define GS2BENCH_SCRIPTS_DIR "tests/scripts"
+#endif
+
+int yylex(YYSTYPE *yylvalp, YYLTYPE *yyllocp, class ParserContext *parser, yyscan_t scanner);
+
+struct Sample
+{
+	double megabytesPerSecond;
+	double nanosecondsPerToken;
+};
+
+// Scripts followed by the two null bytes flex expects
+std::vector<std::string> loadScripts(const std::filesystem::path& dir)
+{
+	std::vector<std::string> scripts;
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(dir, ec))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".gs2")
+			continue;
+
+		std::ifstream file(entry.path(), std::ios::binary);
+		std::string source(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+		source.append(2, '\0');
+		scripts.push_back(std::move(source));
+	}
+
+	return scripts;
+}
+
+template<typename Fn>
+Sample measure(int iterations, size_t bytes, Fn&& fn)
+{
+	size_t tokens = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		tokens += fn();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return {
+		double(bytes) * iterations / (1024.0 * 1024.0) / elapsed.count(),
+		elapsed.count() * 1e9 / double(tokens)
+	};
+}
+
+int main(int argc, char *argv[])
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+	auto scripts = loadScripts(argc > 2 ? argv[2] : GS2BENCH_SCRIPTS_DIR);
+	if (scripts.empty())
+	{
+		fprintf(stderr, "No scripts found\n");
+		return 1;
+	}
+
+	size_t bytes = 0;
+	for (const auto& script : scripts)
+		bytes += script.length() - 2;
+
+	GS2ErrorService errorService;
+	ParserContext context(errorService);
+	YYSTYPE yylval;
+	YYLTYPE yylloc;
+
+	GS2Lexer lexer(&context);
+	auto handwritten = measure(iterations, bytes, [&]() {
+		size_t tokens = 0;
+		for (const auto& script : scripts)
+		{
+			context.lineNumber = 1;
+			context.columnNumber = 0;
+
+			lexer.setInput(script.data(), script.length() - 2);
+			while (lexer.lex(&yylval, &yylloc))
+				tokens++;
+		}
+		return tokens;
+	});
+
+	printf("%zu scripts, %.1f KB\n", scripts.size(), double(bytes) / 1024.0);
+	printf("%-12s %14s %14s\n", "lexer", "MB/s", "ns/token");
+	printf("%-12s %14.1f %14.2f\n", "GS2Lexer", handwritten.megabytesPerSecond, handwritten.nanosecondsPerToken);
+
+#ifndef GS2PARSER_HANDWRITTEN_LEXER
+	yyscan_t scanner;
+	yylex_init_extra(&context, &scanner);
+
+	auto flex = measure(iterations, bytes, [&]() {
+		size_t tokens = 0;
+		for (auto& script : scripts)
+		{
+			context.lineNumber = 1;
+			context.columnNumber = 0;
+
+			auto buffer = yy_scan_buffer(script.data(), script.length(), scanner);
+			while (yylex(&yylval, &yylloc, &context, scanner))
+				tokens++;
+
+			yy_delete_buffer(buffer, scanner);
+		}
+		return tokens;
+	});
+
+	yylex_destroy(scanner);
+
+	// flex echoes the characters no rule matches, start on a new line
+	printf("\n%-12s %14.1f %14.2f\n", "flex", flex.megabytesPerSecond, flex.nanosecondsPerToken);
+#endif
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Throughput and latency of the compile server over the test script corpus.
+ *
+ * Starts a CompileServer on a temporary socket in-process, then has every
+ * connection send its share of the requests with up to `depth` of them in
+ * flight, for no pipelining and for deep pipelining. As a reference, the same
+ * requests are compiled with a new GS2Context per script, which is what
+ * calling the compiler per script without keeping a context around costs.
+ *
+ * Usage: bench_server [requests] [connections] [jobs] [scripts dir]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "compiler/GS2Context.h"
+#include "server/CompileServer.h"
+
+#ifndef GS2BENCH_SCRIPTS_DIR
+#define GS2BENCH_SCRIPTS_DIR "tests/scripts"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::string> loadScripts(const std::filesystem::path& dir)
+{
+	std::vector<std::string> scripts;
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(dir, ec))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".gs2")
+			continue;
+
+		std::ifstream file(entry.path(), std::ios::binary);
+		scripts.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+	}
+
+	return scripts;
+}
+
+double percentile(std::vector<double>& samples, double pct)
+{
+	std::sort(samples.begin(), samples.end());
+	auto idx = size_t(pct / 100.0 * double(samples.size()) + 0.5);
+	return samples[std::clamp<size_t>(idx, 1, samples.size()) - 1];
+}
+
+bool sendAll(int fd, const uint8_t *data, size_t length)
+{
+	while (length)
+	{
+		auto sent = send(fd, data, length, 0);
+		if (sent <= 0)
+			return false;
+		data += sent;
+		length -= size_t(sent);
+	}
+	return true;
+}
+
+bool recvAll(int fd, uint8_t *data, size_t length)
+{
+	while (length)
+	{
+		auto received = recv(fd, data, length, 0);
+		if (received <= 0)
+			return false;
+		data += received;
+		length -= size_t(received);
+	}
+	return true;
+}
+
+/*
+ * Sends requests [first, last) over one connection, keeping up to `depth`
+ * of them in flight, and records the latency of each one in microseconds
+ */
+bool runClient(const std::filesystem::path& socketPath, const std::vector<std::string>& scripts, uint32_t first, uint32_t last,
+	size_t depth, std::vector<double>& latencies)
+{
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+
+	if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	std::vector<Clock::time_point> sentAt(last - first);
+	std::vector<uint8_t> frame;
+	uint8_t header[protocol::FRAME_HEADER_LENGTH];
+	std::vector<uint8_t> payload;
+	protocol::CompileResult result;
+
+	bool ok = true;
+	uint32_t next = first;
+	uint32_t received = 0;
+	while (ok && received < last - first)
+	{
+		if (next < last && next - first - received < depth)
+		{
+			frame.clear();
+			protocol::WriteRequest(frame, { next, false, {}, {}, scripts[next % scripts.size()] });
+			sentAt[next - first] = Clock::now();
+			ok = sendAll(fd, frame.data(), frame.size());
+			++next;
+			continue;
+		}
+
+		ok = recvAll(fd, header, sizeof(header));
+		payload.resize(ok ? protocol::FrameLength(header) : 0);
+		ok = ok && recvAll(fd, payload.data(), payload.size()) && protocol::ReadResponse(payload.data(), payload.size(), result);
+		if (ok)
+		{
+			std::chrono::duration<double, std::micro> latency = Clock::now() - sentAt[result.id - first];
+			latencies.push_back(latency.count());
+			++received;
+		}
+	}
+
+	close(fd);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const uint32_t requests = argc > 1 ? uint32_t(std::atoi(argv[1])) : 20000;
+	const int connections = argc > 2 ? std::atoi(argv[2]) : 4;
+	const int jobs = argc > 3 ? std::atoi(argv[3]) : int(std::max(1u, std::thread::hardware_concurrency()));
+	auto scripts = loadScripts(argc > 4 ? argv[4] : GS2BENCH_SCRIPTS_DIR);
+	if (scripts.empty())
+	{
+		fprintf(stderr, "No scripts found\n");
+		return 1;
+	}
+
+	if (connections < 1 || jobs < 1)
+	{
+		fprintf(stderr, "Usage: bench_server [requests] [connections] [jobs] [scripts dir]\n");
+		return 1;
+	}
+
+	printf("%u requests over %zu scripts, %d connections, %d workers\n\n", requests, scripts.size(), connections, jobs);
+
+	// Reference: a context is created for every script
+	{
+		auto start = Clock::now();
+		for (uint32_t i = 0; i < requests; i++)
+		{
+			GS2Context context;
+			context.compile(scripts[i % scripts.size()]);
+		}
+
+		std::chrono::duration<double> elapsed = Clock::now() - start;
+		printf("new context per script  %10.0f req/s  %8.1f us mean\n", requests / elapsed.count(), elapsed.count() * 1e6 / requests);
+	}
+
+	auto socketPath = std::filesystem::temp_directory_path() / ("bench_server_" + std::to_string(getpid()) + ".sock");
+	CompileServer server(socketPath, jobs, {});
+
+	std::string error;
+	if (!server.listen(error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	std::thread serverThread(&CompileServer::run, &server);
+
+	bool ok = true;
+	for (size_t depth : { size_t(1), size_t(16) })
+	{
+		std::vector<std::vector<double>> latencies(connections);
+		std::vector<std::thread> clients;
+		std::vector<char> results(connections);
+
+		auto start = Clock::now();
+		for (int c = 0; c < connections; c++)
+		{
+			uint32_t first = uint32_t(uint64_t(requests) * c / connections);
+			uint32_t last = uint32_t(uint64_t(requests) * (c + 1) / connections);
+			clients.emplace_back([&, c, first, last]() {
+				results[c] = runClient(socketPath, scripts, first, last, depth, latencies[c]);
+			});
+		}
+
+		for (auto& client : clients)
+			client.join();
+
+		std::chrono::duration<double> elapsed = Clock::now() - start;
+
+		std::vector<double> all;
+		for (int c = 0; c < connections; c++)
+		{
+			ok = ok && results[c];
+			all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+		}
+
+		if (!ok)
+		{
+			fprintf(stderr, "Request failed\n");
+			break;
+		}
+
+		printf("server, depth %-3zu       %10.0f req/s  %8.1f us p50  %8.1f us p99\n", depth,
+			requests / elapsed.count(), percentile(all, 50), percentile(all, 99));
+	}
+
+	server.stop();
+	serverThread.join();
+	return ok ? 0 : 1;
+}
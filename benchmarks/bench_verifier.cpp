@@ -0,0 +1,120 @@
+/*
+ * Cost of the bytecode verifier over the test script corpus.
+ *
+ * Compiles every script once, then times the verifier alone over the
+ * resulting bytecode, and compiles the corpus with and without
+ * GS2CompilerOptions::verify to show what it adds to a compile.
+ *
+ * Usage: bench_verifier [iterations] [scripts dir]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "compiler/GS2Context.h"
+#include "GS2BytecodeVerifier.h"
+
+#ifndef GS2BENCH_SCRIPTS_DIR
+#define GS2BENCH_SCRIPTS_DIR "tests/scripts"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::string> loadScripts(const std::filesystem::path& dir)
+{
+	std::vector<std::string> scripts;
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(dir, ec))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".gs2")
+			continue;
+
+		std::ifstream file(entry.path(), std::ios::binary);
+		scripts.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+	}
+
+	return scripts;
+}
+
+template<typename Fn>
+double measure(int iterations, Fn&& fn)
+{
+	auto start = Clock::now();
+	for (int i = 0; i < iterations; i++)
+		fn();
+
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+	return elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+	auto scripts = loadScripts(argc > 2 ? argv[2] : GS2BENCH_SCRIPTS_DIR);
+	if (scripts.empty())
+	{
+		fprintf(stderr, "No scripts found\n");
+		return 1;
+	}
+
+	GS2Context context;
+	std::vector<Buffer> outputs;
+	size_t bytes = 0;
+	for (const auto& script : scripts)
+	{
+		auto response = context.compile(script);
+		if (!response.success)
+			continue;
+
+		bytes += response.bytecode.length();
+		outputs.push_back(std::move(response.bytecode));
+	}
+
+	size_t failures = 0;
+	GS2ErrorService errorService([&](GS2CompilerError& error) {
+		fprintf(stderr, "%s\n", error.msg().c_str());
+		++failures;
+	});
+
+	GS2BytecodeVerifier verifier(errorService);
+	auto verifySeconds = measure(iterations, [&]() {
+		for (const auto& bytecode : outputs)
+			verifier.verify(bytecode);
+	});
+
+	if (failures)
+	{
+		fprintf(stderr, "%zu scripts failed verification\n", failures / size_t(iterations));
+		return 1;
+	}
+
+	auto compile = [&](bool verify) {
+		GS2CompilerOptions options;
+		options.verify = verify;
+		context.setOptions(options);
+
+		return measure(iterations, [&]() {
+			for (const auto& script : scripts)
+				context.compile(script);
+		});
+	};
+
+	auto compileSeconds = compile(false);
+	auto compileVerifiedSeconds = compile(true);
+
+	double megabytes = double(bytes) * iterations / (1024.0 * 1024.0);
+	printf("%zu scripts, %.1f KB of bytecode\n\n", outputs.size(), double(bytes) / 1024.0);
+	printf("verifier          %10.1f MB/s  %10.1f us per MB of bytecode\n", megabytes / verifySeconds, verifySeconds * 1e6 / megabytes);
+	printf("compile           %10.1f us per MB of bytecode\n", compileSeconds * 1e6 / megabytes);
+	printf("compile + verify  %10.1f us per MB of bytecode (%+.2f%%)\n", compileVerifiedSeconds * 1e6 / megabytes,
+		(compileVerifiedSeconds / compileSeconds - 1.0) * 100.0);
+
+	return 0;
+}
@@ -0,0 +1,382 @@
+/*
+ * Compile throughput benchmark over the test script corpus.
+ *
+ * Every script is loaded into memory up front and compiled repeatedly
+ * in-process, so unlike the regression runner the numbers don't include
+ * process startup or file IO. Reports throughput, per-script latency
+ * percentiles for the whole compile and each phase, and how throughput
+ * scales when compiling on multiple threads (one GS2Context per thread).
+ *
+ * Results can be written as JSON with --json, to compare between releases.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "compiler/GS2Context.h"
+
+#ifndef GS2BENCH_SCRIPTS_DIR
+#define GS2BENCH_SCRIPTS_DIR "tests/scripts"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+struct Arguments
+{
+	std::filesystem::path scriptsDir = GS2BENCH_SCRIPTS_DIR;
+	std::filesystem::path jsonPath;
+	int iterations = 10;
+	int maxThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	bool optimize = false;
+};
+
+struct Script
+{
+	std::string name;
+	std::string source;
+};
+
+/*
+ * Latency percentiles of a single measurement, in nanoseconds
+ */
+struct Percentiles
+{
+	double p50 = 0;
+	double p99 = 0;
+	double mean = 0;
+};
+
+struct ScalingResult
+{
+	int threads;
+	double seconds;
+	double scriptsPerSecond;
+	double megabytesPerSecond;
+};
+
+struct BenchResult
+{
+	size_t scriptCount = 0;
+	size_t corpusBytes = 0;
+	size_t failedScripts = 0;
+	size_t compiles = 0;
+	double seconds = 0;
+
+	Percentiles total;
+	Percentiles parse;
+	Percentiles fold;
+	Percentiles codegen;
+	Percentiles serialize;
+
+	std::vector<ScalingResult> scaling;
+};
+
+constexpr const char* HELP_TEXT = R"(
+GS2 Compiler Benchmark
+
+Usage:
+  %s [OPTIONS]
+
+Options:
+  --scripts DIR      Directory of .gs2 scripts, searched recursively (default: %s)
+  -n, --iterations N Number of times every script is compiled (default: 10)
+  -j, --threads N    Highest thread count for the scaling runs (default: hardware threads)
+  -O, --optimize     Enable bytecode optimizations
+  --json FILE        Also write the results as JSON to FILE
+  -h, --help         Show this help message
+)";
+
+bool parseInt(std::string_view str, int& out)
+{
+	auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+	return ec == std::errc() && ptr == str.data() + str.size() && out > 0;
+}
+
+bool parseArguments(int argc, const char* argv[], Arguments& args)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--help" || arg == "-h")
+		{
+			printf(HELP_TEXT, argv[0], GS2BENCH_SCRIPTS_DIR);
+			std::exit(0);
+		}
+		else if (arg == "--optimize" || arg == "-O")
+			args.optimize = true;
+		else if (arg == "--scripts" && hasValue)
+			args.scriptsDir = argv[++i];
+		else if (arg == "--json" && hasValue)
+			args.jsonPath = argv[++i];
+		else if ((arg == "--iterations" || arg == "-n") && hasValue)
+		{
+			if (!parseInt(argv[++i], args.iterations))
+				return false;
+		}
+		else if ((arg == "--threads" || arg == "-j") && hasValue)
+		{
+			if (!parseInt(argv[++i], args.maxThreads))
+				return false;
+		}
+		else
+			return false;
+	}
+
+	return true;
+}
+
+std::vector<Script> loadScripts(const std::filesystem::path& dir)
+{
+	std::vector<Script> scripts;
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(dir, ec))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".gs2")
+			continue;
+
+		std::ifstream file(entry.path(), std::ios::binary);
+		scripts.push_back({
+			entry.path().lexically_relative(dir).generic_string(),
+			std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>())
+		});
+	}
+
+	// Directory order isn't stable, keep runs comparable
+	std::sort(scripts.begin(), scripts.end(), [](const Script& a, const Script& b) { return a.name < b.name; });
+	return scripts;
+}
+
+Percentiles computePercentiles(std::vector<double>& samples)
+{
+	Percentiles result;
+	if (samples.empty())
+		return result;
+
+	std::sort(samples.begin(), samples.end());
+
+	// Nearest-rank percentiles
+	auto rank = [&](double pct) {
+		auto idx = size_t(pct / 100.0 * double(samples.size()) + 0.5);
+		return samples[std::clamp<size_t>(idx, 1, samples.size()) - 1];
+	};
+
+	double sum = 0;
+	for (auto sample : samples)
+		sum += sample;
+
+	result.p50 = rank(50);
+	result.p99 = rank(99);
+	result.mean = sum / double(samples.size());
+	return result;
+}
+
+/*
+ * Compiles every script `iterations` times on the calling thread, recording
+ * the latency of each compile and its phases
+ */
+void runLatency(const std::vector<Script>& scripts, const Arguments& args, BenchResult& result)
+{
+	auto options = args.optimize ? GS2CompilerOptions::optimized() : GS2CompilerOptions{};
+	options.collectStats = true;
+
+	GS2Context context;
+	context.setOptions(options);
+
+	// Warm up the context, and find the scripts that don't compile
+	for (const auto& script : scripts)
+	{
+		if (!context.compile(script.source).success)
+			++result.failedScripts;
+	}
+
+	std::vector<double> total, parse, fold, codegen, serialize;
+	auto sampleCount = scripts.size() * size_t(args.iterations);
+	for (auto samples : { &total, &parse, &fold, &codegen, &serialize })
+		samples->reserve(sampleCount);
+
+	auto start = Clock::now();
+	for (int i = 0; i < args.iterations; i++)
+	{
+		for (const auto& script : scripts)
+		{
+			auto response = context.compile(script.source);
+			const auto& stats = *response.stats;
+
+			total.push_back(double(stats.totalTime));
+			parse.push_back(double(stats.parseTime));
+			fold.push_back(double(stats.foldTime));
+			codegen.push_back(double(stats.codegenTime));
+			serialize.push_back(double(stats.serializeTime));
+		}
+	}
+
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+	result.compiles = sampleCount;
+	result.seconds = elapsed.count();
+
+	result.total = computePercentiles(total);
+	result.parse = computePercentiles(parse);
+	result.fold = computePercentiles(fold);
+	result.codegen = computePercentiles(codegen);
+	result.serialize = computePercentiles(serialize);
+}
+
+/*
+ * Compiles the corpus `iterations` times split across `threads` workers,
+ * each pulling the next script from a shared counter
+ */
+ScalingResult runThreads(const std::vector<Script>& scripts, const Arguments& args, int threads, size_t corpusBytes)
+{
+	auto options = args.optimize ? GS2CompilerOptions::optimized() : GS2CompilerOptions{};
+	auto jobCount = scripts.size() * size_t(args.iterations);
+
+	std::atomic<size_t> nextJob{ 0 };
+	auto worker = [&]() {
+		GS2Context context;
+		context.setOptions(options);
+
+		for (auto job = nextJob++; job < jobCount; job = nextJob++)
+			context.compile(scripts[job % scripts.size()].source);
+	};
+
+	auto start = Clock::now();
+	{
+		std::vector<std::jthread> workers;
+		for (int i = 0; i < threads; i++)
+			workers.emplace_back(worker);
+	}
+
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+	return {
+		threads,
+		elapsed.count(),
+		double(jobCount) / elapsed.count(),
+		double(corpusBytes) * args.iterations / (1024.0 * 1024.0) / elapsed.count()
+	};
+}
+
+std::string formatPercentiles(const Percentiles& p)
+{
+	return std::format(R"({{ "p50_ns": {:.0f}, "p99_ns": {:.0f}, "mean_ns": {:.0f} }})", p.p50, p.p99, p.mean);
+}
+
+std::string formatJson(const BenchResult& result, const Arguments& args)
+{
+	std::string json = "{\n";
+	json.append(std::format("  \"optimize\": {},\n", args.optimize));
+	json.append(std::format("  \"iterations\": {},\n", args.iterations));
+	json.append(std::format("  \"scripts\": {},\n", result.scriptCount));
+	json.append(std::format("  \"failed_scripts\": {},\n", result.failedScripts));
+	json.append(std::format("  \"corpus_bytes\": {},\n", result.corpusBytes));
+	json.append(std::format("  \"scripts_per_second\": {:.1f},\n", double(result.compiles) / result.seconds));
+	json.append(std::format("  \"mb_per_second\": {:.3f},\n",
+		double(result.corpusBytes) * args.iterations / (1024.0 * 1024.0) / result.seconds));
+
+	json.append("  \"latency\": {\n");
+	json.append(std::format("    \"total\": {},\n", formatPercentiles(result.total)));
+	json.append(std::format("    \"parse\": {},\n", formatPercentiles(result.parse)));
+	json.append(std::format("    \"fold\": {},\n", formatPercentiles(result.fold)));
+	json.append(std::format("    \"codegen\": {},\n", formatPercentiles(result.codegen)));
+	json.append(std::format("    \"serialize\": {}\n", formatPercentiles(result.serialize)));
+	json.append("  },\n");
+
+	json.append("  \"scaling\": [");
+	for (size_t i = 0; i < result.scaling.size(); i++)
+	{
+		const auto& run = result.scaling[i];
+		json.append(i ? ",\n" : "\n");
+		json.append(std::format(R"(    {{ "threads": {}, "seconds": {:.4f}, "scripts_per_second": {:.1f}, "mb_per_second": {:.3f}, "speedup": {:.2f} }})",
+			run.threads, run.seconds, run.scriptsPerSecond, run.megabytesPerSecond,
+			run.scriptsPerSecond / result.scaling.front().scriptsPerSecond));
+	}
+	json.append("\n  ]\n}\n");
+	return json;
+}
+
+void printSummary(const BenchResult& result, const Arguments& args)
+{
+	printf("%zu scripts, %.1f KiB, %d iterations%s\n", result.scriptCount, double(result.corpusBytes) / 1024.0,
+		args.iterations, args.optimize ? ", optimized" : "");
+	if (result.failedScripts)
+		printf("%zu scripts fail to compile, they are still measured\n", result.failedScripts);
+
+	printf("\nSingle thread: %.1f scripts/s, %.2f MB/s\n\n", double(result.compiles) / result.seconds,
+		double(result.corpusBytes) * args.iterations / (1024.0 * 1024.0) / result.seconds);
+
+	printf("%-12s %12s %12s %12s\n", "phase", "p50 us", "p99 us", "mean us");
+	auto printRow = [](const char* name, const Percentiles& p) {
+		printf("%-12s %12.2f %12.2f %12.2f\n", name, p.p50 / 1000.0, p.p99 / 1000.0, p.mean / 1000.0);
+	};
+
+	printRow("total", result.total);
+	printRow("parse", result.parse);
+	printRow("fold", result.fold);
+	printRow("codegen", result.codegen);
+	printRow("serialize", result.serialize);
+
+	printf("\n%-12s %12s %12s %12s\n", "threads", "scripts/s", "MB/s", "speedup");
+	for (const auto& run : result.scaling)
+	{
+		printf("%-12d %12.1f %12.2f %12.2f\n", run.threads, run.scriptsPerSecond, run.megabytesPerSecond,
+			run.scriptsPerSecond / result.scaling.front().scriptsPerSecond);
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	Arguments args;
+	if (!parseArguments(argc, argv, args))
+	{
+		fprintf(stderr, "Invalid arguments, use --help for usage information.\n");
+		return 1;
+	}
+
+	auto scripts = loadScripts(args.scriptsDir);
+	if (scripts.empty())
+	{
+		fprintf(stderr, "No scripts found in %s\n", args.scriptsDir.string().c_str());
+		return 1;
+	}
+
+	BenchResult result;
+	result.scriptCount = scripts.size();
+	for (const auto& script : scripts)
+		result.corpusBytes += script.source.size();
+
+	runLatency(scripts, args, result);
+
+	// Powers of two up to the requested thread count, always including it
+	for (int threads = 1; threads < args.maxThreads; threads *= 2)
+		result.scaling.push_back(runThreads(scripts, args, threads, result.corpusBytes));
+	result.scaling.push_back(runThreads(scripts, args, args.maxThreads, result.corpusBytes));
+
+	printSummary(result, args);
+
+	// Written to a file rather than stdout, since the scanner echoes
+	// unmatched input of the error case scripts to stdout
+	if (!args.jsonPath.empty())
+	{
+		std::ofstream outstream(args.jsonPath, std::ios::binary | std::ios::trunc);
+		outstream << formatJson(result, args);
+		if (!outstream)
+		{
+			fprintf(stderr, "Cannot write %s\n", args.jsonPath.string().c_str());
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -13,6 +13,7 @@ struct Response {
     uint32_t ByteCodeSize;
 };
 
+// Contexts can be used from different threads, as long as each one is only used by one thread at a time
 DLL_EXPORT void *get_context() {
     return new GS2Context();
 }
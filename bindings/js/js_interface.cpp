@@ -15,7 +15,7 @@ EMSCRIPTEN_BINDINGS(GS2Context_bindings) {
 
 emscripten::val getBytecodeFromBuffer(const CompilerResponse &response) {
     const Buffer &buf = response.bytecode;
-    return emscripten::val(emscripten::typed_memory_view(buf.size(), buf.buffer()));
+    return emscripten::val(emscripten::typed_memory_view(buf.length(), buf.buffer()));
 }
 
 /* getErrors is simply a list of strings for now */
@@ -28,10 +28,28 @@ std::vector<std::string> getErrors(const CompilerResponse &response) {
     return errors;
 }
 
+/* Errors with their location in the script, line and column are 1-based and 0 when unknown */
+emscripten::val getErrorDetails(const CompilerResponse &response) {
+    auto errors = emscripten::val::array();
+    for (const GS2CompilerError &error : response.errors) {
+        const auto &location = error.location();
+
+        auto details = emscripten::val::object();
+        details.set("message", error.msg());
+        details.set("line", location.line);
+        details.set("column", location.column);
+        details.set("length", location.length);
+        errors.call<void>("push", details);
+    }
+
+    return errors;
+}
+
 EMSCRIPTEN_BINDINGS(CompilerResponse_bindings) {
     /* For now, let's just have a test property set to 1 */
     class_<CompilerResponse>("CompilerResponse")
         .property("success", &CompilerResponse::success)
         .function("getBytecode", &getBytecodeFromBuffer, emscripten::return_value_policy::take_ownership())
-        .function("getErrors", &getErrors, emscripten::return_value_policy::take_ownership());
+        .function("getErrors", &getErrors, emscripten::return_value_policy::take_ownership())
+        .function("getErrorDetails", &getErrorDetails, emscripten::return_value_policy::take_ownership());
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+# Writes OUTPUT with GS2PARSER_BUILD_ID, a hash of the compiler variant and
+# every file listed in SOURCES_LIST (relative to SOURCE_DIR), so anything
+# keyed on the compiler changes whenever its sources do. OUTPUT is only
+# rewritten when the hash changes.
+#
+# cmake -DSOURCE_DIR=<dir> -DSOURCES_LIST=<file> -DVARIANT=<name> -DOUTPUT=<header> -P BuildId.cmake
+
+file(STRINGS "${SOURCES_LIST}" sources)
+
+set(content "${VARIANT};")
+foreach(source IN LISTS sources)
+	file(READ "${SOURCE_DIR}/${source}" data HEX)
+	string(APPEND content "${source}:${data};")
+endforeach()
+
+string(SHA256 GS2PARSER_BUILD_ID "${content}")
+file(CONFIGURE OUTPUT "${OUTPUT}" CONTENT "#define GS2PARSER_BUILD_ID \"@GS2PARSER_BUILD_ID@\"\n" @ONLY)
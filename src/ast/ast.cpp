@@ -50,7 +50,7 @@ void inspectNodeForUnary(Node *node)
 }
 
 Node::Node()
-	: parent(nullptr)
+	: parent(nullptr), location{ 0, 0 }
 {
 #ifdef DBGALLOCATIONS
 	{
@@ -3,7 +3,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -25,6 +27,26 @@ void checkForNodeLeaks();
 void checkNodeOwnership();
 #endif
 
+/*
+ * Where a node starts in the script, packed into 32 bits to keep nodes
+ * small. Lines and columns are 1-based, zero when unknown, and saturate
+ * past the largest value they can hold
+ */
+struct NodeLocation
+{
+	static constexpr uint32_t MAX_LINE = (1u << 20) - 1;
+	static constexpr uint32_t MAX_COLUMN = (1u << 12) - 1;
+
+	uint32_t line : 20;
+	uint32_t column : 12;
+
+	static NodeLocation make(int line, int column)
+	{
+		auto clamp = [](int val, uint32_t max) { return val <= 0 ? 0u : std::min(uint32_t(val), max); };
+		return { clamp(line, MAX_LINE), clamp(column, MAX_COLUMN) };
+	}
+};
+
 class Node
 {
 public:
@@ -51,6 +73,7 @@ public:
 	}
 
 	Node *parent;
+	NodeLocation location;
 };
 
 class StatementNode : public Node
@@ -1,32 +1,35 @@
-#include <cassert>
 #include <algorithm>
+#include <cassert>
+#include <cstdlib>
 #include <limits>
 
 #include "GS2Bytecode.h"
+#include "GS2BytecodeOptimizer.h"
 #include "encoding/graalencoding.h"
 
- enum
- {
-     SEGMENT_GS1FLAGS = 1,
-	 SEGMENT_FUNCTIONTABLE = 2,
-	 SEGMENT_STRINGTABLE = 3,
-	 SEGMENT_BYTECODE = 4
- };
-
-int32_t GS2Bytecode::getStringConst(const std::string& str)
+int32_t GS2Bytecode::getStringConst(std::string_view str)
 {
 	auto it = stringTableMapping.find(str);
 	if (it != stringTableMapping.end())
 		return it->second;
 
-	stringTable.push_back(str);
+	stringTable.emplace_back(str);
 	auto idx = int32_t(stringTable.size() - 1);
 
-	stringTableMapping[str] = idx;
+	stringTableMapping.emplace(str, idx);
 	return idx;
 }
 
-Buffer GS2Bytecode::getByteCode()
+int32_t GS2Bytecode::getStringConst(const std::string *interned)
+{
+	auto [it, inserted] = internedStringMapping.try_emplace(interned, 0);
+	if (inserted)
+		it->second = getStringConst(std::string_view(*interned));
+
+	return it->second;
+}
+
+Buffer GS2Bytecode::getByteCode(bool optimize, const ScriptHeader *header)
 {
 	// This fixes a weird bug in which the last function was uncallable,
 	// i am unsure if this is a bug with our specific client or something
@@ -37,88 +40,121 @@ Buffer GS2Bytecode::getByteCode()
 	// - joey
 	emit(opcode::OP_RET);
 
-	Buffer byteCode;
-
-	// GS1EventFlags
+	// emit a jump before each function declaration to the last op index
+	for (const auto& func : functionTable)
 	{
-		Buffer gs1flags;
-		gs1flags.Write<encoding::Int32>(0); // bitflag for gs1 events
-
-		byteCode.Write<encoding::Int32>(SEGMENT_GS1FLAGS);
-		byteCode.Write<encoding::Int32>(uint32_t(gs1flags.length()));
-		byteCode.write(gs1flags);
+		if (func.jmpLoc != 0)
+			emitJumpTarget(opIndex, func.jmpLoc - 2);
 	}
 
-	// Function Names
+	if (!wideJumps.empty())
+		widenJumps();
+
+	if (optimize)
 	{
-		// Functions need to appear in order of them being called, so
-		// im just adding every string in the table followed by the list of
-		// functions defined in the script. Then culling out any strings that
-		// isn't a function from the final list.
-		// 
-		// note: this may not actually be the case, and it may be related to the
-		// function bug i mentioned a few lines up
-		std::vector<std::string> functionTableOrder;
-		std::unordered_set<std::string> visitedFunctions;
-
-		for (const auto& ident : stringTable)
+		GS2BytecodeOptimizer optimizer(bytecode);
+		for (const auto& func : functionTable)
+			optimizer.addEntryPoint(func.opIndex);
+
+		if (optimizer.optimize())
 		{
-			if (functionSet.find(ident) != functionSet.end() && visitedFunctions.insert(ident).second)
+			for (auto& func : functionTable)
+				func.opIndex = optimizer.mapOpIndex(func.opIndex);
+
+			Buffer optimized = optimizer.getByteCode();
+			std::swap(bytecode, optimized);
+			opIndex = optimizer.mapOpIndex(opIndex);
+
+			// Removed ops map to the op following them, so the entry for the
+			// op that is actually there comes last
+			size_t count = 0;
+			for (auto entry : sourceMap)
 			{
-				functionTableOrder.push_back(ident);
+				entry.opIndex = optimizer.mapOpIndex(entry.opIndex);
+				if (count && sourceMap[count - 1].opIndex == entry.opIndex)
+					--count;
+				if (!count || sourceMap[count - 1].line != entry.line)
+					sourceMap[count++] = entry;
 			}
+			sourceMap.resize(count);
 		}
+	}
 
-		for (const auto& func : functionTable)
+	// Functions need to appear in order of them being called, so
+	// im just adding every string in the table followed by the list of
+	// functions defined in the script. Then culling out any strings that
+	// isn't a function from the final list.
+	// 
+	// note: this may not actually be the case, and it may be related to the
+	// function bug i mentioned a few lines up
+	std::vector<const FunctionEntry *> functionTableOrder;
+	std::vector<bool> visitedFunctions(functionTable.size());
+	functionTableOrder.reserve(functionTable.size());
+
+	auto addToFunctionTable = [&](size_t idx) {
+		if (!visitedFunctions[idx])
 		{
-			if (functionSet.find(func.functionName) != functionSet.end() && visitedFunctions.insert(func.functionName).second)
-			{
-				functionTableOrder.push_back(func.functionName);
-			}
+			visitedFunctions[idx] = true;
+			functionTableOrder.push_back(&functionTable[idx]);
 		}
+	};
 
-		Buffer functionTableBuffer;
-		for (const auto& funcName : functionTableOrder)
-		{
-			// Not a defined function, so skip
-			assert(functionSet.find(funcName) != functionSet.end());
+	for (const auto& ident : stringTable)
+	{
+		auto it = functionIndex.find(ident);
+		if (it != functionIndex.end())
+			addToFunctionTable(it->second);
+	}
 
-			auto it = std::find_if(functionTable.begin(), functionTable.end(), [funcName](const FunctionEntry& e) {
-				return (funcName == e.functionName);
-			});
+	for (size_t i = 0; i < functionTable.size(); i++)
+		addToFunctionTable(i);
 
-			if (it != functionTable.end())
-			{
-				auto& func = *it;
-				functionTableBuffer.Write<encoding::Int32>(func.opIndex);
-				functionTableBuffer.write(func.functionName.c_str(), func.functionName.length());
-				functionTableBuffer.write('\0');
-
-				// emit a jump before the function declaration to the last op index
-				if (func.jmpLoc != 0)
-				{
-					emit(short(opIndex), func.jmpLoc - 2);
-				}
-			}
-		}
+	// Size every segment up front, so the output is written in one pass
+	// without any intermediate buffers
+	constexpr size_t segmentHeaderLength = 8;
+	constexpr size_t gs1FlagsLength = 4;
 
-		byteCode.Write<encoding::Int32>(SEGMENT_FUNCTIONTABLE);
-		byteCode.Write<encoding::Int32>(uint32_t(functionTableBuffer.length()));
-		byteCode.write(functionTableBuffer);
+	size_t functionTableLength = 0;
+	for (const auto func : functionTableOrder)
+		functionTableLength += 4 + func->functionName.length() + 1;
+
+	size_t stringTableLength = 0;
+	for (const auto& str : stringTable)
+		stringTableLength += str.length() + 1;
+
+	size_t totalLength = (header ? header->length() : 0)
+		+ segmentHeaderLength + gs1FlagsLength
+		+ segmentHeaderLength + functionTableLength
+		+ segmentHeaderLength + stringTableLength
+		+ segmentHeaderLength + bytecode.length() + 1;
+
+	Buffer byteCode(totalLength);
+
+	if (header)
+		header->write(byteCode);
+
+	// GS1EventFlags
+	byteCode.Write<encoding::Int32>(SEGMENT_GS1FLAGS);
+	byteCode.Write<encoding::Int32>(uint32_t(gs1FlagsLength));
+	byteCode.Write<encoding::Int32>(0); // bitflag for gs1 events
+
+	// Function Names
+	byteCode.Write<encoding::Int32>(SEGMENT_FUNCTIONTABLE);
+	byteCode.Write<encoding::Int32>(uint32_t(functionTableLength));
+	for (const auto func : functionTableOrder)
+	{
+		byteCode.Write<encoding::Int32>(func->opIndex);
+		byteCode.write(func->functionName.c_str(), func->functionName.length());
+		byteCode.write('\0');
 	}
 
 	// String Table
+	byteCode.Write<encoding::Int32>(SEGMENT_STRINGTABLE);
+	byteCode.Write<encoding::Int32>(uint32_t(stringTableLength));
+	for (const auto& str : stringTable)
 	{
-		Buffer stringTableBuffer;
-		for (const auto& str : stringTable)
-		{
-			stringTableBuffer.write(str.c_str(), str.length());
-			stringTableBuffer.write('\0');
-		}
-
-		byteCode.Write<encoding::Int32>(SEGMENT_STRINGTABLE);
-		byteCode.Write<encoding::Int32>(uint32_t(stringTableBuffer.length()));
-		byteCode.write(stringTableBuffer);
+		byteCode.write(str.c_str(), str.length());
+		byteCode.write('\0');
 	}
 
 	// Bytecode
@@ -127,12 +163,83 @@ Buffer GS2Bytecode::getByteCode()
 	byteCode.write(bytecode);
 	byteCode.write('\n');
 
+	assert(byteCode.length() == totalLength);
 	return byteCode;
 }
 
+void GS2Bytecode::widenJumps()
+{
+	// Labels are patched in the order they are resolved, not by position
+	std::sort(wideJumps.begin(), wideJumps.end());
+
+	Buffer widened(bytecode.length() + wideJumps.size() * 2);
+	auto src = reinterpret_cast<const char *>(bytecode.buffer());
+	size_t copied = 0;
+
+	// Replace each `0xF4 hi lo` with `0xF5` and the full target
+	for (const auto& [pos, target] : wideJumps)
+	{
+		assert(pos - 1 >= copied);
+
+		widened.write(src + copied, pos - 1 - copied);
+		widened.write(char(0xF5));
+		widened.Write<encoding::Int32>(target);
+		copied = pos + 2;
+	}
+
+	widened.write(src + copied, bytecode.length() - copied);
+	std::swap(bytecode, widened);
+	wideJumps.clear();
+}
+
+void GS2Bytecode::markSourceLine(uint32_t line)
+{
+	if (!sourceMap.empty())
+	{
+		auto& last = sourceMap.back();
+		if (last.line == line)
+			return;
+
+		// Nothing was emitted for the previous line
+		if (last.opIndex == opIndex)
+		{
+			sourceMap.pop_back();
+			if (!sourceMap.empty() && sourceMap.back().line == line)
+				return;
+		}
+	}
+
+	sourceMap.push_back({ opIndex, line });
+}
+
+size_t ScriptHeader::length() const
+{
+	// length of the header section, followed by "type,name,saveToDisk," and a 10 byte key
+	return 2 + scriptType.length() + scriptName.length() + 4 + 10;
+}
+
+void ScriptHeader::write(Buffer& buf) const
+{
+	// Write the length of the header section
+	buf.Write<GraalShort>(uint16_t(length() - 2));
+
+	// Create the sections header
+	buf.write(scriptType.data(), scriptType.length());
+	buf.write(',');
+	buf.write(scriptName.data(), scriptName.length());
+	buf.write(',');
+	buf.write(saveToDisk ? '1' : '0');
+	buf.write(',');
+
+	// Checksum or key for encrypted files
+	// Needs to be new every time script gets generated, otherwise the client won't request updated script
+	for (int i = 0; i < 10; i++)
+		buf.Write<GraalByte>(rand() % 0xFF);
+}
+
 void GS2Bytecode::addFunction(std::string functionName, uint32_t opIdx, size_t jmpLoc)
 {
-	auto ret = functionSet.insert(functionName);
+	auto ret = functionIndex.try_emplace(functionName, functionTable.size());
 
 	if (ret.second)
 	{
@@ -335,6 +442,16 @@ void GS2Bytecode::emitDynamicNumberUnsigned(uint32_t val)
 	}
 }
 
+void GS2Bytecode::emitJumpTarget(uint32_t target, size_t pos)
+{
+	assert(bytecode.buffer()[pos - 1] == 0xF4);
+
+	if (target > uint32_t(std::numeric_limits<int16_t>::max()))
+		wideJumps.emplace_back(pos, target);
+
+	emit(short(target), pos);
+}
+
 void GS2Bytecode::emitDoubleNumber(const std::string& num)
 {
 	assert(getLastOp() == opcode::OP_TYPE_NUMBER);
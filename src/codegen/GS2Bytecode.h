@@ -5,12 +5,13 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include "ast/ast.h"
 #include "encoding/buffer.h"
+#include "GS2SourceMap.h"
 #include "opcodes.h"
 
 struct FunctionEntry
@@ -20,6 +21,47 @@ struct FunctionEntry
     size_t jmpLoc;
 };
 
+/*
+ * Segments of the compiled script, each one is written as its type and
+ * length (big endian int32) followed by the contents
+ */
+enum BytecodeSegment : uint32_t
+{
+    SEGMENT_GS1FLAGS = 1,
+    SEGMENT_FUNCTIONTABLE = 2,
+    SEGMENT_STRINGTABLE = 3,
+    SEGMENT_BYTECODE = 4
+};
+
+/*
+ * Header that precedes the segments when a script is compiled
+ * with a type and name, see GS2Context::CreateHeader
+ */
+struct ScriptHeader
+{
+    std::string_view scriptType;
+    std::string_view scriptName;
+    bool saveToDisk;
+
+    /*
+     * Number of bytes written by write()
+     */
+    size_t length() const;
+    void write(Buffer& buf) const;
+};
+
+/*
+ * Lets the string table be searched with a string_view
+ */
+struct StringHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
 class GS2Bytecode
 {
     friend class GS2CompilerVisitor;
@@ -27,8 +69,27 @@ class GS2Bytecode
     private:
         GS2Bytecode() : opIndex(0), lastOp(opcode::Opcode::OP_NONE) {}
         
-        Buffer getByteCode();
-        int32_t getStringConst(const std::string& str);
+        /*
+         * Serializes the script, optionally running the peephole
+         * optimizer over the op stream first. The header and every
+         * segment are written into a single allocation of the exact size
+         */
+        Buffer getByteCode(bool optimize = false, const ScriptHeader *header = nullptr);
+
+        /*
+         * Rewrites the jumps whose target doesn't fit in a 16-bit operand
+         * with a 32-bit one. Targets are op indices, so growing an operand
+         * never moves another jump's target and one pass is enough
+         */
+        void widenJumps();
+
+        /*
+         * Index of the string in the string table, adding it if needed.
+         * Strings interned by the parser can be passed by pointer, which
+         * skips hashing their contents after the first lookup
+         */
+        int32_t getStringConst(std::string_view str);
+        int32_t getStringConst(const std::string *interned);
 
         void addFunction(std::string functionName, uint32_t opIdx, size_t jmpLoc);
         
@@ -45,6 +106,21 @@ class GS2Bytecode
         void emitDynamicNumberUnsigned(uint32_t val);
         void emitDoubleNumber(const std::string& num);
 
+        /*
+         * Patches the target of a jump emitted as 0xF4 and a placeholder
+         * short, `pos` being the position of the short. Each jump is
+         * patched once, targets past INT16_MAX are recorded and the
+         * operand is widened to 0xF5 when the script is serialized,
+         * see widenJumps()
+         */
+        void emitJumpTarget(uint32_t target, size_t pos);
+
+        /*
+         * Records that the ops emitted from now on come from `line`
+         * of the script, for the source map
+         */
+        void markSourceLine(uint32_t line);
+
         /**
          * Gets the last emitted opcode
          *
@@ -66,16 +142,28 @@ class GS2Bytecode
          */
         size_t getBytecodePos() const;
 
+        /**
+         * Gets the number of entries in the string table
+         *
+         * @return
+         */
+        size_t getStringCount() const;
+
     private:
         Buffer bytecode;
         uint32_t opIndex;
         opcode::Opcode lastOp;
 
         std::vector<std::string> stringTable;
-        std::unordered_map<std::string, int32_t> stringTableMapping;
+        std::unordered_map<std::string, int32_t, StringHash, std::equal_to<>> stringTableMapping;
+        std::unordered_map<const std::string *, int32_t> internedStringMapping;
+
+        GS2SourceMap sourceMap;
+
+        std::vector<std::pair<size_t, uint32_t>> wideJumps;    // Position and target of jumps past INT16_MAX
 
         std::vector<FunctionEntry> functionTable;
-        std::unordered_set<std::string> functionSet;
+        std::unordered_map<std::string, size_t> functionIndex;    // Index of each function in functionTable
 };
 
 inline opcode::Opcode GS2Bytecode::getLastOp() const {
@@ -90,4 +178,8 @@ inline size_t GS2Bytecode::getBytecodePos() const {
     return bytecode.length();
 }
 
+inline size_t GS2Bytecode::getStringCount() const {
+    return stringTable.size();
+}
+
 #endif
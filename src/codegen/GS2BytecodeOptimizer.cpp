@@ -0,0 +1,301 @@
+#include "GS2BytecodeOptimizer.h"
+#include "encoding/graalencoding.h"
+
+namespace
+{
+	// with/foreach targets mark the end of their block rather than a
+	// plain jump, so those are only remapped and never threaded
+	bool IsThreadableJumpOp(opcode::Opcode op)
+	{
+		return opcode::IsJumpOp(op) && op != opcode::OP_WITH && op != opcode::OP_FOREACH;
+	}
+
+	// Returns true if the value produced by `prev` already has the type `conv` converts to
+	bool IsRedundantConversion(opcode::Opcode prev, opcode::Opcode conv)
+	{
+		switch (conv)
+		{
+			case opcode::OP_CONV_TO_FLOAT:
+				return prev == opcode::OP_CONV_TO_FLOAT || prev == opcode::OP_TYPE_NUMBER;
+
+			case opcode::OP_CONV_TO_STRING:
+				return prev == opcode::OP_CONV_TO_STRING || prev == opcode::OP_TYPE_STRING;
+
+			case opcode::OP_CONV_TO_OBJECT:
+				return prev == opcode::OP_CONV_TO_OBJECT;
+
+			default:
+				return false;
+		}
+	}
+}
+
+GS2BytecodeOptimizer::GS2BytecodeOptimizer(const Buffer& bytecode)
+	: source(bytecode), removedCount(0)
+{
+}
+
+void GS2BytecodeOptimizer::addEntryPoint(uint32_t opIndex)
+{
+	entryPoints.push_back(opIndex);
+}
+
+bool GS2BytecodeOptimizer::optimize()
+{
+	if (!decode())
+		return false;
+
+	removeRedundantConversions();
+	threadJumps();
+
+	// Removing unreachable jumps can leave more ops without anything jumping to them
+	do
+		updatePinned();
+	while (removeUnreachable());
+
+	removeJumpsToNext();
+	buildIndexMap();
+	return true;
+}
+
+bool GS2BytecodeOptimizer::decode()
+{
+	const uint8_t *data = source.buffer();
+	size_t length = source.length();
+	size_t pos = 0;
+
+	while (pos < length)
+	{
+		Instruction instr{ opcode::Opcode(data[pos++]), pos, 0, 0, false, false, false };
+		if (data[pos - 1] >= 0xF0)
+			return false;
+
+		if (pos < length && data[pos] >= 0xF0)
+		{
+			auto prefix = data[pos];
+			size_t operandSize;
+
+			switch (prefix)
+			{
+				case 0xF0: case 0xF3: operandSize = 1; break;
+				case 0xF1: case 0xF4: operandSize = 2; break;
+				case 0xF2: case 0xF5: operandSize = 4; break;
+
+				case 0xF6:
+				{
+					operandSize = 0;
+					while (pos + 1 + operandSize < length && data[pos + 1 + operandSize] != 0)
+						++operandSize;
+					++operandSize; // null terminator
+					break;
+				}
+
+				default:
+					return false;
+			}
+
+			if (pos + 1 + operandSize > length)
+				return false;
+
+			instr.operandLength = 1 + operandSize;
+
+			if (opcode::IsJumpOp(instr.op))
+			{
+				const uint8_t *val = data + pos + 1;
+				switch (prefix)
+				{
+					case 0xF3: instr.target = val[0]; break;
+					case 0xF4: instr.target = (uint32_t(val[0]) << 8) | val[1]; break;
+					case 0xF5: instr.target = (uint32_t(val[0]) << 24) | (uint32_t(val[1]) << 16) | (uint32_t(val[2]) << 8) | val[3]; break;
+					default: return false;
+				}
+				instr.isJump = true;
+			}
+
+			pos += instr.operandLength;
+		}
+		else if (opcode::IsJumpOp(instr.op))
+			return false;
+
+		instructions.push_back(instr);
+	}
+
+	updatePinned();
+	return true;
+}
+
+void GS2BytecodeOptimizer::updatePinned()
+{
+	// Mark anything that can be reached other than by falling through
+	for (auto& instr : instructions)
+		instr.pinned = false;
+
+	for (const auto& instr : instructions)
+	{
+		if (instr.isJump && !instr.removed && instr.target < instructions.size())
+			instructions[instr.target].pinned = true;
+	}
+
+	for (auto opIndex : entryPoints)
+	{
+		if (opIndex < instructions.size())
+			instructions[opIndex].pinned = true;
+	}
+}
+
+void GS2BytecodeOptimizer::removeRedundantConversions()
+{
+	const Instruction *prev = nullptr;
+	for (auto& instr : instructions)
+	{
+		// A pinned conversion can be reached with a value of any type
+		if (prev && !instr.pinned && IsRedundantConversion(prev->op, instr.op))
+		{
+			instr.removed = true;
+			++removedCount;
+			continue;
+		}
+
+		prev = &instr;
+	}
+}
+
+void GS2BytecodeOptimizer::threadJumps()
+{
+	for (auto& instr : instructions)
+	{
+		if (!instr.isJump || !IsThreadableJumpOp(instr.op))
+			continue;
+
+		// Follow unconditional jumps, the hop limit guards against jump cycles
+		auto target = instr.target;
+		for (size_t hops = 0; hops < instructions.size() && target < instructions.size(); hops++)
+		{
+			const auto& next = instructions[target];
+			if (next.op != opcode::OP_SET_INDEX || !next.isJump || next.target == target)
+				break;
+
+			target = next.target;
+		}
+
+		instr.target = target;
+	}
+}
+
+bool GS2BytecodeOptimizer::removeUnreachable()
+{
+	bool changed = false;
+	bool reachable = true;
+
+	// The trailing OP_RET is always kept, see GS2Bytecode::getByteCode
+	for (size_t i = 0; i + 1 < instructions.size(); i++)
+	{
+		auto& instr = instructions[i];
+		if (instr.removed)
+			continue;
+
+		if (instr.pinned)
+			reachable = true;
+		else if (!reachable)
+		{
+			instr.removed = true;
+			++removedCount;
+			changed = true;
+			continue;
+		}
+
+		if (instr.op == opcode::OP_RET || (instr.op == opcode::OP_SET_INDEX && instr.isJump))
+			reachable = false;
+	}
+
+	return changed;
+}
+
+void GS2BytecodeOptimizer::removeJumpsToNext()
+{
+	for (size_t i = 0; i < instructions.size(); i++)
+	{
+		auto& instr = instructions[i];
+		if (instr.op != opcode::OP_SET_INDEX || !instr.isJump || instr.removed || instr.target <= i)
+			continue;
+
+		// Everything between the jump and its target has already been removed, so
+		// the jump lands on the next op. Jumps to this op end up there as well since
+		// removed ops map to the op following them.
+		bool fallsThrough = true;
+		for (size_t j = i + 1; j < instr.target && fallsThrough; j++)
+			fallsThrough = instructions[j].removed;
+
+		if (fallsThrough)
+		{
+			instr.removed = true;
+			++removedCount;
+		}
+	}
+}
+
+void GS2BytecodeOptimizer::buildIndexMap()
+{
+	opIndexMap.resize(instructions.size() + 1);
+
+	uint32_t newIndex = 0;
+	for (size_t i = 0; i < instructions.size(); i++)
+	{
+		opIndexMap[i] = newIndex;
+		if (!instructions[i].removed)
+			++newIndex;
+	}
+
+	opIndexMap[instructions.size()] = newIndex;
+}
+
+uint32_t GS2BytecodeOptimizer::mapOpIndex(uint32_t opIndex) const
+{
+	if (opIndexMap.empty())
+		return opIndex;
+
+	if (opIndex >= opIndexMap.size())
+		return opIndex - uint32_t(instructions.size()) + opIndexMap.back();
+
+	return opIndexMap[opIndex];
+}
+
+Buffer GS2BytecodeOptimizer::getByteCode() const
+{
+	Buffer bytecode(source.length());
+
+	for (const auto& instr : instructions)
+	{
+		if (instr.removed)
+			continue;
+
+		bytecode.write(char(instr.op));
+
+		if (instr.isJump)
+		{
+			// Targets are op indices so the operand width can change freely
+			auto target = mapOpIndex(instr.target);
+			if (target <= 0x7F)
+			{
+				bytecode.write(char(0xF3));
+				bytecode.write(char(target));
+			}
+			else if (target <= 0x7FFF)
+			{
+				bytecode.write(char(0xF4));
+				bytecode.Write<encoding::Int16>(uint16_t(target));
+			}
+			else
+			{
+				bytecode.write(char(0xF5));
+				bytecode.Write<encoding::Int32>(target);
+			}
+		}
+		else if (instr.operandLength)
+		{
+			bytecode.write(reinterpret_cast<const char *>(source.buffer()) + instr.operandPos, instr.operandLength);
+		}
+	}
+
+	return bytecode;
+}
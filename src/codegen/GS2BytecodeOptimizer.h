@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef GS2BYTECODEOPTIMIZER_H
+#define GS2BYTECODEOPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "encoding/buffer.h"
+#include "opcodes.h"
+
+/*
+ * Peephole optimizer for the emitted op stream. The bytecode is decoded into
+ * instructions, the rules below are applied and the result is re-emitted with
+ * the jump targets fixed up:
+ *
+ *  - jumps landing on an unconditional jump are threaded to its final target
+ *  - unconditional jumps to the next op are removed
+ *  - ops following an unconditional jump or return that aren't the target
+ *    of any jump are unreachable and removed
+ *  - conversions of a value that already has that type are removed
+ *
+ * Jump targets are op indices, so callers holding on to op indices (ex: the
+ * function table) need to translate them through mapOpIndex()
+ */
+class GS2BytecodeOptimizer
+{
+	public:
+		explicit GS2BytecodeOptimizer(const Buffer& bytecode);
+
+		/*
+		 * Marks an op as reachable from outside the op stream,
+		 * such as a function entry point, so it is never removed
+		 */
+		void addEntryPoint(uint32_t opIndex);
+
+		/*
+		 * Applies the optimization rules
+		 *
+		 * @return false if the bytecode could not be decoded, in which
+		 * case it should be used as is
+		 */
+		bool optimize();
+
+		/*
+		 * Translates an op index of the original bytecode to the optimized bytecode
+		 */
+		uint32_t mapOpIndex(uint32_t opIndex) const;
+
+		/*
+		 * Encodes the optimized op stream
+		 */
+		Buffer getByteCode() const;
+
+		/*
+		 * Number of ops removed by optimize()
+		 */
+		size_t getRemovedCount() const;
+
+	private:
+		struct Instruction
+		{
+			opcode::Opcode op;
+			size_t operandPos;		// Operand bytes, including the 0xF0-0xF6 prefix
+			size_t operandLength;
+			uint32_t target;		// Op index this instruction jumps to
+			bool isJump;
+			bool pinned;			// Jump target or entry point
+			bool removed;
+		};
+
+		const Buffer& source;
+		std::vector<Instruction> instructions;
+		std::vector<uint32_t> entryPoints;
+		std::vector<uint32_t> opIndexMap;
+		size_t removedCount;
+
+		bool decode();
+		void removeRedundantConversions();
+		void threadJumps();
+		void updatePinned();
+		bool removeUnreachable();
+		void removeJumpsToNext();
+		void buildIndexMap();
+};
+
+inline size_t GS2BytecodeOptimizer::getRemovedCount() const {
+	return removedCount;
+}
+
+#endif
@@ -0,0 +1,262 @@
+#include <cstring>
+#include <format>
+
+#include "GS2BytecodeVerifier.h"
+#include "GS2Bytecode.h"
+
+namespace
+{
+	constexpr size_t SEGMENT_HEADER_LENGTH = 8;
+
+	constexpr BytecodeSegment SEGMENT_ORDER[] = {
+		SEGMENT_GS1FLAGS, SEGMENT_FUNCTIONTABLE, SEGMENT_STRINGTABLE, SEGMENT_BYTECODE
+	};
+
+	uint32_t ReadInt32(const uint8_t *data)
+	{
+		return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+	}
+
+	enum class Operand : uint8_t
+	{
+		Unknown,	// Not an op
+		None,
+		Index,		// 0xF0-0xF2
+		Number,		// 0xF3-0xF5, or 0xF6 for numbers
+		Jump		// 0xF3-0xF5 op index
+	};
+
+	constexpr Operand ExpectedOperand(opcode::Opcode op)
+	{
+		switch (op)
+		{
+			case opcode::OP_TYPE_STRING:
+			case opcode::OP_TYPE_VAR:
+				return Operand::Index;
+
+			case opcode::OP_TYPE_NUMBER:
+				return Operand::Number;
+
+			default:
+				return opcode::IsJumpOp(op) ? Operand::Jump : Operand::None;
+		}
+	}
+
+	/*
+	 * Operand of every byte value, so checking an op is a single lookup
+	 */
+	struct OperandTable
+	{
+		Operand operand[256];
+
+		OperandTable() : operand{}
+		{
+			for (int i = 0; i < 0xF0; i++)
+			{
+				if (opcode::OpcodeName(opcode::Opcode(i)))
+					operand[i] = ExpectedOperand(opcode::Opcode(i));
+			}
+		}
+	};
+
+	const OperandTable OPERANDS;
+}
+
+GS2BytecodeVerifier::GS2BytecodeVerifier(GS2ErrorService& errorService)
+	: errorService(errorService)
+{
+}
+
+bool GS2BytecodeVerifier::report(const std::string& msg)
+{
+	errorService.submitPayload({ ErrorLevel::E_ERROR, GS2CompilerError::ErrorCategory::Compiler,
+		std::format("bytecode verification failed: {}", msg) });
+	return false;
+}
+
+bool GS2BytecodeVerifier::verify(const uint8_t *data, size_t length)
+{
+	size_t pos = 0;
+
+	// Segment types start with a zero byte, anything else is the GraalShort length of the script header
+	if (length > 0 && data[0] != 0)
+	{
+		if (length < 2 || data[0] < 32 || data[1] < 32)
+			return report("invalid script header");
+
+		size_t headerLength = (size_t(data[0]) << 7) + data[1] - 0x1020;
+		if (headerLength > length - 2)
+			return report("script header is longer than the script");
+
+		pos = 2 + headerLength;
+	}
+
+	const uint8_t *functionTable = nullptr;
+	size_t functionTableLength = 0;
+	uint32_t stringCount = 0;
+	uint32_t opCount = 0;
+
+	for (auto expected : SEGMENT_ORDER)
+	{
+		if (length - pos < SEGMENT_HEADER_LENGTH)
+			return report(std::format("script ends before segment {}", uint32_t(expected)));
+
+		auto type = ReadInt32(data + pos);
+		auto segmentLength = ReadInt32(data + pos + 4);
+		if (type != expected)
+			return report(std::format("expected segment {} at byte {}, found {}", uint32_t(expected), pos, type));
+
+		pos += SEGMENT_HEADER_LENGTH;
+		if (segmentLength > length - pos)
+			return report(std::format("segment {} is longer than the script", type));
+
+		const uint8_t *segment = data + pos;
+		pos += segmentLength;
+
+		switch (expected)
+		{
+			case SEGMENT_GS1FLAGS:
+				if (segmentLength != 4)
+					return report(std::format("gs1 flags segment has length {}", segmentLength));
+				break;
+
+			case SEGMENT_FUNCTIONTABLE:
+				functionTable = segment;
+				functionTableLength = segmentLength;
+				break;
+
+			case SEGMENT_STRINGTABLE:
+			{
+				if (segmentLength && segment[segmentLength - 1] != 0)
+					return report("string table is not null-terminated");
+
+				auto str = segment;
+				auto end = segment + segmentLength;
+				while (str < end)
+				{
+					str = static_cast<const uint8_t *>(memchr(str, 0, end - str)) + 1;
+					++stringCount;
+				}
+				break;
+			}
+
+			case SEGMENT_BYTECODE:
+				if (!verifyOps(segment, segmentLength, stringCount, opCount))
+					return false;
+				break;
+		}
+	}
+
+	if (length - pos != 1 || data[pos] != '\n')
+		return report(std::format("{} unexpected bytes after the bytecode segment", length - pos));
+
+	// Entry points need the op count, so the function table is checked last
+	size_t entry = 0;
+	while (entry < functionTableLength)
+	{
+		if (functionTableLength - entry < 5)
+			return report("truncated function table entry");
+
+		auto opIndex = ReadInt32(functionTable + entry);
+		auto name = reinterpret_cast<const char *>(functionTable + entry + 4);
+		auto nameEnd = static_cast<const char *>(memchr(name, 0, functionTableLength - entry - 4));
+		if (!nameEnd)
+			return report("function name is not null-terminated");
+
+		if (opIndex >= opCount)
+		{
+			return report(std::format("function {} starts at op {}, past the end of the script ({} ops)",
+				std::string_view(name, nameEnd - name), opIndex, opCount));
+		}
+
+		entry += 4 + (nameEnd - name) + 1;
+	}
+
+	return true;
+}
+
+bool GS2BytecodeVerifier::verifyOps(const uint8_t *data, size_t length, uint32_t stringCount, uint32_t& opCount)
+{
+	// Jumps may point forward, so only the furthest target is kept and checked at the end
+	uint32_t maxTarget = 0;
+	uint32_t maxTargetOp = 0;
+
+	uint32_t opIndex = 0;
+	size_t pos = 0;
+	while (pos < length)
+	{
+		auto op = opcode::Opcode(data[pos]);
+		auto expected = OPERANDS.operand[data[pos]];
+		if (expected == Operand::Unknown)
+		{
+			if (data[pos] >= 0xF0)
+				return report(std::format("operand without an op at op {}", opIndex));
+
+			return report(std::format("unknown op {} at op {}", int(op), opIndex));
+		}
+
+		++pos;
+		if (pos >= length || data[pos] < 0xF0)
+		{
+			if (expected != Operand::None)
+				return report(std::format("{} at op {} has no operand", opcode::OpcodeName(op), opIndex));
+
+			++opIndex;
+			continue;
+		}
+
+		auto prefix = data[pos++];
+		if (prefix > 0xF6)
+			return report(std::format("invalid operand prefix {:#x} at op {}", prefix, opIndex));
+
+		if (expected == Operand::None)
+			return report(std::format("{} at op {} has an operand", opcode::OpcodeName(op), opIndex));
+
+		bool validPrefix = expected == Operand::Index ? prefix <= 0xF2
+			: expected == Operand::Number ? prefix >= 0xF3
+			: prefix >= 0xF3 && prefix <= 0xF5;
+		if (!validPrefix)
+			return report(std::format("{} at op {} has the wrong kind of operand", opcode::OpcodeName(op), opIndex));
+
+		if (prefix == 0xF6)
+		{
+			auto end = static_cast<const uint8_t *>(memchr(data + pos, 0, length - pos));
+			if (!end)
+				return report(std::format("number at op {} is not null-terminated", opIndex));
+
+			pos = end - data + 1;
+			++opIndex;
+			continue;
+		}
+
+		static constexpr uint8_t OPERAND_SIZE[] = { 1, 2, 4, 1, 2, 4 };
+		size_t size = OPERAND_SIZE[prefix - 0xF0];
+		if (size > length - pos)
+			return report(std::format("truncated operand at op {}", opIndex));
+
+		uint32_t value = data[pos];
+		if (size == 2)
+			value = (value << 8) | data[pos + 1];
+		else if (size == 4)
+			value = ReadInt32(data + pos);
+		pos += size;
+
+		if (expected == Operand::Index && value >= stringCount)
+			return report(std::format("string {} at op {} is past the end of the string table ({} strings)", value, opIndex, stringCount));
+
+		if (expected == Operand::Jump && value >= maxTarget)
+		{
+			maxTarget = value;
+			maxTargetOp = opIndex;
+		}
+
+		++opIndex;
+	}
+
+	// Jumping to the end of the script is allowed, it stops execution
+	if (maxTarget > opIndex)
+		return report(std::format("jump at op {} to op {}, past the end of the script ({} ops)", maxTargetOp, maxTarget, opIndex));
+
+	opCount = opIndex;
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef GS2BYTECODEVERIFIER_H
+#define GS2BYTECODEVERIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "gs2compiler_export.h"
+#include "encoding/buffer.h"
+#include "exceptions/GS2CompilerError.h"
+
+/*
+ * Checks a serialized script before it is handed out, so a compiler bug
+ * results in a compile error instead of bytecode that crashes clients:
+ *
+ *  - the header and segments are complete and in the expected order
+ *  - every op is known and its 0xF0-0xF6 operand is well-formed
+ *  - jumps, and the function table entries, land on an op or the end
+ *    of the script
+ *  - string and variable operands index into the string table
+ *  - ops that take an operand have the right kind of operand, and
+ *    the ones that don't have none
+ *
+ * The script is checked in a single pass without allocating, the first
+ * problem found is submitted to the error service.
+ */
+class GS2COMPILER_EXPORT GS2BytecodeVerifier
+{
+	public:
+		explicit GS2BytecodeVerifier(GS2ErrorService& errorService);
+
+		/*
+		 * @return false if the script is malformed
+		 */
+		bool verify(const uint8_t *data, size_t length);
+		bool verify(const Buffer& script);
+
+	private:
+		GS2ErrorService& errorService;
+
+		bool report(const std::string& msg);
+		bool verifyOps(const uint8_t *data, size_t length, uint32_t stringCount, uint32_t& opCount);
+};
+
+inline bool GS2BytecodeVerifier::verify(const Buffer& script) {
+	return verify(script.buffer(), script.length());
+}
+
+#endif
@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include "GS2Disassembler.h"
+#include "GS2Bytecode.h"
+
+namespace
+{
+	constexpr size_t SEGMENT_HEADER_LENGTH = 8;
+	constexpr size_t OP_NAME_WIDTH = 24;
+
+	uint32_t ReadInt32(const uint8_t *data)
+	{
+		return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+	}
+
+	template<typename T>
+	void AppendNumber(std::string& out, T value, size_t width = 0)
+	{
+		char buf[24];
+		auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+		auto length = size_t(end - buf);
+		if (length < width)
+			out.append(width - length, ' ');
+		out.append(buf, length);
+	}
+
+	void AppendPadded(std::string& out, std::string_view str, size_t width)
+	{
+		out.append(str);
+		if (str.length() < width)
+			out.append(width - str.length(), ' ');
+	}
+
+	void AppendQuoted(std::string& out, std::string_view str)
+	{
+		static constexpr char HEX[] = "0123456789abcdef";
+
+		out.push_back('"');
+		for (unsigned char ch : str)
+		{
+			switch (ch)
+			{
+				case '"': out.append("\\\""); break;
+				case '\\': out.append("\\\\"); break;
+				case '\n': out.append("\\n"); break;
+				case '\r': out.append("\\r"); break;
+				case '\t': out.append("\\t"); break;
+				default:
+					if (ch < 0x20 || ch >= 0x7F)
+					{
+						out.append("\\x");
+						out.push_back(HEX[ch >> 4]);
+						out.push_back(HEX[ch & 0xF]);
+					}
+					else
+						out.push_back(char(ch));
+					break;
+			}
+		}
+		out.push_back('"');
+	}
+}
+
+GS2Disassembler::GS2Disassembler()
+	: header(false), saveToDisk(false), gs1Flags(0), bytecodeLength(0)
+{
+}
+
+bool GS2Disassembler::fail(std::string msg)
+{
+	error = std::move(msg);
+	return false;
+}
+
+bool GS2Disassembler::disassemble(const uint8_t *data, size_t length)
+{
+	error.clear();
+	header = false;
+	scriptType = scriptName = {};
+	saveToDisk = false;
+	gs1Flags = 0;
+	functions.clear();
+	strings.clear();
+	instructions.clear();
+	functionOrder.clear();
+	bytecodeLength = 0;
+
+	// Segment types are small big endian numbers, so a script starting with
+	// anything other than a zero byte begins with the script header
+	size_t pos = 0;
+	if (length > 0 && data[0] != 0)
+	{
+		pos = decodeHeader(data, length);
+		if (!pos)
+			return false;
+	}
+
+	bool hasBytecode = false;
+	while (length - pos >= SEGMENT_HEADER_LENGTH)
+	{
+		auto type = ReadInt32(data + pos);
+		auto segmentLength = ReadInt32(data + pos + 4);
+		pos += SEGMENT_HEADER_LENGTH;
+
+		if (segmentLength > length - pos)
+			return fail("segment " + std::to_string(type) + " is longer than the script");
+
+		const uint8_t *segment = data + pos;
+		pos += segmentLength;
+
+		switch (type)
+		{
+			case SEGMENT_GS1FLAGS:
+				if (segmentLength != 4)
+					return fail("gs1 flags segment has length " + std::to_string(segmentLength));
+				gs1Flags = ReadInt32(segment);
+				break;
+
+			case SEGMENT_FUNCTIONTABLE:
+				if (!decodeFunctionTable(segment, segmentLength))
+					return false;
+				break;
+
+			case SEGMENT_STRINGTABLE:
+				if (!decodeStringTable(segment, segmentLength))
+					return false;
+				break;
+
+			case SEGMENT_BYTECODE:
+				if (!decodeOps(segment, segmentLength))
+					return false;
+				hasBytecode = true;
+				break;
+
+			default:
+				return fail("unknown segment type " + std::to_string(type));
+		}
+	}
+
+	// Anything left over is the line feed following the bytecode segment
+	if (!hasBytecode)
+		return fail("missing bytecode segment");
+
+	measureFunctions();
+	return true;
+}
+
+size_t GS2Disassembler::decodeHeader(const uint8_t *data, size_t length)
+{
+	// GraalShort length, then "type,name,saveToDisk," followed by a 10 byte key
+	if (length < 2)
+	{
+		fail("truncated script header");
+		return 0;
+	}
+
+	size_t headerLength = (size_t(data[0]) << 7) + data[1] - 0x1020;
+	if (data[0] < 32 || data[1] < 32 || headerLength > length - 2)
+	{
+		fail("invalid script header length");
+		return 0;
+	}
+
+	std::string_view text(reinterpret_cast<const char *>(data + 2), headerLength);
+
+	auto typeEnd = text.find(',');
+	auto nameEnd = typeEnd == std::string_view::npos ? typeEnd : text.find(',', typeEnd + 1);
+	if (nameEnd == std::string_view::npos || nameEnd + 2 >= text.length() || text[nameEnd + 2] != ',')
+	{
+		fail("malformed script header");
+		return 0;
+	}
+
+	header = true;
+	scriptType = text.substr(0, typeEnd);
+	scriptName = text.substr(typeEnd + 1, nameEnd - typeEnd - 1);
+	saveToDisk = text[nameEnd + 1] == '1';
+	return 2 + headerLength;
+}
+
+bool GS2Disassembler::decodeFunctionTable(const uint8_t *data, size_t length)
+{
+	size_t pos = 0;
+	while (pos < length)
+	{
+		if (length - pos < 5)
+			return fail("truncated function table entry");
+
+		auto opIndex = ReadInt32(data + pos);
+		auto name = reinterpret_cast<const char *>(data + pos + 4);
+		auto end = static_cast<const char *>(memchr(name, 0, length - pos - 4));
+		if (!end)
+			return fail("function name is not null-terminated");
+
+		functions.push_back({ std::string_view(name, end - name), opIndex, 0, 0 });
+		pos += 4 + (end - name) + 1;
+	}
+
+	return true;
+}
+
+bool GS2Disassembler::decodeStringTable(const uint8_t *data, size_t length)
+{
+	auto str = reinterpret_cast<const char *>(data);
+	auto end = str + length;
+	while (str < end)
+	{
+		auto terminator = static_cast<const char *>(memchr(str, 0, end - str));
+		if (!terminator)
+			return fail("string table entry is not null-terminated");
+
+		strings.emplace_back(str, terminator - str);
+		str = terminator + 1;
+	}
+
+	return true;
+}
+
+bool GS2Disassembler::decodeOps(const uint8_t *data, size_t length)
+{
+	// Scripts average a bit over two bytes per op
+	instructions.reserve(length / 2);
+	bytecodeLength = length;
+
+	size_t pos = 0;
+	while (pos < length)
+	{
+		Instruction instr{ uint32_t(instructions.size()), uint32_t(pos), 1, opcode::Opcode(data[pos]),
+			OperandType::None, opcode::IsJumpOp(opcode::Opcode(data[pos])), 0, {} };
+
+		if (data[pos] >= 0xF0)
+			return fail("operand prefix without an op at offset " + std::to_string(pos));
+
+		if (++pos < length && data[pos] >= 0xF0)
+		{
+			auto prefix = data[pos++];
+			const uint8_t *val = data + pos;
+			size_t remaining = length - pos;
+
+			static constexpr uint8_t OPERAND_SIZE[] = { 1, 2, 4, 1, 2, 4 };
+			if (prefix <= 0xF5 && OPERAND_SIZE[prefix - 0xF0] > remaining)
+				return fail("truncated operand at offset " + std::to_string(instr.offset));
+
+			switch (prefix)
+			{
+				case 0xF0: instr.value = val[0]; break;
+				case 0xF1: instr.value = (uint32_t(val[0]) << 8) | val[1]; break;
+				case 0xF2: instr.value = ReadInt32(val); break;
+
+				// Numbers are signed, but jump targets are op indices
+				case 0xF3: instr.value = instr.isJump ? int64_t(val[0]) : int64_t(int8_t(val[0])); break;
+				case 0xF4: instr.value = instr.isJump ? int64_t((uint32_t(val[0]) << 8) | val[1]) : int64_t(int16_t((val[0] << 8) | val[1])); break;
+				case 0xF5: instr.value = instr.isJump ? int64_t(ReadInt32(val)) : int64_t(int32_t(ReadInt32(val))); break;
+
+				case 0xF6:
+				{
+					auto str = reinterpret_cast<const char *>(val);
+					auto end = static_cast<const char *>(memchr(str, 0, remaining));
+					if (!end)
+						return fail("double operand is not null-terminated at offset " + std::to_string(instr.offset));
+
+					instr.doubleValue = std::string_view(str, end - str);
+					break;
+				}
+
+				default:
+					return fail("invalid operand prefix " + std::to_string(prefix) + " at offset " + std::to_string(instr.offset));
+			}
+
+			if (prefix <= 0xF2)
+				instr.operandType = OperandType::Index;
+			else if (prefix <= 0xF5)
+				instr.operandType = OperandType::Number;
+			else
+				instr.operandType = OperandType::Double;
+
+			pos += prefix == 0xF6 ? instr.doubleValue.length() + 1 : OPERAND_SIZE[prefix - 0xF0];
+			instr.length = uint32_t(pos - instr.offset);
+		}
+
+		instructions.push_back(instr);
+	}
+
+	return true;
+}
+
+void GS2Disassembler::measureFunctions()
+{
+	functionOrder.resize(functions.size());
+	for (uint32_t i = 0; i < functions.size(); i++)
+		functionOrder[i] = i;
+
+	std::stable_sort(functionOrder.begin(), functionOrder.end(), [this](uint32_t a, uint32_t b) {
+		return functions[a].opIndex < functions[b].opIndex;
+	});
+
+	// A function runs until the next one starts, this includes the jump
+	// the compiler emits in front of each function to skip over it
+	auto opCount = uint32_t(instructions.size());
+	for (size_t i = 0; i < functionOrder.size(); i++)
+	{
+		auto& func = functions[functionOrder[i]];
+		auto start = std::min(func.opIndex, opCount);
+		auto end = opCount;
+		for (size_t j = i + 1; j < functionOrder.size(); j++)
+		{
+			auto next = std::min(functions[functionOrder[j]].opIndex, opCount);
+			if (next > start)
+			{
+				end = next;
+				break;
+			}
+		}
+
+		auto offset = [&](uint32_t opIndex) {
+			return opIndex < opCount ? instructions[opIndex].offset : uint32_t(bytecodeLength);
+		};
+
+		func.opCount = end - start;
+		func.byteLength = offset(end) - offset(start);
+	}
+}
+
+void GS2Disassembler::print(std::string& out) const
+{
+	if (header)
+	{
+		out.append("; header: ").append(scriptType).append(",").append(scriptName).append(saveToDisk ? ",1\n" : ",0\n");
+	}
+
+	out.append("; gs1 flags: ");
+	AppendNumber(out, gs1Flags);
+	out.append("\n; ");
+	AppendNumber(out, functions.size());
+	out.append(" functions, ");
+	AppendNumber(out, strings.size());
+	out.append(" strings, ");
+	AppendNumber(out, instructions.size());
+	out.append(" ops, ");
+	AppendNumber(out, bytecodeLength);
+	out.append(" bytes\n");
+
+	if (!functions.empty())
+	{
+		out.append("\nfunctions:\n");
+		for (const auto& func : functions)
+		{
+			out.append("  ");
+			AppendPadded(out, func.name, 32);
+			out.append(" op ");
+			AppendNumber(out, func.opIndex, 6);
+			out.append("  ops ");
+			AppendNumber(out, func.opCount, 6);
+			out.append("  bytes ");
+			AppendNumber(out, func.byteLength, 7);
+			out.push_back('\n');
+		}
+	}
+
+	if (!strings.empty())
+	{
+		out.append("\nstrings:\n");
+		for (size_t i = 0; i < strings.size(); i++)
+		{
+			AppendNumber(out, i, 6);
+			out.append("  ");
+			AppendQuoted(out, strings[i]);
+			out.push_back('\n');
+		}
+	}
+
+	out.append("\ncode:\n");
+	size_t nextFunction = 0;
+	for (const auto& instr : instructions)
+	{
+		for (; nextFunction < functionOrder.size() && functions[functionOrder[nextFunction]].opIndex <= instr.opIndex; nextFunction++)
+			out.append(functions[functionOrder[nextFunction]].name).append(":\n");
+
+		AppendNumber(out, instr.opIndex, 6);
+		out.append("  ");
+
+		auto name = opcode::OpcodeName(instr.op);
+		if (instr.operandType == OperandType::None)
+		{
+			if (name)
+				out.append(name);
+			else
+				out.append("OP ").append(std::to_string(int(instr.op)));
+			out.push_back('\n');
+			continue;
+		}
+
+		if (name)
+			AppendPadded(out, name, OP_NAME_WIDTH);
+		else
+			AppendPadded(out, "OP " + std::to_string(int(instr.op)), OP_NAME_WIDTH);
+
+		switch (instr.operandType)
+		{
+			case OperandType::Index:
+				if (instr.value < int64_t(strings.size()))
+					AppendQuoted(out, strings[instr.value]);
+				else
+				{
+					out.append("#");
+					AppendNumber(out, instr.value);
+					out.append(" (out of range)");
+				}
+				break;
+
+			case OperandType::Number:
+				if (instr.isJump)
+					out.append("-> ");
+				AppendNumber(out, instr.value);
+				break;
+
+			case OperandType::Double:
+				out.append(instr.doubleValue);
+				break;
+
+			default:
+				break;
+		}
+
+		out.push_back('\n');
+	}
+
+	// Functions pointing past the last op
+	for (; nextFunction < functionOrder.size(); nextFunction++)
+		out.append(functions[functionOrder[nextFunction]].name).append(":\n");
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#ifndef GS2DISASSEMBLER_H
+#define GS2DISASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "gs2compiler_export.h"
+#include "encoding/buffer.h"
+#include "opcodes.h"
+
+/*
+ * Decodes compiled scripts back into their segments: the optional script
+ * header, the gs1 flags, the function table, the string table and the ops
+ * along with their operands and jump targets.
+ *
+ * Names and strings point into the bytecode passed to disassemble(), so it
+ * has to outlive the results. The tables are reused between calls, one
+ * disassembler can go through a whole build output without reallocating.
+ */
+class GS2COMPILER_EXPORT GS2Disassembler
+{
+	public:
+		enum class OperandType : uint8_t
+		{
+			None,
+			Index,		// 0xF0-0xF2, string table index
+			Number,		// 0xF3-0xF5, signed number or jump target
+			Double		// 0xF6, number as a null-terminated string
+		};
+
+		struct Instruction
+		{
+			uint32_t opIndex;
+			uint32_t offset;		// Position in the bytecode segment
+			uint32_t length;		// Bytes including the operand
+			opcode::Opcode op;
+			OperandType operandType;
+			bool isJump;
+			int64_t value;			// Index, number or op index of the jump target
+			std::string_view doubleValue;
+		};
+
+		struct Function
+		{
+			std::string_view name;
+			uint32_t opIndex;
+			uint32_t opCount;		// Ops up to the next function, or the end of the script
+			uint32_t byteLength;
+		};
+
+		GS2Disassembler();
+
+		/*
+		 * Decodes the script, with or without the script header
+		 *
+		 * @return false if the bytecode is malformed, see getError()
+		 */
+		bool disassemble(const uint8_t *data, size_t length);
+		bool disassemble(const Buffer& bytecode);
+
+		/*
+		 * Appends a listing of the last disassembled script to `out`. Byte
+		 * offsets are left out and string operands are printed by value, so
+		 * listings of two compiler versions can be diffed
+		 */
+		void print(std::string& out) const;
+
+		const std::string& getError() const;
+
+		bool hasHeader() const;
+		std::string_view getScriptType() const;
+		std::string_view getScriptName() const;
+		bool getSaveToDisk() const;
+
+		uint32_t getGs1Flags() const;
+
+		/*
+		 * Functions in the order of the function table
+		 */
+		const std::vector<Function>& getFunctions() const;
+		const std::vector<std::string_view>& getStrings() const;
+		const std::vector<Instruction>& getInstructions() const;
+
+		/*
+		 * Length of the bytecode segment
+		 */
+		size_t getBytecodeLength() const;
+
+	private:
+		std::string error;
+
+		bool header;
+		std::string_view scriptType;
+		std::string_view scriptName;
+		bool saveToDisk;
+
+		uint32_t gs1Flags;
+		std::vector<Function> functions;
+		std::vector<std::string_view> strings;
+		std::vector<Instruction> instructions;
+		size_t bytecodeLength;
+
+		std::vector<uint32_t> functionOrder;	// Indices into functions sorted by op index
+
+		bool fail(std::string msg);
+
+		/*
+		 * @return the length of the header, or 0 if it is malformed
+		 */
+		size_t decodeHeader(const uint8_t *data, size_t length);
+		bool decodeFunctionTable(const uint8_t *data, size_t length);
+		bool decodeStringTable(const uint8_t *data, size_t length);
+		bool decodeOps(const uint8_t *data, size_t length);
+		void measureFunctions();
+};
+
+inline bool GS2Disassembler::disassemble(const Buffer& bytecode) {
+	return disassemble(bytecode.buffer(), bytecode.length());
+}
+
+inline const std::string& GS2Disassembler::getError() const {
+	return error;
+}
+
+inline bool GS2Disassembler::hasHeader() const {
+	return header;
+}
+
+inline std::string_view GS2Disassembler::getScriptType() const {
+	return scriptType;
+}
+
+inline std::string_view GS2Disassembler::getScriptName() const {
+	return scriptName;
+}
+
+inline bool GS2Disassembler::getSaveToDisk() const {
+	return saveToDisk;
+}
+
+inline uint32_t GS2Disassembler::getGs1Flags() const {
+	return gs1Flags;
+}
+
+inline const std::vector<GS2Disassembler::Function>& GS2Disassembler::getFunctions() const {
+	return functions;
+}
+
+inline const std::vector<std::string_view>& GS2Disassembler::getStrings() const {
+	return strings;
+}
+
+inline const std::vector<GS2Disassembler::Instruction>& GS2Disassembler::getInstructions() const {
+	return instructions;
+}
+
+inline size_t GS2Disassembler::getBytecodeLength() const {
+	return bytecodeLength;
+}
+
+#endif
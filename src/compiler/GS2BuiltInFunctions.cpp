@@ -1,3 +1,6 @@
+#include <array>
+#include <bit>
+#include <stdexcept>
 #include "GS2BuiltInFunctions.h"
 
 // Signature characters: [return][...params]
@@ -7,7 +10,7 @@
 // o -> OP_CONV_TO_OBJECT
 // s -> OP_CONV_TO_STRING
 
-const BuiltInCmd builtInCmds[] = {
+constexpr BuiltInCmd builtInCmds[] = {
 	{
 		.name = "sleep",
 		.op = opcode::OP_SLEEP,
@@ -149,7 +152,7 @@ const BuiltInCmd builtInCmds[] = {
 	}
 };
 
-const BuiltInCmd builtInObjCmds[] = {
+constexpr BuiltInCmd builtInObjCmds[] = {
 	{
 		.name = "index",
 		.op = opcode::OP_OBJ_INDEX,
@@ -286,15 +289,81 @@ const BuiltInCmd builtInObjCmds[] = {
 	},
 };
 
-GS2BuiltInFunctions GS2BuiltInFunctions::getBuiltIn()
+namespace
 {
-	GS2BuiltInFunctions functions;
+	constexpr uint32_t hashName(std::string_view name, uint32_t seed)
+	{
+		// FNV-1a
+		uint32_t hash = 2166136261u ^ seed;
+		for (char ch : name)
+		{
+			hash ^= uint8_t(ch);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	/*
+	 * Perfect hash table over one of the command arrays, the seed is
+	 * searched for at compile time so every name lands in its own slot
+	 */
+	template<size_t N>
+	struct BuiltInTable
+	{
+		static constexpr size_t SIZE = std::bit_ceil(N * 2);
+		static_assert(N < 0xFF, "slots are stored as uint8_t");
+
+		const BuiltInCmd *cmds = nullptr;
+		uint32_t seed = 0;
+		std::array<uint8_t, SIZE> slots{};	// index + 1 into cmds, 0 if empty
+
+		const BuiltInCmd * find(std::string_view name) const
+		{
+			auto slot = slots[hashName(name, seed) & (SIZE - 1)];
+			if (slot != 0 && cmds[slot - 1].name == name)
+				return &cmds[slot - 1];
+			return nullptr;
+		}
+	};
+
+	template<size_t N>
+	consteval BuiltInTable<N> makeTable(const BuiltInCmd (&cmds)[N])
+	{
+		for (uint32_t seed = 0; seed < 100000; seed++)
+		{
+			BuiltInTable<N> table{ cmds, seed };
+
+			bool collision = false;
+			for (size_t i = 0; i < N && !collision; i++)
+			{
+				auto& slot = table.slots[hashName(cmds[i].name, seed) & (table.SIZE - 1)];
+				collision = (slot != 0);
+				slot = uint8_t(i + 1);
+			}
+
+			if (!collision)
+				return table;
+		}
+
+		throw std::logic_error("no perfect hash seed found, check for duplicate command names");
+	}
+
+	constexpr auto builtInCmdTable = makeTable(builtInCmds);
+	constexpr auto builtInObjCmdTable = makeTable(builtInObjCmds);
+}
 
-	for (const auto& cmd : builtInCmds)
-		functions.builtInCmdMap.insert({ cmd.name, cmd });
+const BuiltInCmd * GS2BuiltInFunctions::findCmd(std::string_view name) const
+{
+	return builtInCmdTable.find(name);
+}
 
-	for (const auto& cmd : builtInObjCmds)
-		functions.builtInObjMap.insert({ cmd.name, cmd });
+const BuiltInCmd * GS2BuiltInFunctions::findObjCmd(std::string_view name) const
+{
+	return builtInObjCmdTable.find(name);
+}
 
+const GS2BuiltInFunctions& GS2BuiltInFunctions::getBuiltIn()
+{
+	static const GS2BuiltInFunctions functions;
 	return functions;
 }
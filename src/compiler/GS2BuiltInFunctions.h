@@ -3,9 +3,8 @@
 #ifndef GS2BUILTINFUNCTIONS_H
 #define GS2BUILTINFUNCTIONS_H
 
-#include <string>
+#include <string_view>
 #include <cstdint>
-#include <unordered_map>
 #include "opcodes.h"
 
 enum CmdFlags
@@ -22,57 +21,52 @@ const uint8_t DEFAULT_OBJ_CMD_FLAGS = CMD_USE_ARRAY | CMD_REVERSE_ARGS | CMD_RET
 
 struct BuiltInCmd
 {
-	std::string name;										// Function Name
+	std::string_view name;									// Function Name
 	opcode::Opcode op;										// Op-code for built in command, or OP_CALL
 	opcode::Opcode convert_object_op{ opcode::OP_NONE };			// Convert object to this type [used for object.call() functions]
 	uint8_t flags = (CMD_REVERSE_ARGS | CMD_RETURN_VALUE);	// See above for cmd options
-	std::string sig;
+	std::string_view sig;									// Signature, see GS2BuiltInFunctions.cpp
 };
 
-const BuiltInCmd defaultCall = {
+constexpr BuiltInCmd defaultCall = {
 	"",
 	opcode::OP_CALL,
 	opcode::OP_NONE,
 	DEFAULT_CMD_FLAGS
 };
 
-const BuiltInCmd defaultObjCall = {
+constexpr BuiltInCmd defaultObjCall = {
 	"",
 	opcode::OP_CALL,
 	opcode::OP_CONV_TO_OBJECT,
 	DEFAULT_OBJ_CMD_FLAGS
 };
 
-struct GS2BuiltInFunctions
+/*
+ * Lookup for the built-in commands. The tables are perfect hashed at
+ * compile time and shared by every context, lookups don't allocate
+ */
+class GS2BuiltInFunctions
 {
-	std::unordered_map<std::string, BuiltInCmd> builtInCmdMap;
-	std::unordered_map<std::string, BuiltInCmd> builtInObjMap;
+	public:
+		GS2BuiltInFunctions(const GS2BuiltInFunctions&) = delete;
+		GS2BuiltInFunctions& operator= (const GS2BuiltInFunctions&) = delete;
 
-	GS2BuiltInFunctions() { }
+		/*
+		 * Returns the built-in command with this name, or nullptr
+		 */
+		const BuiltInCmd * findCmd(std::string_view name) const;
 
-	GS2BuiltInFunctions(GS2BuiltInFunctions&& o) noexcept;
-	GS2BuiltInFunctions(const GS2BuiltInFunctions&) = delete;
+		/*
+		 * Returns the built-in object command (ex: obj.size()) with
+		 * this name, or nullptr
+		 */
+		const BuiltInCmd * findObjCmd(std::string_view name) const;
 
-	GS2BuiltInFunctions& operator= (GS2BuiltInFunctions&& o) noexcept;
-	GS2BuiltInFunctions& operator= (const GS2BuiltInFunctions&) = delete;
+		static const GS2BuiltInFunctions& getBuiltIn();
 
-	static GS2BuiltInFunctions getBuiltIn();
+	private:
+		GS2BuiltInFunctions() = default;
 };
 
-inline GS2BuiltInFunctions& GS2BuiltInFunctions::operator=(GS2BuiltInFunctions&& o) noexcept
-{
-	if (this != &o)
-	{
-		builtInCmdMap = std::move(o.builtInCmdMap);
-		builtInObjMap = std::move(o.builtInObjMap);
-	}
-
-	return *this;
-}
-
-inline GS2BuiltInFunctions::GS2BuiltInFunctions(GS2BuiltInFunctions&& o) noexcept
-{
-	*this = std::move(o);
-}
-
 #endif
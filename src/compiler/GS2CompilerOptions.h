@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef GS2COMPILEROPTIONS_H
+#define GS2COMPILEROPTIONS_H
+
+/*
+ * Optional compiler passes and instrumentation. Everything is disabled by
+ * default so the output matches the bytecode produced by the official compiler
+ */
+struct GS2CompilerOptions
+{
+	bool peephole = false;			// Peephole and jump-threading pass over the emitted bytecode
+	bool constantFolding = false;	// Fold constant expressions in the AST before code generation
+	bool switchLowering = false;	// Dispatch large integer switches through a compare tree
+	bool collectStats = false;		// Fill CompilerResponse::stats, doesn't affect the output
+	bool sourceMap = false;			// Fill CompilerResponse::sourceMap, doesn't affect the output
+	bool verify = false;			// Check the output with GS2BytecodeVerifier, malformed bytecode fails the compile
+
+	/*
+	 * Options with every optimization enabled
+	 */
+	static GS2CompilerOptions optimized()
+	{
+		GS2CompilerOptions options;
+		options.peephole = true;
+		options.constantFolding = true;
+		options.switchLowering = true;
+		return options;
+	}
+
+	bool operator==(const GS2CompilerOptions&) const = default;
+};
+
+#endif
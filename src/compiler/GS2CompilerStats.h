@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef GS2COMPILERSTATS_H
+#define GS2COMPILERSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Where the time and memory of a compile went, only collected
+ * when GS2CompilerOptions::collectStats is set
+ */
+struct GS2CompilerStats
+{
+	// Time spent in each phase, in nanoseconds
+	uint64_t parseTime = 0;			// Scanning and parsing into the AST
+	uint64_t foldTime = 0;			// Constant folding, zero unless enabled
+	uint64_t codegenTime = 0;		// Walking the AST to emit ops
+	uint64_t serializeTime = 0;		// Peephole pass, header and segment layout
+	uint64_t verifyTime = 0;		// Bytecode verifier, zero unless enabled
+	uint64_t totalTime = 0;
+
+	size_t nodeCount = 0;			// AST nodes allocated by the parser
+	size_t arenaBytes = 0;			// Memory held by the node arena, including unused space
+	size_t arenaChunks = 0;
+	size_t stringCount = 0;			// Entries in the string table
+	size_t opCount = 0;				// Ops in the final bytecode
+	size_t bytecodeSize = 0;		// Output size, including the header if any
+};
+
+#endif
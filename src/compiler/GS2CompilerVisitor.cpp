@@ -1,5 +1,6 @@
 #include <cassert>
 #include <algorithm>
+#include <cstdint>
 #include <unordered_map>
 
 #include "ast/ast.h"
@@ -49,38 +50,35 @@ opcode::Opcode getExpressionOpCode(ExpressionOp op)
 	}
 }
 
-GS2CompilerVisitor::GS2CompilerVisitor(ParserContext & context, GS2BuiltInFunctions & builtin)
-	: parserContext(context), builtIn(builtin),
+GS2CompilerVisitor::GS2CompilerVisitor(ParserContext & context, const GS2BuiltInFunctions & builtin, const GS2CompilerOptions & options)
+	: parserContext(context), builtIn(builtin), options(options),
 	_isCopyAssignment(false), _isInlineConditional(true), _isInsideExpression(false), _newObjectCount(0)
 {
+	// Label 0 is reserved for "no label", ex: break outside of a loop
+	label_addr.push_back(UNSET_ADDRESS);
+
 	fail_label = success_label = exit_label = createLabel();
 	break_label = continue_label = 0;
 }
 
 GS2CompilerVisitor::label_id GS2CompilerVisitor::createLabel()
 {
-	static label_id counter = 0;
-	auto id = ++counter;
-	return id;
+	// Label ids are local to the visitor, so contexts compiling
+	// on different threads never share any state
+	label_addr.push_back(UNSET_ADDRESS);
+	return label_id(label_addr.size() - 1);
 }
 
 void GS2CompilerVisitor::writeLabels()
 {
-	for (const auto& [label, locs] : label_locs)
+	for (const auto& [label, loc] : label_locs)
 	{
 		if (label == exit_label)
 			continue;
 
-		auto label_iter = label_addr.find(label);
-		if (label_iter != label_addr.end())
-		{
-			auto write_addr = label_iter->second;
-
-			for (const auto& loc : locs)
-			{
-				byteCode.emit(short(write_addr), loc);
-			}
-		}
+		auto write_addr = label_addr[label];
+		if (write_addr != UNSET_ADDRESS)
+			byteCode.emitJumpTarget(write_addr, loc);
 	}
 }
 
@@ -104,7 +102,7 @@ void GS2CompilerVisitor::Visit(StatementBlock *node)
    for (const auto& n : node->statements)
 	{
 		assert(n != nullptr);
-		n->visit(this);
+		visitStatement(n);
 	}
 }
 
@@ -613,7 +611,7 @@ void GS2CompilerVisitor::Visit(ExpressionStrConcatNode *node)
 		case ' ':
 		case '\t':
 		case '\n':
-			auto id = byteCode.getStringConst(std::string(1, node->sep));
+			auto id = byteCode.getStringConst(std::string_view(&node->sep, 1));
 			byteCode.emit(opcode::OP_TYPE_STRING);
 			byteCode.emitDynamicNumberUnsigned(id);
 
@@ -711,21 +709,22 @@ void GS2CompilerVisitor::Visit(ExpressionConstantNode *node)
 	}
 }
 
+// Identifiers that are emitted as an op instead of a variable
+static const std::unordered_map<std::string, opcode::Opcode> identMappings = {
+	{"this", opcode::OP_THIS},
+	{"thiso", opcode::OP_THISO},
+	{"player", opcode::OP_PLAYER},
+	{"playero", opcode::OP_PLAYERO},
+	{"level", opcode::OP_LEVEL},
+	{"temp", opcode::OP_TEMP},
+	{"true", opcode::OP_TYPE_TRUE},
+	{"false", opcode::OP_TYPE_FALSE},
+	{"null", opcode::OP_TYPE_NULL},
+	{"pi", opcode::OP_PI}
+};
+
 void GS2CompilerVisitor::Visit(ExpressionIdentifierNode *node)
 {
-	static std::unordered_map<std::string, opcode::Opcode> identMappings = {
-		{"this", opcode::OP_THIS},
-		{"thiso", opcode::OP_THISO},
-		{"player", opcode::OP_PLAYER},
-		{"playero", opcode::OP_PLAYERO},
-		{"level", opcode::OP_LEVEL},
-		{"temp", opcode::OP_TEMP},
-		{"true", opcode::OP_TYPE_TRUE},
-		{"false", opcode::OP_TYPE_FALSE},
-		{"null", opcode::OP_TYPE_NULL},
-		{"pi", opcode::OP_PI}
-	};
-
 	// This is only true for the leading identifier
 	// this.testobj.field, it would be true for the first node (this) but false for
 	// the second node (testobj) and third node (field) that way reserved keywords
@@ -748,7 +747,7 @@ void GS2CompilerVisitor::Visit(ExpressionIdentifierNode *node)
 		return;
 	}
 
-	auto id = byteCode.getStringConst(*node->val);
+	auto id = byteCode.getStringConst(node->val);
 
 	byteCode.emit(opcode::OP_TYPE_VAR);
 	byteCode.emitDynamicNumberUnsigned(id);
@@ -808,7 +807,7 @@ void GS2CompilerVisitor::Visit(ExpressionStringConstNode *node)
 	printf("String: %s\n", node->val->c_str());
 #endif
 
-	auto id = byteCode.getStringConst(*node->val);
+	auto id = byteCode.getStringConst(node->val);
 
 	byteCode.emit(opcode::OP_TYPE_STRING);
 	byteCode.emitDynamicNumberUnsigned(id);
@@ -828,20 +827,37 @@ ExpressionType getSigType(char idx) {
 	}
 }
 
+/*
+ * Returns the name a function call is resolved with. Identifiers and string
+ * constants refer to their interned string, any other expression (ex: (obj.fn)())
+ * falls back to building the name into storage
+ */
+std::string_view getCallName(const ExpressionNode *funcExpr, std::string& storage)
+{
+	if (funcExpr->NodeType() == ExpressionIdentifierNode::NodeName)
+		return *static_cast<const ExpressionIdentifierNode *>(funcExpr)->val;
+
+	if (funcExpr->NodeType() == ExpressionStringConstNode::NodeName)
+		return *static_cast<const ExpressionStringConstNode *>(funcExpr)->val;
+
+	storage = funcExpr->toString();
+	return storage;
+}
+
 void GS2CompilerVisitor::Visit(ExpressionFnCallNode *node)
 {
 	auto isObjectCall = (node->objExpr != nullptr);
 
-	// Build-in commands
-	auto& cmdList = (isObjectCall ? builtIn.builtInObjMap : builtIn.builtInCmdMap);
-	std::string funcName = node->funcExpr->toString();
+	std::string funcNameStorage;
+	std::string_view funcName = getCallName(node->funcExpr, funcNameStorage);
 
 #ifdef DBGEMITTERS
-	printf("Call Function: %s (obj call: %d)\n", funcName.c_str(), isObjectCall ? 1 : 0);
+	printf("Call Function: %.*s (obj call: %d)\n", int(funcName.length()), funcName.data(), isObjectCall ? 1 : 0);
 #endif
 
-	auto iter = cmdList.find(funcName);
-	BuiltInCmd cmd = (iter != cmdList.end() ? iter->second : (isObjectCall ? defaultObjCall : defaultCall));
+	// Build-in commands
+	auto builtInCmd = (isObjectCall ? builtIn.findObjCmd(funcName) : builtIn.findCmd(funcName));
+	const BuiltInCmd& cmd = (builtInCmd ? *builtInCmd : (isObjectCall ? defaultObjCall : defaultCall));
 
 	{
 		auto argumentVisitFn = [&](auto arg_iter, auto arg_iter_end, auto sig_iter, auto sig_iter_end) {
@@ -979,13 +995,13 @@ void GS2CompilerVisitor::Visit(ExpressionFnObject *node)
 	Visit(&node->fnNode);
 
 	// Emit jump for the above index, skipping over the lambda function
-	byteCode.emit(short(byteCode.getOpIndex()), jmpLoc - 2);
+	byteCode.emitJumpTarget(byteCode.getOpIndex(), jmpLoc - 2);
 
 	// this
 	byteCode.emit(opcode::OP_THIS);
 
 	// assigned anonymous function name
-	auto id = byteCode.getStringConst(*node->ident);
+	auto id = byteCode.getStringConst(node->ident);
 	byteCode.emit(opcode::OP_TYPE_VAR);
 	byteCode.emitDynamicNumberUnsigned(id);
 
@@ -1047,7 +1063,7 @@ void GS2CompilerVisitor::Visit(StatementIfNode* node)
 		byteCode.emit(short(0));
 		addLocation(new_fail_label, byteCode.getBytecodePos() - 2);
 
-		node->thenBlock->visit(this);
+		visitStatement(node->thenBlock);
 
 		// OP_IF jumps to this location if the condition is false, so we
 		// continue to the next instruction, but if their is an else-block we must
@@ -1068,8 +1084,8 @@ void GS2CompilerVisitor::Visit(StatementIfNode* node)
 
 		auto elseLoc = byteCode.getBytecodePos() - 2;
 
-		node->elseBlock->visit(this);
-		byteCode.emit(short(byteCode.getOpIndex()), elseLoc);
+		visitStatement(node->elseBlock);
+		byteCode.emitJumpTarget(byteCode.getOpIndex(), elseLoc);
 
 		success_label = save_labels[0];
 		fail_label = save_labels[1];
@@ -1099,7 +1115,7 @@ void GS2CompilerVisitor::Visit(ExpressionNewObjectNode *node)
 	// but if there is additional args it has no effect on the output.
 
 	auto identNode = reinterpret_cast<ExpressionIdentifierNode*>(node->newExpr);
-	auto identIdx = byteCode.getStringConst(*identNode->val);
+	auto identIdx = byteCode.getStringConst(identNode->val);
 
 	// new only works with one argument, and the argument is the object name
 	if (node->args.size() == 1)
@@ -1149,7 +1165,7 @@ void GS2CompilerVisitor::Visit(StatementWhileNode *node)
 		// Increment loop count
 		byteCode.emit(opcode::OP_CMD_CALL);
 
-		node->block->visit(this);
+		visitStatement(node->block);
 
 		// Jump back to condition
 		byteCode.emit(opcode::OP_SET_INDEX);
@@ -1244,12 +1260,13 @@ void GS2CompilerVisitor::Visit(StatementForNode *node)
 
 		// Emit block
 		if (node->block)
-			node->block->visit(this);
+			visitStatement(node->block);
 
 		// Set the continue location before the post-op
 		setLocation(new_continue_label, byteCode.getOpIndex());
 
 		// Emit post-op
+		markSourceLine(node);
 		if (node->postop)
 		{
 			// TODO(joey): discard return
@@ -1286,7 +1303,7 @@ void GS2CompilerVisitor::Visit(StatementNewNode* node)
 	byteCode.emit(opcode::OP_COPY_LAST_OP);
 
 	// emit object type
-	auto id = byteCode.getStringConst(*node->ident);
+	auto id = byteCode.getStringConst(node->ident);
 	byteCode.emit(opcode::OP_TYPE_STRING);
 	byteCode.emitDynamicNumberUnsigned(id);
 
@@ -1310,10 +1327,11 @@ void GS2CompilerVisitor::Visit(StatementNewNode* node)
 		node->stmtBlock->visit(this);
 
 	byteCode.emit(opcode::OP_WITHEND);
-	byteCode.emit(short(byteCode.getOpIndex()), withLoc);
+	byteCode.emitJumpTarget(byteCode.getOpIndex(), withLoc);
 
 	///////
 	// call addcontrol
+	markSourceLine(node);
 	for (int i = 0; i < _newObjectCount - prevNewObjectCount; i++)
 	{
 		byteCode.emit(opcode::OP_TYPE_ARRAY);
@@ -1340,10 +1358,10 @@ void GS2CompilerVisitor::Visit(StatementWithNode* node)
 
 	auto withLoc = byteCode.getBytecodePos() - 2;
 	if (node->block)
-		node->block->visit(this);
+		visitStatement(node->block);
 
 	byteCode.emit(opcode::OP_WITHEND);
-	byteCode.emit(short(byteCode.getOpIndex()), withLoc);
+	byteCode.emitJumpTarget(byteCode.getOpIndex(), withLoc);
 }
 
 void GS2CompilerVisitor::Visit(ExpressionListNode* node)
@@ -1388,7 +1406,7 @@ void GS2CompilerVisitor::Visit(StatementForEachNode *node)
 		addLocation(new_break_label, byteCode.getBytecodePos() - 2);
 
 		byteCode.emit(opcode::OP_CMD_CALL);
-		node->block->visit(this);
+		visitStatement(node->block);
 
 		// Set the continue location before we increment the idx
 		setLocation(new_continue_label, byteCode.getOpIndex());
@@ -1456,28 +1474,39 @@ void GS2CompilerVisitor::Visit(StatementSwitchNode* node)
 
 			break_label = new_break_label;
 			continue_label = new_case_label;
-			caseNode.block->visit(this);
+			visitStatement(caseNode.block);
 		}
 
 		// case-test:
-		byteCode.emit(short(byteCode.getOpIndex()), caseTestLoc);
+		byteCode.emitJumpTarget(byteCode.getOpIndex(), caseTestLoc);
+		markSourceLine(node);
 		node->expr->visit(this);
 
-		size_t i = 0;
-		for (const auto& caseNode : node->cases)
+		std::vector<std::pair<int, label_id>> integerCases;
+		label_id defaultLabel = new_break_label;
+
+		if (options.switchLowering && getIntegerCases(node, caseStartOp, integerCases, defaultLabel))
 		{
-			for (const auto& caseExpr : caseNode.exprList)
+			emitSwitchCompareTree(node->expr->expressionType(), integerCases, 0, integerCases.size(), defaultLabel);
+		}
+		else
+		{
+			size_t i = 0;
+			for (const auto& caseNode : node->cases)
 			{
-				if (caseExpr)
+				for (const auto& caseExpr : caseNode.exprList)
 				{
-					byteCode.emit(opcode::OP_COPY_LAST_OP);
-					caseExpr->visit(this);
-					byteCode.emit(opcode::OP_EQ);
-					byteCode.emit(opcode::OP_SET_INDEX_TRUE);
-				}
-				else byteCode.emit(opcode::OP_SET_INDEX);
+					if (caseExpr)
+					{
+						byteCode.emit(opcode::OP_COPY_LAST_OP);
+						caseExpr->visit(this);
+						byteCode.emit(opcode::OP_EQ);
+						byteCode.emit(opcode::OP_SET_INDEX_TRUE);
+					}
+					else byteCode.emit(opcode::OP_SET_INDEX);
 
-				byteCode.emitDynamicNumber(label_addr[caseStartOp[i++]]);
+					byteCode.emitDynamicNumber(label_addr[caseStartOp[i++]]);
+				}
 			}
 		}
 
@@ -1496,6 +1525,128 @@ void GS2CompilerVisitor::Visit(StatementSwitchNode* node)
 	fail_label = save_labels[3];
 }
 
+std::optional<int> GS2CompilerVisitor::getIntegerConstant(const ExpressionNode *expr, int depth) const
+{
+	auto nodeType = expr->NodeType();
+
+	if (nodeType == ExpressionIntegerNode::NodeName)
+		return static_cast<const ExpressionIntegerNode *>(expr)->val;
+
+	if (nodeType == ExpressionUnaryOpNode::NodeName)
+	{
+		auto unaryNode = static_cast<const ExpressionUnaryOpNode *>(expr);
+		if (unaryNode->op == ExpressionOp::UnaryMinus && unaryNode->expr->NodeType() == ExpressionIntegerNode::NodeName)
+		{
+			auto val = static_cast<const ExpressionIntegerNode *>(unaryNode->expr)->val;
+			if (val != INT32_MIN)
+				return -val;
+		}
+
+		return std::nullopt;
+	}
+
+	// Constants referring to other constants are limited, a cycle would never compile anyway
+	if (nodeType == ExpressionIdentifierNode::NodeName && depth < 32)
+	{
+		auto identNode = static_cast<const ExpressionIdentifierNode *>(expr);
+		if (identNode->checkForReservedIdents && identMappings.contains(*identNode->val))
+			return std::nullopt;
+
+		if (auto constant = parserContext.getConstant(*identNode->val))
+			return getIntegerConstant(constant, depth + 1);
+	}
+
+	return std::nullopt;
+}
+
+bool GS2CompilerVisitor::getIntegerCases(StatementSwitchNode *node, const std::vector<label_id>& caseStartOp,
+										 std::vector<std::pair<int, label_id>>& cases, label_id& defaultLabel) const
+{
+	size_t i = 0;
+	bool foundDefault = false;
+
+	for (const auto& caseNode : node->cases)
+	{
+		for (const auto& caseExpr : caseNode.exprList)
+		{
+			// The linear case-test stops at the default case, so any case after it is never tested
+			if (!caseExpr)
+			{
+				defaultLabel = caseStartOp[i];
+				foundDefault = true;
+				break;
+			}
+
+			auto val = getIntegerConstant(caseExpr);
+			if (!val)
+				return false;
+
+			cases.emplace_back(*val, caseStartOp[i++]);
+		}
+
+		if (foundDefault)
+			break;
+	}
+
+	if (cases.size() < SWITCH_COMPARE_TREE_MIN_CASES)
+		return false;
+
+	// The first case with a value wins, same as the linear case-test
+	std::stable_sort(cases.begin(), cases.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	cases.erase(std::unique(cases.begin(), cases.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), cases.end());
+	return true;
+}
+
+void GS2CompilerVisitor::emitSwitchCompareTree(ExpressionType exprType, const std::vector<std::pair<int, label_id>>& cases,
+											   size_t first, size_t last, label_id defaultLabel)
+{
+	// Small ranges are tested one by one, the same way as the linear case-test
+	if (last - first <= SWITCH_COMPARE_TREE_LEAF_CASES)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			byteCode.emit(opcode::OP_COPY_LAST_OP);
+			byteCode.emit(opcode::OP_TYPE_NUMBER);
+			byteCode.emitDynamicNumber(cases[i].first);
+			byteCode.emit(opcode::OP_EQ);
+			byteCode.emit(opcode::OP_SET_INDEX_TRUE);
+			byteCode.emitDynamicNumber(label_addr[cases[i].second]);
+		}
+
+		// The default case is emitted before the case-test, while the break label is
+		// only known once the whole case-test has been emitted
+		byteCode.emit(opcode::OP_SET_INDEX);
+		if (label_addr[defaultLabel] != UNSET_ADDRESS)
+			byteCode.emitDynamicNumber(label_addr[defaultLabel]);
+		else
+		{
+			byteCode.emit(char(0xF4));
+			byteCode.emit(short(0));
+			addLocation(defaultLabel, byteCode.getBytecodePos() - 2);
+		}
+		return;
+	}
+
+	// switch-value < cases[middle] continues with the lower half, otherwise the upper half
+	auto middle = first + (last - first) / 2;
+	auto lowerLabel = createLabel();
+
+	byteCode.emit(opcode::OP_COPY_LAST_OP);
+	byteCode.emitConversionOp(exprType, ExpressionType::EXPR_NUMBER);
+	byteCode.emit(opcode::OP_TYPE_NUMBER);
+	byteCode.emitDynamicNumber(cases[middle].first);
+	byteCode.emit(opcode::OP_LT);
+	byteCode.emit(opcode::OP_SET_INDEX_TRUE);
+	byteCode.emit(char(0xF4));
+	byteCode.emit(short(0));
+	addLocation(lowerLabel, byteCode.getBytecodePos() - 2);
+
+	emitSwitchCompareTree(exprType, cases, middle, last, defaultLabel);
+
+	setLocation(lowerLabel, byteCode.getOpIndex());
+	emitSwitchCompareTree(exprType, cases, first, middle, defaultLabel);
+}
+
 // not implemented: should never occur
 void GS2CompilerVisitor::Visit(StatementNode *node) { Visit((Node *)node); }
 void GS2CompilerVisitor::Visit(ExpressionNode *node) { Visit((Node *)node); }
@@ -3,13 +3,14 @@
 #ifndef GS2COMPILER_H
 #define GS2COMPILER_H
 
+#include <optional>
 #include <set>
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include "ast/NodeVisitor.h"
 #include "GS2Bytecode.h"
 #include "GS2BuiltInFunctions.h"
+#include "GS2CompilerOptions.h"
 
 class ParserContext;
 
@@ -19,11 +20,27 @@ class GS2CompilerVisitor : public NodeVisitor
 	using jmp_address = uint32_t;
 
 	public:
-		GS2CompilerVisitor(ParserContext& context, GS2BuiltInFunctions& builtin);
+		GS2CompilerVisitor(ParserContext& context, const GS2BuiltInFunctions& builtin, const GS2CompilerOptions& options = {});
 
-		Buffer getByteCode();
+		/*
+		 * Serializes the compiled script, with the header in front of it if one is given
+		 */
+		Buffer getByteCode(const ScriptHeader *header = nullptr);
 		const std::set<std::string>& getJoinedClasses() const;
 
+		/*
+		 * Number of ops and string table entries emitted, after getByteCode
+		 * the op count reflects the optimized output
+		 */
+		uint32_t getOpCount() const;
+		size_t getStringCount() const;
+
+		/*
+		 * Op index to script line table, only filled when the sourceMap
+		 * option is set. Valid after getByteCode
+		 */
+		GS2SourceMap takeSourceMap();
+
 	public:
 		virtual void Visit(Node *node);
 		virtual void Visit(StatementNode *node);
@@ -62,7 +79,8 @@ class GS2CompilerVisitor : public NodeVisitor
 	private:
 		GS2Bytecode byteCode;
 		ParserContext& parserContext;
-		GS2BuiltInFunctions& builtIn;
+		const GS2BuiltInFunctions& builtIn;
+		GS2CompilerOptions options;
 		std::set<std::string> joinedClasses;
 
 		bool _isCopyAssignment;
@@ -70,24 +88,55 @@ class GS2CompilerVisitor : public NodeVisitor
 		bool _isInsideExpression;
 		int _newObjectCount;
 
-		// Jump-labels
+		// Jump-labels, label ids index into label_addr
+		static constexpr jmp_address UNSET_ADDRESS = jmp_address(-1);
+
 		label_id success_label, fail_label, exit_label;
 		label_id break_label, continue_label;
-		std::unordered_map<label_id, std::vector<size_t>> label_locs;
-		std::unordered_map<label_id, jmp_address> label_addr;
+		std::vector<std::pair<label_id, size_t>> label_locs;	// Bytecode positions to patch with the label address
+		std::vector<jmp_address> label_addr;
 
 		// Jump-label functions
 		label_id createLabel();
 		void addLocation(label_id label, size_t loc);
 		void setLocation(label_id label, jmp_address addr);
 		void writeLabels();
+
+		/*
+		 * Visits a statement, recording where its ops come from when building a source map
+		 */
+		void visitStatement(StatementNode *node);
+		void markSourceLine(const Node *node);
+
+		// Switches with at least this many integer cases are dispatched through a compare tree
+		static constexpr size_t SWITCH_COMPARE_TREE_MIN_CASES = 8;
+		static constexpr size_t SWITCH_COMPARE_TREE_LEAF_CASES = 3;
+
+		/*
+		 * Resolves integer literals and const/enum identifiers to their value
+		 */
+		std::optional<int> getIntegerConstant(const ExpressionNode *expr, int depth = 0) const;
+
+		/*
+		 * Collects the cases of a switch sorted by value if every tested case is an
+		 * integer constant, and the label unmatched values continue at
+		 */
+		bool getIntegerCases(StatementSwitchNode *node, const std::vector<label_id>& caseStartOp,
+							 std::vector<std::pair<int, label_id>>& cases, label_id& defaultLabel) const;
+
+		/*
+		 * Emits a balanced compare tree over cases[first, last) for the switch-value
+		 * on top of the stack, each comparison halving the cases left to test
+		 */
+		void emitSwitchCompareTree(ExpressionType exprType, const std::vector<std::pair<int, label_id>>& cases,
+								   size_t first, size_t last, label_id defaultLabel);
 };
 
-inline Buffer GS2CompilerVisitor::getByteCode()
+inline Buffer GS2CompilerVisitor::getByteCode(const ScriptHeader *header)
 {
 	setLocation(exit_label, byteCode.getOpIndex());
 	writeLabels();
-	return byteCode.getByteCode();
+	return byteCode.getByteCode(options.peephole, header);
 }
 
 inline const std::set<std::string>& GS2CompilerVisitor::getJoinedClasses() const
@@ -95,9 +144,36 @@ inline const std::set<std::string>& GS2CompilerVisitor::getJoinedClasses() const
 	return joinedClasses;
 }
 
+inline uint32_t GS2CompilerVisitor::getOpCount() const
+{
+	return byteCode.getOpIndex();
+}
+
+inline size_t GS2CompilerVisitor::getStringCount() const
+{
+	return byteCode.getStringCount();
+}
+
+inline GS2SourceMap GS2CompilerVisitor::takeSourceMap()
+{
+	return std::move(byteCode.sourceMap);
+}
+
+inline void GS2CompilerVisitor::visitStatement(StatementNode *node)
+{
+	markSourceLine(node);
+	node->visit(this);
+}
+
+inline void GS2CompilerVisitor::markSourceLine(const Node *node)
+{
+	if (options.sourceMap && node->location.line)
+		byteCode.markSourceLine(node->location.line);
+}
+
 inline void GS2CompilerVisitor::addLocation(label_id label, size_t loc)
 {
-	label_locs[label].push_back(loc);
+	label_locs.emplace_back(label, loc);
 }
 
 inline void GS2CompilerVisitor::setLocation(label_id label, jmp_address addr)
@@ -0,0 +1,374 @@
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
+#include "compiler/GS2ConstantFolder.h"
+#include "parser/Parser.h"
+
+namespace
+{
+	// Constant references can point to other constants, this only guards against cycles
+	constexpr int MAX_CONSTANT_DEPTH = 32;
+
+	// Largest integer a double holds exactly, anything above loses its string form
+	constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+
+	// Identifiers the compiler maps to an op before looking up constants, see
+	// GS2CompilerVisitor::Visit(ExpressionIdentifierNode *)
+	bool IsReservedIdent(std::string_view ident)
+	{
+		constexpr std::string_view reserved[] = {
+			"this", "thiso", "player", "playero", "level", "temp", "true", "false", "null", "pi"
+		};
+
+		for (auto name : reserved)
+		{
+			if (name == ident)
+				return true;
+		}
+
+		return false;
+	}
+
+	bool IsIntegral(double val)
+	{
+		return std::trunc(val) == val && std::fabs(val) <= MAX_EXACT_INTEGER;
+	}
+
+	bool IsNegativeZero(double val)
+	{
+		return val == 0.0 && std::signbit(val);
+	}
+
+	bool IsFoldableNode(const ExpressionNode *node)
+	{
+		auto nodeType = node->NodeType();
+		return nodeType == ExpressionBinaryOpNode::NodeName
+			|| nodeType == ExpressionStrConcatNode::NodeName
+			|| nodeType == ExpressionUnaryOpNode::NodeName;
+	}
+}
+
+GS2ConstantFolder::GS2ConstantFolder(ParserContext& context)
+	: parserContext(context), foldedCount(0), constantDepth(0), resultNode(nullptr)
+{
+}
+
+std::optional<GS2ConstantFolder::Value> GS2ConstantFolder::fold(ExpressionNode *& expr)
+{
+	resultNode = nullptr;
+	expr->visit(this);
+
+	if (resultNode != expr)
+		return std::nullopt;
+
+	auto value = std::move(result);
+	resultNode = nullptr;
+
+	if (IsFoldableNode(expr))
+	{
+		if (auto literal = createLiteral(value))
+		{
+			literal->parent = expr->parent;
+			literal->location = expr->location;
+			expr = literal;
+			++foldedCount;
+		}
+	}
+
+	return value;
+}
+
+void GS2ConstantFolder::visitOnly(ExpressionNode *expr)
+{
+	if (expr)
+		expr->visit(this);
+}
+
+void GS2ConstantFolder::setResult(const ExpressionNode *node, Value value)
+{
+	resultNode = node;
+	result = std::move(value);
+}
+
+ExpressionNode * GS2ConstantFolder::createLiteral(const Value& value)
+{
+	if (value.type == Value::Type::String)
+		return parserContext.alloc<ExpressionStringConstNode>(parserContext.saveString(value.str.data(), int(value.str.length())));
+
+	if (!std::isfinite(value.number))
+		return nullptr;
+
+	if (IsIntegral(value.number) && !IsNegativeZero(value.number)
+		&& value.number >= double(INT32_MIN) && value.number <= double(INT32_MAX))
+	{
+		return parserContext.alloc<ExpressionIntegerNode>(int(value.number));
+	}
+
+	// Floats are emitted as strings, fixed notation since the runtime
+	// isn't guaranteed to understand exponents
+	char buf[64];
+	auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value.number, std::chars_format::fixed);
+	if (ec != std::errc())
+		return nullptr;
+
+	return parserContext.alloc<ExpressionNumberNode>(parserContext.saveString(buf, int(end - buf)));
+}
+
+void GS2ConstantFolder::Visit(StatementIfNode *node)
+{
+	fold(node->expr);
+	node->thenBlock->visit(this);
+
+	if (node->elseBlock)
+		node->elseBlock->visit(this);
+}
+
+void GS2ConstantFolder::Visit(StatementNewNode *node)
+{
+	for (auto& arg : node->args)
+		fold(arg);
+
+	if (node->stmtBlock)
+		node->stmtBlock->visit(this);
+}
+
+void GS2ConstantFolder::Visit(StatementReturnNode *node)
+{
+	if (node->expr)
+		fold(node->expr);
+}
+
+void GS2ConstantFolder::Visit(StatementForNode *node)
+{
+	visitOnly(node->init);
+
+	if (node->cond)
+		fold(node->cond);
+
+	if (node->block)
+		node->block->visit(this);
+
+	visitOnly(node->postop);
+}
+
+void GS2ConstantFolder::Visit(StatementForEachNode *node)
+{
+	visitOnly(node->name);
+	fold(node->expr);
+	node->block->visit(this);
+}
+
+void GS2ConstantFolder::Visit(StatementSwitchNode *node)
+{
+	fold(node->expr);
+
+	for (auto& caseNode : node->cases)
+	{
+		for (auto& caseExpr : caseNode.exprList)
+		{
+			if (caseExpr)
+				fold(caseExpr);
+		}
+
+		caseNode.block->visit(this);
+	}
+}
+
+void GS2ConstantFolder::Visit(StatementWhileNode *node)
+{
+	fold(node->expr);
+	node->block->visit(this);
+}
+
+void GS2ConstantFolder::Visit(StatementWithNode *node)
+{
+	fold(node->expr);
+
+	if (node->block)
+		node->block->visit(this);
+}
+
+void GS2ConstantFolder::Visit(ExpressionIdentifierNode *node)
+{
+	if (node->checkForReservedIdents && IsReservedIdent(*node->val))
+		return;
+
+	auto constant = parserContext.getConstant(*node->val);
+	if (!constant || constantDepth >= MAX_CONSTANT_DEPTH)
+		return;
+
+	++constantDepth;
+	resultNode = nullptr;
+	constant->visit(this);
+	--constantDepth;
+
+	if (resultNode == constant)
+		resultNode = node;
+}
+
+void GS2ConstantFolder::Visit(ExpressionStringConstNode *node)
+{
+	setResult(node, { Value::Type::String, 0.0, *node->val });
+}
+
+void GS2ConstantFolder::Visit(ExpressionIntegerNode *node)
+{
+	setResult(node, { Value::Type::Number, double(node->val), {} });
+}
+
+void GS2ConstantFolder::Visit(ExpressionNumberNode *node)
+{
+	double val;
+	auto first = node->val->data(), last = first + node->val->length();
+
+	auto [end, ec] = std::from_chars(first, last, val);
+	if (ec == std::errc() && end == last)
+		setResult(node, { Value::Type::Number, val, {} });
+}
+
+void GS2ConstantFolder::Visit(ExpressionInOpNode *node)
+{
+	fold(node->expr);
+	fold(node->lower);
+
+	if (node->higher)
+		fold(node->higher);
+}
+
+void GS2ConstantFolder::Visit(ExpressionCastNode *node)
+{
+	fold(node->expr);
+}
+
+void GS2ConstantFolder::Visit(ExpressionArrayIndexNode *node)
+{
+	for (auto& expr : node->exprList)
+		fold(expr);
+}
+
+void GS2ConstantFolder::Visit(ExpressionFnCallNode *node)
+{
+	visitOnly(node->objExpr);
+
+	for (auto& arg : node->args)
+		fold(arg);
+
+	visitOnly(node->funcExpr);
+}
+
+void GS2ConstantFolder::Visit(ExpressionTernaryOpNode *node)
+{
+	fold(node->condition);
+	fold(node->leftExpr);
+	fold(node->rightExpr);
+}
+
+void GS2ConstantFolder::Visit(ExpressionBinaryOpNode *node)
+{
+	if (node->assignment)
+	{
+		visitOnly(node->left);
+		fold(node->right);
+		return;
+	}
+
+	auto left = fold(node->left);
+	auto right = fold(node->right);
+
+	if (!left || !right || left->type != Value::Type::Number || right->type != Value::Type::Number)
+		return;
+
+	auto lhs = left->number, rhs = right->number;
+	double val;
+
+	switch (node->op)
+	{
+		case ExpressionOp::Plus: val = lhs + rhs; break;
+		case ExpressionOp::Minus: val = lhs - rhs; break;
+		case ExpressionOp::Multiply: val = lhs * rhs; break;
+		case ExpressionOp::Pow: val = std::pow(lhs, rhs); break;
+
+		case ExpressionOp::Divide:
+			if (rhs == 0.0)
+				return;
+
+			val = lhs / rhs;
+			break;
+
+		// The sign of the result differs between implementations, so only fold the unambiguous case
+		case ExpressionOp::Mod:
+			if (!IsIntegral(lhs) || !IsIntegral(rhs) || lhs < 0.0 || rhs <= 0.0)
+				return;
+
+			val = std::fmod(lhs, rhs);
+			break;
+
+		default:
+			return;
+	}
+
+	if (std::isfinite(val))
+		setResult(node, { Value::Type::Number, val, {} });
+}
+
+void GS2ConstantFolder::Visit(ExpressionUnaryOpNode *node)
+{
+	if (node->op == ExpressionOp::Increment || node->op == ExpressionOp::Decrement)
+	{
+		visitOnly(node->expr);
+		return;
+	}
+
+	auto value = fold(node->expr);
+	if (value && value->type == Value::Type::Number && node->op == ExpressionOp::UnaryMinus)
+		setResult(node, { Value::Type::Number, -value->number, {} });
+}
+
+void GS2ConstantFolder::Visit(ExpressionStrConcatNode *node)
+{
+	auto left = fold(node->left);
+	auto right = fold(node->right);
+
+	if (!left || !right)
+		return;
+
+	auto toString = [](const Value& value, std::string& out) {
+		if (value.type == Value::Type::String)
+		{
+			out.append(value.str);
+			return true;
+		}
+
+		if (!IsIntegral(value.number) || IsNegativeZero(value.number))
+			return false;
+
+		out.append(std::to_string(static_cast<long long>(value.number)));
+		return true;
+	};
+
+	std::string str;
+	if (!toString(*left, str))
+		return;
+
+	switch (node->sep)
+	{
+		case ' ':
+		case '\t':
+		case '\n':
+			str.push_back(node->sep);
+			break;
+	}
+
+	if (!toString(*right, str))
+		return;
+
+	setResult(node, { Value::Type::String, 0.0, std::move(str) });
+}
+
+void GS2ConstantFolder::Visit(ExpressionListNode *node)
+{
+	for (auto& arg : node->args)
+		fold(arg);
+}
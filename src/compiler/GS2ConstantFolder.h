@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef GS2CONSTANTFOLDER_H
+#define GS2CONSTANTFOLDER_H
+
+#include <optional>
+#include <string>
+#include "visitors/ASTNodeVisitor.h"
+
+class ParserContext;
+
+/*
+ * Folds pure expressions of literals and constants (const/enum) into a single
+ * literal node before code generation, ex: `WIDTH * 2 + 1` or `"a" @ "b"`
+ *
+ * Only operations whose result doesn't depend on the runtime are folded:
+ *
+ *  - unary minus, +, -, *, / and ^ on numbers
+ *  - % on non-negative integers
+ *  - @, SPC, TAB and NL on strings and integers, floats are left alone since
+ *    their string form is up to the runtime
+ *
+ * Anything that would produce a non-finite number (ex: division by zero)
+ * is left to the runtime as well.
+ */
+class GS2ConstantFolder : public ASTNodeVisitor
+{
+	public:
+		explicit GS2ConstantFolder(ParserContext& context);
+
+		/*
+		 * Number of expressions replaced by a literal
+		 */
+		size_t getFoldedCount() const;
+
+		using ASTNodeVisitor::Visit;
+
+		virtual void Visit(StatementIfNode *node);
+		virtual void Visit(StatementNewNode *node);
+		virtual void Visit(StatementReturnNode *node);
+		virtual void Visit(StatementForNode *node);
+		virtual void Visit(StatementForEachNode *node);
+		virtual void Visit(StatementSwitchNode *node);
+		virtual void Visit(StatementWhileNode *node);
+		virtual void Visit(StatementWithNode *node);
+		virtual void Visit(ExpressionIdentifierNode *node);
+		virtual void Visit(ExpressionStringConstNode *node);
+		virtual void Visit(ExpressionIntegerNode *node);
+		virtual void Visit(ExpressionNumberNode *node);
+		virtual void Visit(ExpressionInOpNode *node);
+		virtual void Visit(ExpressionCastNode *node);
+		virtual void Visit(ExpressionArrayIndexNode *node);
+		virtual void Visit(ExpressionFnCallNode *node);
+		virtual void Visit(ExpressionTernaryOpNode *node);
+		virtual void Visit(ExpressionBinaryOpNode *node);
+		virtual void Visit(ExpressionUnaryOpNode *node);
+		virtual void Visit(ExpressionStrConcatNode *node);
+		virtual void Visit(ExpressionListNode *node);
+
+	private:
+		struct Value
+		{
+			enum class Type { Number, String };
+
+			Type type;
+			double number;
+			std::string str;
+		};
+
+		ParserContext& parserContext;
+		size_t foldedCount;
+		int constantDepth;
+
+		// Value of the last visited expression, only valid if resultNode is that expression
+		const ExpressionNode *resultNode;
+		Value result;
+
+		/*
+		 * Visits the expression in the slot, and replaces it with a literal if
+		 * it is an operation that could be evaluated
+		 *
+		 * @return the value of the expression, if it is constant
+		 */
+		std::optional<Value> fold(ExpressionNode *& expr);
+
+		/*
+		 * Visits an expression that must not be replaced, such as the target of
+		 * an assignment or the name of a function
+		 */
+		void visitOnly(ExpressionNode *expr);
+
+		void setResult(const ExpressionNode *node, Value value);
+		ExpressionNode * createLiteral(const Value& value);
+};
+
+inline size_t GS2ConstantFolder::getFoldedCount() const {
+	return foldedCount;
+}
+
+#endif
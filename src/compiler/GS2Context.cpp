@@ -2,15 +2,30 @@
 #include "GS2Context.h"
 #include "encoding/graalencoding.h"
 #include "compiler/GS2CompilerVisitor.h"
+#include "compiler/GS2ConstantFolder.h"
 #include "GS2Bytecode.h"
+#include "GS2BytecodeVerifier.h"
 #include "Parser.h"
 
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	uint64_t ElapsedNanoseconds(Clock::time_point from, Clock::time_point to)
+	{
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+	}
+}
+
 GS2Context::GS2Context()
-	: errorService([this](auto && PH1) { handleError(std::forward<decltype(PH1)>(PH1)); })
+	: builtIn(GS2BuiltInFunctions::getBuiltIn()),
+	  errorService([this](auto && PH1) { handleError(std::forward<decltype(PH1)>(PH1)); }),
+	  parserContext(std::make_unique<ParserContext>(errorService))
 {
-	builtIn = GS2BuiltInFunctions::getBuiltIn();
 }
 
+GS2Context::~GS2Context() = default;
+
 void GS2Context::handleError(GS2CompilerError& error)
 {
 	errors.push_back(std::move(error));
@@ -20,39 +35,124 @@ CompilerResponse GS2Context::compile(const std::string& script)
 {
 	errors.clear();
 
-	// Parse the script into an AST tree
-	ParserContext parserContext(errorService);
-	bool success = parserContext.parse(script);
+	// Parse the script into an AST tree, this resets any state left
+	// over from the previous compile
+	auto parseStart = Clock::now();
+	return generate(parserContext->parse(script), parseStart);
+}
+
+CompilerResponse GS2Context::compileInPlace(char *script, size_t length)
+{
+	errors.clear();
+
+	auto parseStart = Clock::now();
+	return generate(parserContext->parseInPlace(script, length), parseStart);
+}
+
+CompilerResponse GS2Context::compile(const std::string& script, const std::string& scriptType, const std::string& scriptName, bool saveToDisk)
+{
+	errors.clear();
+
+	ScriptHeader header{ scriptType, scriptName, saveToDisk };
+	auto parseStart = Clock::now();
+	return generate(parserContext->parse(script), parseStart, &header);
+}
+
+CompilerResponse GS2Context::generate(bool parsed, Clock::time_point parseStart, const ScriptHeader *header)
+{
+	std::optional<GS2CompilerStats> stats;
+	Clock::time_point phaseStart;
+
+	if (options.collectStats)
+	{
+		phaseStart = Clock::now();
+		stats.emplace();
+		stats->parseTime = ElapsedNanoseconds(parseStart, phaseStart);
+
+		// Captured before any later pass allocates into the arena
+		const auto& arena = parserContext->getNodeArena();
+		stats->nodeCount = arena.object_count();
+		stats->arenaBytes = arena.total_allocated();
+		stats->arenaChunks = arena.chunk_count();
+	}
+
+	// Adds the time since the previous phase ended to `phaseTime`
+	auto endPhase = [&](uint64_t GS2CompilerStats::*phaseTime) {
+		if (stats)
+		{
+			auto now = Clock::now();
+			(*stats).*phaseTime = ElapsedNanoseconds(phaseStart, now);
+			phaseStart = now;
+		}
+	};
 
 	// Check for parser errors
-	if (success)
+	if (parsed)
 	{
 		// Grab the root node of the AST tree
-		auto stmtBlock = parserContext.getRootStatement();
+		auto stmtBlock = parserContext->getRootStatement();
 
 		if (stmtBlock)
 		{
+			if (options.constantFolding)
+			{
+				GS2ConstantFolder constantFolder(*parserContext);
+				constantFolder.Visit(stmtBlock);
+				endPhase(&GS2CompilerStats::foldTime);
+			}
+
 			// Walk the AST tree to produce bytecode
-			GS2CompilerVisitor compilerVisitor(parserContext, builtIn);
+			GS2CompilerVisitor compilerVisitor(*parserContext, builtIn, options);
 			compilerVisitor.Visit(stmtBlock);
+			endPhase(&GS2CompilerStats::codegenTime);
+
+			auto bytecode = compilerVisitor.getByteCode(header);
+			endPhase(&GS2CompilerStats::serializeTime);
+
+			bool valid = true;
+			if (options.verify)
+			{
+				GS2BytecodeVerifier verifier(errorService);
+				valid = verifier.verify(bytecode);
+				endPhase(&GS2CompilerStats::verifyTime);
+			}
+
+			if (stats)
+			{
+				stats->totalTime = ElapsedNanoseconds(parseStart, phaseStart);
+				stats->stringCount = compilerVisitor.getStringCount();
+				stats->opCount = compilerVisitor.getOpCount();
+				stats->bytecodeSize = bytecode.length();
+			}
+
+			// Malformed bytecode is never returned, the verifier reported why
+			if (!valid)
+				bytecode = Buffer{};
 
 			return CompilerResponse{
-				true,
+				valid,
 				std::move(errors),
-				compilerVisitor.getByteCode(),
-				compilerVisitor.getJoinedClasses()
+				std::move(bytecode),
+				compilerVisitor.getJoinedClasses(),
+				std::move(stats),
+				compilerVisitor.takeSourceMap()
 			};
 		}
 	}
 	
 	// If we have no errors, lets add one
 	if (errors.empty())
-		parserContext.addParserError("malformed input");
-	
+		parserContext->addParserError("malformed input");
+
+	if (stats)
+		stats->totalTime = stats->parseTime;
+
 	return CompilerResponse{
 		false,
 		std::move(errors),
 		Buffer{},
+		{},
+		std::move(stats)
 	};
 }
 
@@ -62,27 +162,10 @@ Buffer GS2Context::CreateHeader(const Buffer& bytecode, const std::string& scrip
 	if (!bytecode.length())
 		return {};
 
-	// Precalculating the lengths to reduce allocations
-	auto startSectionLength = scriptType.length() + scriptName.length() + 4 + 10;
-	auto headerLength = 2 + startSectionLength + bytecode.length();
-
-	Buffer bytecodeWithHeader(headerLength);
-
-	// Write the length of the header section
-	bytecodeWithHeader.Write<GraalShort>(uint16_t(startSectionLength));
-
-	// Create the sections header
-	bytecodeWithHeader.write(scriptType.c_str(), scriptType.length());
-	bytecodeWithHeader.write(',');
-	bytecodeWithHeader.write(scriptName.c_str(), scriptName.length());
-	bytecodeWithHeader.write(',');
-	bytecodeWithHeader.write(saveToDisk ? '1' : '0');
-	bytecodeWithHeader.write(',');
+	ScriptHeader header{ scriptType, scriptName, saveToDisk };
 
-	// Checksum or key for encrypted files
-	// Needs to be new every time script gets generated, otherwise the client won't request updated script
-	for (int i = 0; i < 10; i++)
-		bytecodeWithHeader.Write<GraalByte>(rand() % 0xFF);
+	Buffer bytecodeWithHeader(header.length() + bytecode.length());
+	header.write(bytecodeWithHeader);
 
 	// Write out the bytecode to the buffer
 	bytecodeWithHeader.write(bytecode);
@@ -3,12 +3,21 @@
 #ifndef GS2CONTEXT_H
 #define GS2CONTEXT_H
 
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <set>
 #include <vector>
 #include "gs2compiler_export.h"
 #include "encoding/buffer.h"
 #include "exceptions/GS2CompilerError.h"
 #include "GS2BuiltInFunctions.h"
+#include "GS2CompilerOptions.h"
+#include "GS2CompilerStats.h"
+#include "GS2SourceMap.h"
+
+class ParserContext;
+struct ScriptHeader;
 
 struct CompilerResponse
 {
@@ -17,24 +26,64 @@ struct CompilerResponse
 
 	Buffer bytecode;
 	std::set<std::string> joinedClasses;
+
+	// Only set when GS2CompilerOptions::collectStats is enabled
+	std::optional<GS2CompilerStats> stats;
+
+	// Only filled when GS2CompilerOptions::sourceMap is enabled
+	GS2SourceMap sourceMap;
 };
 
+/*
+ * A context isn't thread-safe, but contexts don't share any mutable state so
+ * separate contexts can compile concurrently, ex: one context per thread
+ */
 class GS2COMPILER_EXPORT GS2Context
 {
 	public:
 		GS2Context();
+		~GS2Context();
+
+		GS2Context(const GS2Context&) = delete;
+		GS2Context& operator=(const GS2Context&) = delete;
 
 		CompilerResponse compile(const std::string& script);
+
+		/*
+		 * Compiles a script without copying it, the buffer must be followed
+		 * by two null bytes (script[length] and script[length + 1]) and is
+		 * written to while the scanner runs, restoring it afterwards
+		 */
+		CompilerResponse compileInPlace(char *script, size_t length);
+
+		/*
+		 * Compiles a script with the header for the script type and name in front
+		 * of the bytecode, same as CreateHeader without copying the bytecode
+		 */
 		CompilerResponse compile(const std::string& script, const std::string& scriptType, const std::string& scriptName, bool saveToDisk);
 
+		/*
+		 * Optional compiler passes used by subsequent compiles
+		 */
+		const GS2CompilerOptions& getOptions() const;
+		void setOptions(const GS2CompilerOptions& options);
+
 		static Buffer CreateHeader(const Buffer& bytecode, const std::string& scriptType, const std::string& scriptName, bool saveToDisk);
 		static CompilerResponse Compile(const std::string& script);
 		static CompilerResponse Compile(const std::string& script, const std::string& scriptType, const std::string& scriptName, bool saveToDisk);
 
 	private:
-		GS2BuiltInFunctions builtIn;
+		const GS2BuiltInFunctions& builtIn;
 		GS2ErrorService errorService;
 		std::vector<GS2CompilerError> errors;
+		GS2CompilerOptions options;
+
+		/*
+		 * Parser is kept alive between compiles so the scanner, lookup
+		 * tables and node arena can be reused instead of being rebuilt
+		 * for every script
+		 */
+		std::unique_ptr<ParserContext> parserContext;
 
 		/*
 		 * Called whenever an error occurs during any stage of compilation,
@@ -42,15 +91,22 @@ class GS2COMPILER_EXPORT GS2Context
 		 * in CompilerResponse
 		 */
 		void handleError(GS2CompilerError &error);
+
+		/*
+		 * Generates the bytecode for the most recently parsed script,
+		 * parsing started at parseStart
+		 */
+		CompilerResponse generate(bool parsed, std::chrono::steady_clock::time_point parseStart, const ScriptHeader *header = nullptr);
 };
 
-inline CompilerResponse GS2Context::compile(const std::string& script, const std::string& scriptType, const std::string& scriptName, bool saveToDisk)
+inline const GS2CompilerOptions& GS2Context::getOptions() const
 {
-	CompilerResponse results = compile(script);
-	if (results.success)
-		results.bytecode = CreateHeader(results.bytecode, scriptType, scriptName, saveToDisk);
+	return options;
+}
 
-	return results;
+inline void GS2Context::setOptions(const GS2CompilerOptions& opts)
+{
+	options = opts;
 }
 
 inline CompilerResponse GS2Context::Compile(const std::string& script)
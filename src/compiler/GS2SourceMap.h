@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef GS2SOURCEMAP_H
+#define GS2SOURCEMAP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Maps ops in the bytecode segment back to the line of the script they were
+ * compiled from. Each entry covers the ops from its op index up to the op
+ * index of the next entry, entries are sorted by op index
+ */
+struct GS2SourceMapEntry
+{
+	uint32_t opIndex;
+	uint32_t line;
+};
+
+using GS2SourceMap = std::vector<GS2SourceMapEntry>;
+
+/*
+ * Returns the script line an op was compiled from, 0 if unknown
+ */
+inline uint32_t GS2SourceMapLookup(const GS2SourceMap& sourceMap, uint32_t opIndex)
+{
+	auto it = std::upper_bound(sourceMap.begin(), sourceMap.end(), opIndex,
+		[](uint32_t op, const GS2SourceMapEntry& entry) { return op < entry.opIndex; });
+
+	return it == sourceMap.begin() ? 0 : std::prev(it)->line;
+}
+
+#endif
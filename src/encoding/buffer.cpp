@@ -4,49 +4,45 @@
 
 #include "buffer.h"
 
-void Buffer::resize(size_t len)
+namespace
 {
-	if (buf)
+	// First heap allocation, most scripts end up well past the inline storage
+	constexpr size_t MIN_HEAP_CAPACITY = 128;
+}
+
+void Buffer::grow(size_t minLength)
+{
+	size_t newLength = buflen * 2;
+	if (newLength < minLength)
+		newLength = minLength;
+	if (newLength < MIN_HEAP_CAPACITY)
+		newLength = MIN_HEAP_CAPACITY;
+
+	uint8_t *newBuf;
+	if (isInline())
 	{
-		auto tmp = buf;
-		buflen = (len > buflen ? len : buflen * 2);
-		buf = (uint8_t *)realloc(buf, buflen);
-		assert(buf);
-		
-		// silencing msvc warning C6308
-		if (!buf)
-			free(tmp);
+		newBuf = (uint8_t *)malloc(newLength);
+		assert(newBuf);
+		if (newBuf)
+			memcpy(newBuf, inlineBuf, writepos);
 	}
 	else
 	{
-		if (len == 0)
-			len = 128;
-		
-		buf = (uint8_t *)malloc(len);
-		buflen = len;
+		newBuf = (uint8_t *)realloc(buf, newLength);
+		assert(newBuf);
+
+		// silencing msvc warning C6308
+		if (!newBuf)
+			free(buf);
 	}
+
+	buf = newBuf;
+	buflen = newLength;
 }
 
 void Buffer::read(char *dst, size_t len, size_t pos) const
 {
-	if (buflen > pos + len) {
+	if (pos + len <= buflen) {
 		memcpy(dst, buf + pos, len);
 	}
 }
-
-void Buffer::write(const char *src, size_t len)
-{
-	if (buflen < writepos + len)
-		resize(buflen + writepos + len);
-
-    memcpy(buf + writepos, src, len);
-    writepos += len;
-}
-
-void Buffer::write(char val)
-{
-    if (buflen < writepos + 1)
-        resize();
-
-    buf[writepos++] = val;
-}
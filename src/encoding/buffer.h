@@ -9,11 +9,24 @@
 #include <cstdlib>
 #include <utility>
 
+/*
+ * Growable byte buffer used to emit bytecode
+ *
+ * Contents up to INLINE_CAPACITY bytes are stored inside the object itself,
+ * so empty and tiny buffers never allocate. Past that the storage moves to
+ * the heap and grows geometrically, use reserve() when the final size is
+ * known up front.
+ *
+ * The write paths for small values are inline, only growing the storage
+ * goes through an out-of-line call.
+ */
 class Buffer
 {
     public:
-		Buffer();
-		Buffer(size_t len);
+        static constexpr size_t INLINE_CAPACITY = 32;
+
+        Buffer() noexcept;
+        Buffer(size_t len);
         Buffer(Buffer&& o) noexcept;
         Buffer(const Buffer&) = delete;
         ~Buffer();
@@ -37,6 +50,11 @@ class Buffer
             writepos = pos;
         }
 
+        /*
+         * Makes sure at least `len` bytes fit without growing again
+         */
+        void reserve(size_t len);
+
         void read(char *dst, size_t len, size_t pos = 0) const;
         void write(const char *src, size_t len);
         void write(char val);
@@ -61,15 +79,22 @@ class Buffer
         }
 
     private:
-        void resize(size_t len = 0);
+        void grow(size_t minLength);
+        void release() noexcept;
+        void moveFrom(Buffer& o) noexcept;
+
+        bool isInline() const {
+            return buf == inlineBuf;
+        }
 
         uint8_t *buf;
         size_t buflen;
-        size_t readpos, writepos;
+        size_t writepos;
+        uint8_t inlineBuf[INLINE_CAPACITY];
 };
 
-inline Buffer::Buffer()
-    : buf(nullptr), buflen(0), readpos(0), writepos(0)
+inline Buffer::Buffer() noexcept
+    : buf(inlineBuf), buflen(INLINE_CAPACITY), writepos(0)
 {
 
 }
@@ -77,39 +102,84 @@ inline Buffer::Buffer()
 inline Buffer::Buffer(size_t len)
     : Buffer()
 {
-    resize(len);
+    reserve(len);
 }
 
 inline Buffer::Buffer(Buffer&& o) noexcept
+    : Buffer()
 {
-    *this = std::move(o);
+    moveFrom(o);
 }
 
 inline Buffer::~Buffer()
 {
-    if (buf)
+    release();
+}
+
+inline Buffer& Buffer::operator=(Buffer&& o) noexcept
+{
+    if (this != &o)
     {
-        free(buf);
+        release();
+        moveFrom(o);
     }
+
+    return *this;
 }
 
-inline Buffer& Buffer::operator=(Buffer&& o) noexcept
+inline void Buffer::release() noexcept
 {
-	buf = o.buf;
-    buflen = o.buflen;
-    readpos = o.readpos;
+    if (!isInline())
+        free(buf);
+
+    buf = inlineBuf;
+    buflen = INLINE_CAPACITY;
+    writepos = 0;
+}
+
+inline void Buffer::moveFrom(Buffer& o) noexcept
+{
+    if (o.isInline())
+        memcpy(inlineBuf, o.inlineBuf, o.writepos);
+    else
+    {
+        buf = o.buf;
+        buflen = o.buflen;
+    }
+
     writepos = o.writepos;
 
-    o.buf = nullptr;
-    o.buflen = 0;
-    o.readpos = 0;
+    o.buf = o.inlineBuf;
+    o.buflen = INLINE_CAPACITY;
     o.writepos = 0;
-    return *this;
+}
+
+inline void Buffer::reserve(size_t len)
+{
+    if (len > buflen)
+        grow(len);
+}
+
+inline void Buffer::write(const char *src, size_t len)
+{
+    if (buflen - writepos < len)
+        grow(writepos + len);
+
+    memcpy(buf + writepos, src, len);
+    writepos += len;
+}
+
+inline void Buffer::write(char val)
+{
+    if (writepos == buflen)
+        grow(writepos + 1);
+
+    buf[writepos++] = val;
 }
 
 inline void Buffer::write(const Buffer& o)
 {
-    write((char *)o.buf, o.length());
+    write((const char *)o.buf, o.length());
 }
 
 #endif
@@ -3,6 +3,7 @@
 #ifndef GS2ERRORHANDLING_H
 #define GS2ERRORHANDLING_H
 
+#include <cstdint>
 #include <string>
 #include "utils/EventHandler.h"
 
@@ -14,6 +15,18 @@ enum class ErrorLevel
 	E_ALL
 };
 
+/*
+ * Where in the script an error occurred, line and column are 1-based
+ * and zero when unknown. The span covers `length` characters of the
+ * line starting at the column
+ */
+struct GS2SourceLocation
+{
+	uint32_t line = 0;
+	uint32_t column = 0;
+	uint32_t length = 0;
+};
+
 class GS2CompilerError
 {
 public:
@@ -24,8 +37,8 @@ public:
 		Compiler
 	};
 
-	GS2CompilerError(ErrorLevel level, ErrorCategory code, std::string msg)
-			: _code(code), _level(level), _msg(std::move(msg))
+	GS2CompilerError(ErrorLevel level, ErrorCategory code, std::string msg, GS2SourceLocation location = {})
+			: _code(code), _level(level), _msg(std::move(msg)), _location(location)
 	{
 
 	}
@@ -53,10 +66,16 @@ public:
 		return _level;
 	}
 
+	const GS2SourceLocation& location() const
+	{
+		return _location;
+	}
+
 private:
 	ErrorCategory _code;
 	ErrorLevel _level;
 	std::string _msg;
+	GS2SourceLocation _location;
 };
 
 using GS2ErrorService = EventHandler<GS2CompilerError, ErrorLevel>;
@@ -1,18 +1,51 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <csignal>
 #include <filesystem>
+#include <format>
 #include <fstream>
+#include <future>
+#include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <span>
+#include "codegen/GS2BytecodeVerifier.h"
+#include "codegen/GS2Disassembler.h"
 #include "compiler/GS2Context.h"
+#include "server/CompileServer.h"
+#include "utils/ContextThreadPool.h"
+#include "utils/DirectoryWatcher.h"
+#include "utils/JoinGraph.h"
+#include "gs2parser_build_id.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GS2_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#endif
 
 struct Response
 {
 	CompilerResponse response;
 	std::filesystem::path output_file;
 	std::string errmsg;
+	std::chrono::duration<double> compile_time{};
+	bool cache_hit = false;
 };
 
 struct Arguments
@@ -23,15 +56,171 @@ struct Arguments
 	bool verbose = false;
 	bool directory_mode = false;
 	bool multi_file_mode = false;
+	int jobs = 0;	// Not given, --serve then uses a worker per core
+	bool optimize = false;
+	bool source_map = false;
+	bool disasm = false;
+	bool verify = false;
+	bool watch = false;
+	std::filesystem::path cache_dir;
+	std::filesystem::path stats_path;
+	std::filesystem::path deps_path;
+	std::filesystem::path serve_path;
 	std::string error;
 };
 
+#ifndef GS2PARSER_VERSION
+#define GS2PARSER_VERSION "unknown"
+#endif
+
+/*
+ * Content-addressed build cache, entries are keyed by a hash of the source
+ * bytes, the compiler build (a hash of its sources) and the header settings
+ * so unchanged scripts can be skipped by copying the previously compiled
+ * bytecode.
+ *
+ * Each entry is stored as <key>.gs2bc, <key>.classes which holds the
+ * list of joined classes (one per line) and <key>.map when source maps are
+ * enabled. The bytecode file is always renamed into place last, so its
+ * existence marks a complete entry.
+ */
+class BuildCache
+{
+public:
+	explicit BuildCache(std::filesystem::path dir)
+		: directory(std::move(dir))
+	{
+	}
+
+	static std::string makeKey(std::string_view source, const GS2CompilerOptions& options)
+	{
+		// The CLI writes bytecode without the script header, this needs to be
+		// part of the key once header settings become configurable
+		constexpr std::string_view headerSettings = "header:none";
+
+		uint64_t hash = 0xcbf29ce484222325ull;
+		auto fnv1a = [&hash](std::string_view data) {
+			for (unsigned char ch : data)
+			{
+				hash ^= ch;
+				hash *= 0x100000001b3ull;
+			}
+		};
+
+		fnv1a(GS2PARSER_VERSION);
+		fnv1a(GS2PARSER_BUILD_ID);
+		fnv1a(headerSettings);
+		fnv1a(options.peephole ? "peephole:on" : "peephole:off");
+		fnv1a(options.constantFolding ? "folding:on" : "folding:off");
+		fnv1a(options.switchLowering ? "switch:on" : "switch:off");
+		fnv1a(options.sourceMap ? "sourcemap:on" : "sourcemap:off");
+		fnv1a(options.verify ? "verify:on" : "verify:off");
+		fnv1a(source);
+
+		return std::format("{:016x}-{:x}", hash, source.size());
+	}
+
+	bool fetch(const std::string& key, const std::filesystem::path& outputPath, std::set<std::string>& joinedClasses,
+		const std::filesystem::path& sourceMapPath = {})
+	{
+		std::error_code ec;
+		auto entry = directory / (key + ".gs2bc");
+		if (!std::filesystem::exists(entry, ec))
+		{
+			++misses;
+			return false;
+		}
+
+		std::ifstream classes(directory / (key + ".classes"));
+		for (std::string line; std::getline(classes, line);)
+			joinedClasses.insert(line);
+
+		std::filesystem::copy_file(entry, outputPath, std::filesystem::copy_options::overwrite_existing, ec);
+		if (!ec && !sourceMapPath.empty())
+			std::filesystem::copy_file(directory / (key + ".map"), sourceMapPath, std::filesystem::copy_options::overwrite_existing, ec);
+
+		if (ec)
+		{
+			joinedClasses.clear();
+			++misses;
+			return false;
+		}
+
+		++hits;
+		return true;
+	}
+
+	void store(const std::string& key, const CompilerResponse& response, std::string_view sourceMap = {})
+	{
+		std::string classes;
+		for (const auto& cls : response.joinedClasses)
+			classes.append(cls).append("\n");
+
+		// Class list and source map first, the bytecode file marks the entry as complete
+		if (!writeEntry(key + ".classes", classes.data(), classes.size()))
+			return;
+
+		if (!sourceMap.empty() && !writeEntry(key + ".map", sourceMap.data(), sourceMap.size()))
+			return;
+
+		writeEntry(key + ".gs2bc", response.bytecode.buffer(), response.bytecode.length());
+	}
+
+	int getHits() const { return hits.load(); }
+	int getMisses() const { return misses.load(); }
+
+private:
+	/*
+	 * Writes to a temporary file then renames it into place, so concurrent
+	 * readers never observe a partially written file. The temporary name is
+	 * unique per process and thread, as gs2test runs can share a cache
+	 */
+	bool writeEntry(const std::string& name, const void* data, size_t length)
+	{
+		auto tmpPath = directory / std::format("{}.tmp{}-{}", name, getpid(), std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+		{
+			std::ofstream outstream(tmpPath, std::ios::binary | std::ios::trunc);
+			outstream.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(length));
+			if (!outstream)
+				return false;
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmpPath, directory / name, ec);
+		if (ec)
+		{
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+
+		return true;
+	}
+
+	std::filesystem::path directory;
+	std::atomic<int> hits{ 0 };
+	std::atomic<int> misses{ 0 };
+};
+
+struct CompileOptions
+{
+	bool verbose = false;
+	int jobs = 1;
+	BuildCache* cache = nullptr;
+	GS2CompilerOptions compiler;
+	std::filesystem::path stats_path;
+	std::filesystem::path deps_path;
+};
+
 constexpr const char* HELP_TEXT = R"(
 GS2 Script Compiler
 
 Usage:
   %s [OPTIONS] INPUT [OUTPUT]
   %s INPUT -o OUTPUT
+  %s --disasm INPUT... [-o OUTPUT]
+  %s --serve SOCKET [-j N]
+  %s --watch DIRECTORY
   %s --help
 
 Arguments:
@@ -40,6 +229,23 @@ Arguments:
 
 Options:
   -o, --output FILE  Specify output file
+  -j, --jobs N       Compile multiple files using N worker threads
+  -O, --optimize     Enable bytecode optimizations
+  --cache-dir DIR    Reuse bytecode of unchanged scripts from DIR
+  --stats FILE       Write per-phase compile statistics as JSON (- for stdout)
+  --deps FILE        Write the classes every script joins as JSON (- for
+                     stdout), with their load order, join cycles and the
+                     classes affected by the scripts that changed
+  --source-map       Also write the script line of every op to OUTPUT.map
+  --verify           Check the bytecode for malformed jumps and operands, and
+                     fail the compile instead of writing it. With --disasm,
+                     .gs2bc files are checked before they are listed
+  --disasm           Print the bytecode of compiled (.gs2bc) or source files,
+                     directories are searched for .gs2bc files
+  --serve SOCKET     Compile scripts sent over a Unix domain socket until
+                     interrupted, on -j workers (default: one per core)
+  --watch            Compile the directory, then recompile scripts as they
+                     are saved until interrupted
   -v, --verbose      Verbose output
   -h, --help         Show this help message
 
@@ -49,6 +255,14 @@ Examples:
   %s script.gs2 -o output.gs2bc    # Creates output.gs2bc
   %s scripts/                      # Process directory
   %s file1.gs2 file2.gs2 file3.gs2 # Process multiple files (drag & drop)
+  %s -j 8 scripts/                 # Process directory with 8 threads
+  %s --cache-dir .cache scripts/   # Only recompile changed scripts
+  %s -O script.gs2                 # Creates optimized script.gs2bc
+  %s --stats - scripts/            # Print where compile time goes
+  %s --cache-dir .cache --deps - scripts/ # Which classes to reload
+  %s --disasm build/ -o before.txt # Listing of every .gs2bc, to diff later
+  %s --serve /tmp/gs2.sock -j 4    # Compile server with 4 warm contexts
+  %s --watch -j 4 scripts/         # Recompile scripts as they are edited
 )";
 
 constexpr size_t count_placeholders(const std::string_view str)
@@ -108,6 +322,78 @@ Arguments parseArguments(int argc, const char* argv[])
 			}
 			args.output_path = arg_span[i];
 		}
+		else if (arg == "--jobs" || arg == "-j")
+		{
+			if (++i >= arg_span.size())
+			{
+				args.error = "Missing thread count after " + std::string(arg);
+				return args;
+			}
+
+			std::string_view count = arg_span[i];
+			auto [ptr, ec] = std::from_chars(count.data(), count.data() + count.size(), args.jobs);
+			if (ec != std::errc() || ptr != count.data() + count.size() || args.jobs < 1)
+			{
+				args.error = "Invalid thread count: " + std::string(count);
+				return args;
+			}
+		}
+		else if (arg == "--optimize" || arg == "-O")
+		{
+			args.optimize = true;
+		}
+		else if (arg == "--source-map")
+		{
+			args.source_map = true;
+		}
+		else if (arg == "--verify")
+		{
+			args.verify = true;
+		}
+		else if (arg == "--disasm")
+		{
+			args.disasm = true;
+		}
+		else if (arg == "--watch")
+		{
+			args.watch = true;
+		}
+		else if (arg == "--cache-dir")
+		{
+			if (++i >= arg_span.size())
+			{
+				args.error = "Missing cache directory after " + std::string(arg);
+				return args;
+			}
+			args.cache_dir = arg_span[i];
+		}
+		else if (arg == "--serve")
+		{
+			if (++i >= arg_span.size())
+			{
+				args.error = "Missing socket path after " + std::string(arg);
+				return args;
+			}
+			args.serve_path = arg_span[i];
+		}
+		else if (arg == "--stats")
+		{
+			if (++i >= arg_span.size())
+			{
+				args.error = "Missing stats file after " + std::string(arg);
+				return args;
+			}
+			args.stats_path = arg_span[i];
+		}
+		else if (arg == "--deps")
+		{
+			if (++i >= arg_span.size())
+			{
+				args.error = "Missing dependency file after " + std::string(arg);
+				return args;
+			}
+			args.deps_path = arg_span[i];
+		}
 		else if (arg.starts_with('-'))
 		{
 			args.error = "Unknown option: " + std::string(arg);
@@ -117,12 +403,28 @@ Arguments parseArguments(int argc, const char* argv[])
 			args.input_paths.emplace_back(arg);
 	}
 
+	// Scripts arrive over the socket
+	if (!args.serve_path.empty())
+	{
+		if (!args.input_paths.empty() || !args.output_path.empty() || args.disasm)
+			args.error = "--serve doesn't take input or output files";
+		return args;
+	}
+
 	if (args.input_paths.empty())
 	{
 		args.error = "No input file specified";
 		return args;
 	}
 
+	// Every input is listed, the output is only ever given with -o
+	if (args.disasm)
+	{
+		if (args.watch)
+			args.error = "--watch can't be combined with --disasm";
+		return args;
+	}
+
 	// Handle positional INPUT OUTPUT form
 	if (args.input_paths.size() == 2 && args.output_path.empty())
 	{
@@ -143,12 +445,22 @@ Arguments parseArguments(int argc, const char* argv[])
 				return args;
 			}
 		}
+		else if (args.watch)
+		{
+			args.error = "--watch takes a single directory";
+			return args;
+		}
 		else if (args.output_path.empty())
 		{
 			args.output_path = input_path;
 			args.output_path.replace_extension(".gs2bc");
 		}
 	}
+	else if (args.watch)
+	{
+		args.error = "--watch takes a single directory";
+		return args;
+	}
 	else
 	{
 		args.multi_file_mode = true;
@@ -171,62 +483,252 @@ Arguments parseArguments(int argc, const char* argv[])
 	return args;
 }
 
-Response compileFile(const std::filesystem::path& filePath, const std::filesystem::path& outputPath = {})
+/*
+ * Script loaded from disk, followed by the two null bytes the scanner
+ * needs so it can be compiled in place. With Access::Map the file is mapped
+ * copy-on-write where possible instead of read, this avoids copying large
+ * scripts into memory before the scanner gets to them.
+ *
+ * Mapped pages that are never written still follow the file on disk: a
+ * write while the script is compiled changes the input halfway through the
+ * parse, and truncating the file kills the process with SIGBUS. Only map
+ * files for a one-shot run, anything that may compile a file while it is
+ * being saved (the -j workers, watch mode) reads it with Access::Read.
+ */
+class SourceFile
 {
-	static GS2Context context;
-	Response result{};
+public:
+	enum class Access
+	{
+		Map,
+		Read
+	};
+
+	SourceFile() = default;
+	SourceFile(const SourceFile&) = delete;
+	SourceFile& operator=(const SourceFile&) = delete;
 
-	// Read file using C++ streams
-	std::ifstream file(filePath, std::ios::binary);
-	if (!file)
+	~SourceFile()
 	{
-		result.errmsg = "Cannot open file.";
-		return result;
+#ifdef GS2_HAVE_MMAP
+		if (mapped)
+			munmap(mapped, length + 2);
+#endif
 	}
 
-	std::string script((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	bool open(const std::filesystem::path& path, Access access = Access::Map)
+	{
+#ifdef GS2_HAVE_MMAP
+		if (access == Access::Map && map(path))
+			return true;
+#endif
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		length = buffer.size();
+		buffer.push_back('\0');
+		buffer.push_back('\0');
+		return true;
+	}
 
-	result.response = context.compile(script);
+	char* data() { return mapped ? mapped : buffer.data(); }
+	size_t size() const { return length; }
+	std::string_view view() const { return { mapped ? mapped : buffer.data(), length }; }
 
-	if (!result.response.errors.empty())
+private:
+#ifdef GS2_HAVE_MMAP
+	bool map(const std::filesystem::path& path)
 	{
-		for (const auto& err: result.response.errors)
-			result.errmsg.append(err.msg()).append("\n");
-		return result;
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st{};
+		size_t pageSize = sysconf(_SC_PAGESIZE);
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		{
+			// The null bytes come from the zero-filled tail of the last page,
+			// so there must be room for them without mapping past it
+			size_t fileSize = st.st_size;
+			size_t tail = fileSize % pageSize;
+			if (tail != 0 && tail <= pageSize - 2)
+			{
+				void* ptr = mmap(nullptr, fileSize + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+				if (ptr != MAP_FAILED)
+				{
+					mapped = static_cast<char*>(ptr);
+					length = fileSize;
+				}
+			}
+		}
+
+		close(fd);
+		return mapped != nullptr;
 	}
+#endif
+
+	char* mapped = nullptr;
+	size_t length = 0;
+	std::vector<char> buffer;
+};
+
+/*
+ * Source map written next to the bytecode, the op index each run of
+ * ops starts at and the script line they were compiled from
+ */
+std::string formatSourceMap(const GS2SourceMap& sourceMap)
+{
+	std::string json = R"({ "version": 1, "entries": [)";
+	for (size_t i = 0; i < sourceMap.size(); i++)
+		json.append(std::format("{}[{}, {}]", i ? ", " : "", sourceMap[i].opIndex, sourceMap[i].line));
+	json.append("] }\n");
+	return json;
+}
+
+/*
+ * Compiles a script that was already loaded from `filePath`, the buffer
+ * is compiled in place
+ */
+Response compileSource(GS2Context& context, SourceFile& script, const std::filesystem::path& filePath,
+	const std::filesystem::path& outputPath = {}, BuildCache* cache = nullptr,
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now())
+{
+	Response result{};
 
 	// Determine output path
 	result.output_file = outputPath.empty()
 							 ? filePath.parent_path() / filePath.stem().concat(".gs2bc")
 							 : outputPath;
 
+	bool writeSourceMap = context.getOptions().sourceMap;
+	auto sourceMapPath = writeSourceMap ? std::filesystem::path(result.output_file).concat(".map") : std::filesystem::path{};
+
+	std::string cacheKey;
+	if (cache)
+	{
+		cacheKey = BuildCache::makeKey(script.view(), context.getOptions());
+		if (cache->fetch(cacheKey, result.output_file, result.response.joinedClasses, sourceMapPath))
+		{
+			result.response.success = true;
+			result.cache_hit = true;
+			result.compile_time = std::chrono::high_resolution_clock::now() - start;
+			return result;
+		}
+	}
+
+	result.response = context.compileInPlace(script.data(), script.size());
+
+	if (!result.response.errors.empty())
+	{
+		for (const auto& err: result.response.errors)
+			result.errmsg.append(err.msg()).append("\n");
+
+		result.output_file.clear();
+		result.compile_time = std::chrono::high_resolution_clock::now() - start;
+		return result;
+	}
+
 	// Write bytecode
-	std::ofstream outstream(result.output_file, std::ios::binary);
-	outstream.write(reinterpret_cast<const char*>(result.response.bytecode.buffer()),
-		static_cast<std::streamsize>(result.response.bytecode.length()));
+	{
+		std::ofstream outstream(result.output_file, std::ios::binary);
+		outstream.write(reinterpret_cast<const char*>(result.response.bytecode.buffer()),
+			static_cast<std::streamsize>(result.response.bytecode.length()));
+	}
+
+	std::string sourceMap;
+	if (writeSourceMap)
+	{
+		sourceMap = formatSourceMap(result.response.sourceMap);
+		std::ofstream outstream(sourceMapPath, std::ios::binary);
+		outstream.write(sourceMap.data(), static_cast<std::streamsize>(sourceMap.size()));
+	}
 
+	if (cache)
+		cache->store(cacheKey, result.response, sourceMap);
+
+	result.compile_time = std::chrono::high_resolution_clock::now() - start;
 	return result;
 }
 
-bool compileAndReport(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath = {}, bool verbose = false)
+Response compileFile(GS2Context& context, const std::filesystem::path& filePath, const std::filesystem::path& outputPath = {},
+	BuildCache* cache = nullptr, SourceFile::Access access = SourceFile::Access::Map)
 {
-	if (!std::filesystem::exists(inputPath))
+	auto start = std::chrono::high_resolution_clock::now();
+
+	SourceFile script;
+	if (!script.open(filePath, access))
 	{
-		printf(" -> [ERROR] File does not exist\n");
-		return false;
+		Response result{};
+		result.errmsg = "Cannot open file.";
+		return result;
 	}
 
-	if (verbose)
-		printf("Compiling file %s\n", inputPath.c_str());
+	return compileSource(context, script, filePath, outputPath, cache, start);
+}
 
-	auto start = std::chrono::high_resolution_clock::now();
-	auto result = compileFile(inputPath, outputPath);
-	auto finish = std::chrono::high_resolution_clock::now();
+/*
+ * Compiles a single file on one of the workers of the thread pool,
+ * each worker owns its own GS2Context which is reused between jobs.
+ * Files are read rather than mapped, see SourceFile. A job can also be
+ * given the script already loaded, so it compiles exactly those bytes
+ */
+class FileCompileJob
+{
+public:
+	struct job_result {
+		Response response;
+	};
+
+	struct thread_context {
+		GS2Context gs2context;
+	};
 
+	using promise_type = std::promise<job_result>;
+
+public:
+	FileCompileJob(std::filesystem::path inputPath, std::filesystem::path outputPath, const GS2CompilerOptions& options,
+		BuildCache* cache = nullptr)
+		: _inputPath(std::move(inputPath)), _outputPath(std::move(outputPath)), _options(options), _cache(cache)
+	{
+	}
+
+	FileCompileJob(std::shared_ptr<SourceFile> source, std::filesystem::path inputPath, const GS2CompilerOptions& options,
+		BuildCache* cache = nullptr)
+		: _source(std::move(source)), _inputPath(std::move(inputPath)), _options(options), _cache(cache)
+	{
+	}
+
+	void run(thread_context& th_context, promise_type& promise)
+	{
+		th_context.gs2context.setOptions(_options);
+		if (_source)
+			promise.set_value({ compileSource(th_context.gs2context, *_source, _inputPath, _outputPath, _cache) });
+		else
+			promise.set_value({ compileFile(th_context.gs2context, _inputPath, _outputPath, _cache, SourceFile::Access::Read) });
+	}
+
+	static void init(thread_context& th_context)
+	{
+
+	}
+
+private:
+	std::shared_ptr<SourceFile> _source;
+	std::filesystem::path _inputPath;
+	std::filesystem::path _outputPath;
+	GS2CompilerOptions _options;
+	BuildCache* _cache;
+};
+
+bool reportResult(const std::filesystem::path& inputPath, const Response& result, bool verbose)
+{
 	if (verbose)
 	{
-		std::chrono::duration<double> diff = finish - start;
-		printf("Compiled in %f seconds\n", diff.count());
+		printf("Compiling file %s\n", inputPath.c_str());
+		printf("Compiled in %f seconds\n", result.compile_time.count());
 	}
 
 	if (!result.errmsg.empty())
@@ -241,24 +743,230 @@ bool compileAndReport(const std::filesystem::path& inputPath, const std::filesys
 	return true;
 }
 
-void processFileList(const std::vector<std::filesystem::path>& files, bool verbose, std::string_view mode_name = "",
+struct FileStats
+{
+	std::filesystem::path path;
+	bool success = false;
+	bool cached = false;
+	std::optional<GS2CompilerStats> stats;
+};
+
+std::string escapeJson(std::string_view str)
+{
+	std::string out;
+	out.reserve(str.size());
+
+	for (unsigned char ch : str)
+	{
+		switch (ch)
+		{
+			case '"': out.append("\\\""); break;
+			case '\\': out.append("\\\\"); break;
+			case '\n': out.append("\\n"); break;
+			case '\t': out.append("\\t"); break;
+			default:
+				if (ch < 0x20)
+					out.append(std::format("\\u{:04x}", ch));
+				else
+					out.push_back(char(ch));
+				break;
+		}
+	}
+
+	return out;
+}
+
+std::string formatStats(const GS2CompilerStats& stats)
+{
+	return std::format(R"("parse_ns": {}, "fold_ns": {}, "codegen_ns": {}, "serialize_ns": {}, "verify_ns": {}, "total_ns": {}, )"
+		R"("nodes": {}, "arena_bytes": {}, "arena_chunks": {}, "strings": {}, "ops": {}, "bytecode_bytes": {})",
+		stats.parseTime, stats.foldTime, stats.codegenTime, stats.serializeTime, stats.verifyTime, stats.totalTime,
+		stats.nodeCount, stats.arenaBytes, stats.arenaChunks, stats.stringCount, stats.opCount, stats.bytecodeSize);
+}
+
+/*
+ * Writes the statistics of every compiled file, along with their sum, as
+ * a JSON document. Files restored from the build cache have no statistics
+ */
+bool writeStats(const std::filesystem::path& path, const std::vector<FileStats>& files)
+{
+	GS2CompilerStats totals;
+	size_t compiled = 0;
+
+	std::string json = "{\n  \"files\": [";
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		const auto& file = files[i];
+		json.append(i ? ",\n" : "\n");
+		json.append(std::format(R"(    {{ "path": "{}", "success": {}, "cached": {})",
+			escapeJson(file.path.generic_string()), file.success, file.cached));
+
+		if (file.stats)
+		{
+			const auto& stats = *file.stats;
+			json.append(", ").append(formatStats(stats));
+
+			totals.parseTime += stats.parseTime;
+			totals.foldTime += stats.foldTime;
+			totals.codegenTime += stats.codegenTime;
+			totals.serializeTime += stats.serializeTime;
+			totals.verifyTime += stats.verifyTime;
+			totals.totalTime += stats.totalTime;
+			totals.nodeCount += stats.nodeCount;
+			totals.arenaBytes += stats.arenaBytes;
+			totals.arenaChunks += stats.arenaChunks;
+			totals.stringCount += stats.stringCount;
+			totals.opCount += stats.opCount;
+			totals.bytecodeSize += stats.bytecodeSize;
+			++compiled;
+		}
+
+		json.append(" }");
+	}
+
+	json.append(std::format("\n  ],\n  \"totals\": {{ \"files\": {}, {} }}\n}}\n", compiled, formatStats(totals)));
+
+	if (path == "-")
+	{
+		std::cout << json;
+		return bool(std::cout);
+	}
+
+	std::ofstream outstream(path, std::ios::binary | std::ios::trunc);
+	outstream.write(json.data(), static_cast<std::streamsize>(json.size()));
+	return bool(outstream);
+}
+
+std::string formatJsonList(const std::vector<std::string>& names)
+{
+	std::string json = "[";
+	for (size_t i = 0; i < names.size(); i++)
+		json.append(i ? ", \"" : "\"").append(escapeJson(names[i])).append("\"");
+	return json.append("]");
+}
+
+/*
+ * Writes the join graph of the compiled scripts as a JSON document, along
+ * with the order to load them in and the classes to reload because of the
+ * scripts that were compiled again
+ */
+bool writeJoinGraph(const std::filesystem::path& path, const JoinGraph& graph, const std::vector<std::string>& changed)
+{
+	std::string json = "{\n  \"classes\": {";
+	bool first = true;
+	for (const auto& [name, joins] : graph.getClasses())
+	{
+		json.append(first ? "\n" : ",\n").append(std::format(R"(    "{}": {})", escapeJson(name), formatJsonList(joins)));
+		first = false;
+	}
+
+	json.append("\n  },\n  \"cycles\": [");
+	auto cycles = graph.cycles();
+	for (size_t i = 0; i < cycles.size(); i++)
+		json.append(i ? ", " : "").append(formatJsonList(cycles[i]));
+
+	json.append(std::format("],\n  \"order\": {},\n  \"unresolved\": {},\n  \"changed\": {},\n  \"affected\": {}\n}}\n",
+		formatJsonList(graph.order()), formatJsonList(graph.unresolved()), formatJsonList(changed),
+		formatJsonList(graph.affectedBy(changed))));
+
+	if (path == "-")
+	{
+		std::cout << json;
+		return bool(std::cout);
+	}
+
+	std::ofstream outstream(path, std::ios::binary | std::ios::trunc);
+	outstream.write(json.data(), static_cast<std::streamsize>(json.size()));
+	return bool(outstream);
+}
+
+/*
+ * Scripts are compiled on their own, but a class that joins itself through
+ * other classes most likely wasn't meant to
+ */
+void reportJoinCycles(const JoinGraph& graph, const std::vector<std::string>& changed = {})
+{
+	for (const auto& cycle : graph.cycles())
+	{
+		bool involved = changed.empty() || std::any_of(cycle.begin(), cycle.end(), [&](const std::string& name) {
+			return std::find(changed.begin(), changed.end(), name) != changed.end();
+		});
+
+		if (!involved)
+			continue;
+
+		std::string names;
+		for (const auto& name : cycle)
+			names.append(names.empty() ? "" : ", ").append(name);
+		printf(" -> [WARNING] Classes join each other: %s\n", names.c_str());
+	}
+}
+
+void processFileList(const std::vector<std::filesystem::path>& files, const CompileOptions& options, std::string_view mode_name = "",
 	const std::filesystem::path& single_output = {})
 {
+	static GS2Context context;
+	context.setOptions(options.compiler);
+
 	int processed = 0;
 	int errors = 0;
 
 	if (!mode_name.empty())
 		printf("Processing %zu files (%s mode):\n\n", files.size(), mode_name.data());
 
-	for (const auto& file_path: files)
+	// Queue every file up front when compiling in parallel, the results are
+	// still reported in input order so the output matches a serial run
+	std::vector<FileStats> stats;
+	JoinGraph joinGraph;
+	std::vector<std::string> changedClasses;
+	std::unique_ptr<CustomThreadPool<FileCompileJob>> pool;
+	std::vector<std::future<FileCompileJob::job_result>> results;
+
+	if (options.jobs > 1 && files.size() > 1)
+	{
+		pool = std::make_unique<CustomThreadPool<FileCompileJob>>(std::min<int>(options.jobs, int(files.size())));
+		results.reserve(files.size());
+
+		for (const auto& file_path: files)
+		{
+			if (std::filesystem::exists(file_path))
+				results.push_back(pool->queue(FileCompileJob(file_path, {}, options.compiler, options.cache)));
+			else
+				results.emplace_back();
+		}
+	}
+
+	for (size_t i = 0; i < files.size(); i++)
 	{
+		const auto& file_path = files[i];
+
 		if (!mode_name.empty())
 			printf("Processing: %s\n", file_path.filename().c_str());
 
 		auto output = files.size() == 1 && !single_output.empty() ? single_output : std::filesystem::path{};
-		bool success = compileAndReport(file_path, output, verbose);
 
-		if (files.size() == 1 && !verbose && success)
+		bool success;
+		if (pool ? !results[i].valid() : !std::filesystem::exists(file_path))
+		{
+			printf(" -> [ERROR] File does not exist\n");
+			success = false;
+		}
+		else
+		{
+			auto result = pool ? results[i].get().response : compileFile(context, file_path, output, options.cache);
+			success = reportResult(file_path, result, options.verbose);
+
+			// Classes are named after their script
+			auto className = file_path.stem().string();
+			joinGraph.setClass(className, result.response.joinedClasses);
+			if (!result.cache_hit)
+				changedClasses.push_back(className);
+
+			if (!options.stats_path.empty())
+				stats.push_back({ file_path, success, result.cache_hit, std::move(result.response.stats) });
+		}
+
+		if (files.size() == 1 && !options.verbose && success)
 		{
 			auto final_output = output.empty() ? file_path.parent_path() / file_path.stem().concat(".gs2bc") : output;
 			printf("Compilation successful\n -> saved to %s\n", final_output.c_str());
@@ -267,8 +975,21 @@ void processFileList(const std::vector<std::filesystem::path>& files, bool verbo
 		success ? processed++ : errors++;
 	}
 
+	if (files.size() > 1)
+		reportJoinCycles(joinGraph);
+
 	if (!mode_name.empty())
 		printf("\n%s processing complete: %d files processed, %d errors\n", mode_name.data(), processed, errors);
+
+	if (options.verbose && options.cache)
+		printf("Build cache: %d hits, %d misses\n", options.cache->getHits(), options.cache->getMisses());
+
+	if (!options.stats_path.empty() && !writeStats(options.stats_path, stats))
+		std::cerr << "Error: Cannot write stats to " << options.stats_path << "\n";
+
+	std::sort(changedClasses.begin(), changedClasses.end());
+	if (!options.deps_path.empty() && !writeJoinGraph(options.deps_path, joinGraph, changedClasses))
+		std::cerr << "Error: Cannot write dependencies to " << options.deps_path << "\n";
 }
 
 std::vector<std::filesystem::path> gatherFilesFromDirectory(const std::filesystem::path& dir_path, bool verbose)
@@ -289,7 +1010,7 @@ std::vector<std::filesystem::path> gatherFilesFromDirectory(const std::filesyste
 	return files;
 }
 
-int processDirectory(const std::filesystem::path& input_path, bool verbose)
+int processDirectory(const std::filesystem::path& input_path, const CompileOptions& options)
 {
 	if (!std::filesystem::exists(input_path) || !std::filesystem::is_directory(input_path))
 	{
@@ -297,11 +1018,340 @@ int processDirectory(const std::filesystem::path& input_path, bool verbose)
 		return 1;
 	}
 
-	if (verbose)
+	if (options.verbose)
 		printf("Scanning directory: %s\n", input_path.c_str());
 
-	processFileList(gatherFilesFromDirectory(input_path, verbose), verbose, "Directory");
+	processFileList(gatherFilesFromDirectory(input_path, options.verbose), options, "Directory");
+	return 0;
+}
+
+/*
+ * Prints a listing of every compiled script, inputs that are still source
+ * are compiled in memory first. Directories are searched for .gs2bc files,
+ * with --verify those are run through the verifier before being listed
+ */
+int disassembleFiles(const std::vector<std::filesystem::path>& inputs, const std::filesystem::path& outputPath, const CompileOptions& options)
+{
+	std::vector<std::filesystem::path> files;
+	for (const auto& input : inputs)
+	{
+		std::error_code ec;
+		if (!std::filesystem::is_directory(input, ec))
+		{
+			files.push_back(input);
+			continue;
+		}
+
+		auto first = files.size();
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(input, ec))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".gs2bc")
+				files.push_back(entry.path());
+		}
+
+		std::sort(files.begin() + first, files.end());
+	}
+
+	FILE* out = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "wb");
+	if (!out)
+	{
+		std::cerr << "Error: Cannot open output file: " << outputPath << "\n";
+		return 1;
+	}
+
+	GS2Context context;
+	context.setOptions(options.compiler);
+
+	std::string verifyErrors;
+	GS2ErrorService errorService([&verifyErrors](GS2CompilerError& error) {
+		verifyErrors.append(error.msg()).append("\n");
+	});
+	GS2BytecodeVerifier verifier(errorService);
+
+	// The disassembler points into the bytecode, which has to live until the listing is printed
+	GS2Disassembler disassembler;
+	CompilerResponse response;
+	std::vector<char> bytecode;
+	std::string listing;
+	int errors = 0;
+
+	for (const auto& file : files)
+	{
+		listing.clear();
+		if (files.size() > 1)
+			listing.append(std::format("; file: {}\n", file.generic_string()));
+
+		std::string errmsg;
+		if (file.extension() == ".gs2bc")
+		{
+			std::ifstream instream(file, std::ios::binary);
+			if (!instream)
+				errmsg = "Cannot open file.";
+			else
+			{
+				bytecode.assign(std::istreambuf_iterator<char>(instream), std::istreambuf_iterator<char>());
+				auto data = reinterpret_cast<const uint8_t*>(bytecode.data());
+
+				verifyErrors.clear();
+				if (options.compiler.verify && !verifier.verify(data, bytecode.size()))
+					errmsg = verifyErrors;
+				else if (!disassembler.disassemble(data, bytecode.size()))
+					errmsg = disassembler.getError();
+			}
+		}
+		else
+		{
+			SourceFile script;
+			if (!script.open(file))
+				errmsg = "Cannot open file.";
+			else
+			{
+				response = context.compileInPlace(script.data(), script.size());
+				for (const auto& err : response.errors)
+					errmsg.append(err.msg()).append("\n");
+
+				if (errmsg.empty() && !disassembler.disassemble(response.bytecode))
+					errmsg = disassembler.getError();
+			}
+		}
+
+		if (!errmsg.empty())
+		{
+			std::cerr << "Error: " << file.generic_string() << ": " << errmsg << "\n";
+			++errors;
+			continue;
+		}
+
+		disassembler.print(listing);
+		if (files.size() > 1)
+			listing.push_back('\n');
+
+		fwrite(listing.data(), 1, listing.size(), out);
+	}
+
+	if (out != stdout)
+		fclose(out);
+
+	return errors ? 1 : 0;
+}
+
+// Long-running modes stop on SIGINT and SIGTERM. The handler may run on any
+// thread, the pointers are lock-free atomics so it always sees a whole value
+#ifdef GS2_HAVE_UNIX_SOCKETS
+std::atomic<CompileServer*> activeServer{ nullptr };
+static_assert(std::atomic<CompileServer*>::is_always_lock_free);
+#endif
+#ifdef GS2_HAVE_INOTIFY
+std::atomic<DirectoryWatcher*> activeWatcher{ nullptr };
+#endif
+
+void stopLongRunning(int)
+{
+#ifdef GS2_HAVE_UNIX_SOCKETS
+	if (auto server = activeServer.load())
+		server->stop();
+#endif
+#ifdef GS2_HAVE_INOTIFY
+	if (auto watcher = activeWatcher.load())
+		watcher->stop();
+#endif
+}
+
+/*
+ * Compiles the scripts sent over a Unix domain socket until the
+ * process is interrupted or terminated
+ */
+int serveRequests(const std::filesystem::path& socketPath, int jobs, const CompileOptions& options)
+{
+#ifdef GS2_HAVE_UNIX_SOCKETS
+	CompileServer server(socketPath, jobs, options.compiler, options.verbose);
+
+	std::string error;
+	if (!server.listen(error))
+	{
+		std::cerr << "Error: " << error << ": " << socketPath << "\n";
+		return 1;
+	}
+
+	activeServer = &server;
+	std::signal(SIGINT, stopLongRunning);
+	std::signal(SIGTERM, stopLongRunning);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	printf("Serving on %s with %d workers\n", socketPath.c_str(), jobs);
+	fflush(stdout);
+
+	server.run();
+	activeServer = nullptr;
+
+	printf("Served %llu requests\n", static_cast<unsigned long long>(server.getRequestCount()));
+	return 0;
+#else
+	std::cerr << "Error: --serve is not supported on this platform\n";
+	return 1;
+#endif
+}
+
+/*
+ * A script compiled in watch mode, kept between rounds so saving a
+ * file without changing it doesn't compile it again
+ */
+struct WatchedScript
+{
+	std::string key;
+	Response result;
+};
+
+/*
+ * Compiles the directory, then every script that is written or moved into
+ * it until the process is interrupted. The worker threads, and the context
+ * each of them owns, are kept for the whole session
+ */
+int watchDirectory(const std::filesystem::path& dir, const CompileOptions& options)
+{
+#ifdef GS2_HAVE_INOTIFY
+	// Editors save in a burst of events, a round starts once it is over
+	constexpr std::chrono::milliseconds quietPeriod(5);
+
+	DirectoryWatcher watcher(dir);
+
+	std::string error;
+	if (!watcher.start(error))
+	{
+		std::cerr << "Error: " << error << "\n";
+		return 1;
+	}
+
+	activeWatcher = &watcher;
+	std::signal(SIGINT, stopLongRunning);
+	std::signal(SIGTERM, stopLongRunning);
+
+	CustomThreadPool<FileCompileJob> pool(options.jobs);
+	std::map<std::filesystem::path, WatchedScript> scripts;
+	JoinGraph joinGraph;
+	std::vector<std::string> removedClasses;
+
+	auto compileRound = [&](const std::vector<std::filesystem::path>& files) {
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::pair<std::filesystem::path, std::future<FileCompileJob::job_result>>> queued;
+		for (const auto& file : files)
+		{
+			auto ext = file.extension();
+			if (ext != ".gs2" && ext != ".txt")
+				continue;
+
+			// The file is read once, and the job compiles the same bytes the
+			// key was made from. An editor may be saving it again, so it is
+			// never mapped (see SourceFile)
+			auto source = std::make_shared<SourceFile>();
+			if (!source->open(file, SourceFile::Access::Read))
+				continue;	// Removed again before the round started
+
+			auto key = BuildCache::makeKey(source->view(), options.compiler);
+			auto& script = scripts[file];
+			if (script.key == key)
+			{
+				if (options.verbose)
+					printf("Unchanged: %s\n", file.filename().c_str());
+				continue;
+			}
+
+			script.key = std::move(key);
+			queued.emplace_back(file, pool.queue(FileCompileJob(std::move(source), file, options.compiler, options.cache)));
+		}
+
+		int errors = 0;
+		std::vector<std::string> changedClasses = std::move(removedClasses);
+		for (auto& [file, future] : queued)
+		{
+			auto& script = scripts[file];
+			script.result = std::move(future.get().response);
+
+			printf("Compiled: %s\n", file.filename().c_str());
+			bool success = reportResult(file, script.result, options.verbose);
+			if (!success)
+				++errors;
+
+			// A script that fails to compile has no joined classes, the class
+			// keeps the joins of its last successful compile until it is fixed
+			auto name = file.stem().string();
+			if (success || !joinGraph.getClasses().contains(name))
+				joinGraph.setClass(name, script.result.response.joinedClasses);
+			changedClasses.push_back(std::move(name));
+		}
+		removedClasses.clear();
+
+		if (!queued.empty())
+		{
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			printf("Compiled %zu files in %.1f ms, %d errors\n", queued.size(), elapsed.count(), errors);
+		}
+
+		if (!changedClasses.empty())
+		{
+			std::sort(changedClasses.begin(), changedClasses.end());
+			reportJoinCycles(joinGraph, changedClasses);
+
+			// The classes to load again, each after the classes it joins
+			std::string affected;
+			for (const auto& name : joinGraph.affectedBy(changedClasses))
+				affected.append(affected.empty() ? "" : ", ").append(name);
+			if (!affected.empty())
+				printf("Reload: %s\n", affected.c_str());
+
+			if (!options.deps_path.empty() && !writeJoinGraph(options.deps_path, joinGraph, changedClasses))
+				std::cerr << "Error: Cannot write dependencies to " << options.deps_path << "\n";
+		}
+		fflush(stdout);
+	};
+
+	compileRound(gatherFilesFromDirectory(dir, options.verbose));
+	printf("Watching %s\n", dir.c_str());
+	fflush(stdout);
+
+	auto removeScript = [&](std::map<std::filesystem::path, WatchedScript>::iterator it) {
+		auto name = it->first.stem().string();
+		scripts.erase(it);
+		joinGraph.removeClass(name);
+		removedClasses.push_back(std::move(name));
+	};
+
+	std::vector<std::filesystem::path> changed;
+	std::vector<std::filesystem::path> removed;
+	while (watcher.wait(changed, removed, quietPeriod))
+	{
+		for (const auto& file : removed)
+		{
+			if (auto it = scripts.find(file); it != scripts.end())
+				removeScript(it);
+		}
+
+		// Events were lost, anything could have changed, including scripts
+		// that were removed
+		if (std::find(changed.begin(), changed.end(), dir) != changed.end())
+		{
+			changed = gatherFilesFromDirectory(dir, options.verbose);
+
+			std::set<std::filesystem::path> present(changed.begin(), changed.end());
+			for (auto it = scripts.begin(); it != scripts.end();)
+			{
+				auto next = std::next(it);
+				if (!present.contains(it->first))
+					removeScript(it);
+				it = next;
+			}
+		}
+
+		compileRound(changed);
+	}
+
+	activeWatcher = nullptr;
 	return 0;
+#else
+	std::cerr << "Error: --watch is not supported on this platform\n";
+	return 1;
+#endif
 }
 
 int main(int argc, const char* argv[])
@@ -325,17 +1375,47 @@ int main(int argc, const char* argv[])
 		return 1;
 	}
 
+	std::unique_ptr<BuildCache> cache;
+	if (!args.cache_dir.empty())
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(args.cache_dir, ec);
+		if (!std::filesystem::is_directory(args.cache_dir, ec))
+		{
+			std::cerr << "Error: Cannot create cache directory: " << args.cache_dir << "\n";
+			return 1;
+		}
+
+		cache = std::make_unique<BuildCache>(args.cache_dir);
+	}
+
+	CompileOptions options{ args.verbose, std::max(args.jobs, 1), cache.get() };
+	if (args.optimize)
+		options.compiler = GS2CompilerOptions::optimized();
+
+	options.stats_path = args.stats_path;
+	options.deps_path = args.deps_path;
+	options.compiler.collectStats = !args.stats_path.empty();
+	options.compiler.sourceMap = args.source_map;
+	options.compiler.verify = args.verify;
+
 	int result;
-	if (args.directory_mode)
-		result = processDirectory(args.input_paths[0], args.verbose);
+	if (!args.serve_path.empty())
+		result = serveRequests(args.serve_path, args.jobs ? args.jobs : int(std::max(1u, std::thread::hardware_concurrency())), options);
+	else if (args.disasm)
+		result = disassembleFiles(args.input_paths, args.output_path, options);
+	else if (args.watch)
+		result = watchDirectory(args.input_paths[0], options);
+	else if (args.directory_mode)
+		result = processDirectory(args.input_paths[0], options);
 	else if (args.multi_file_mode)
 	{
-		processFileList(args.input_paths, args.verbose, "Multi-file");
+		processFileList(args.input_paths, options, "Multi-file");
 		result = 0;
 	}
 	else
 	{
-		processFileList(args.input_paths, args.verbose, "", args.output_path);
+		processFileList(args.input_paths, options, "", args.output_path);
 		result = 0;
 	}
 
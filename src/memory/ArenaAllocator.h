@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -13,30 +14,43 @@ class ArenaAllocator {
 public:
     static constexpr size_t CHUNK_SIZE = DefaultChunkSize;
 
-    ArenaAllocator() : current_(nullptr), remaining_(0) {}
+    ArenaAllocator() : active_(0), current_(nullptr), remaining_(0), objects_(0), destructors_(nullptr) {}
     ArenaAllocator(const ArenaAllocator&) = delete;
     ArenaAllocator& operator=(const ArenaAllocator&) = delete;
 
     ArenaAllocator(ArenaAllocator&& other) noexcept
         : chunks_(std::move(other.chunks_)),
+          active_(std::exchange(other.active_, 0)),
           current_(std::exchange(other.current_, nullptr)),
-          remaining_(std::exchange(other.remaining_, 0)) {
+          remaining_(std::exchange(other.remaining_, 0)),
+          objects_(std::exchange(other.objects_, 0)),
+          destructors_(std::exchange(other.destructors_, nullptr)) {
     }
 
     ArenaAllocator& operator=(ArenaAllocator&& other) noexcept {
         if (this != &other) {
+            run_destructors();
             chunks_ = std::move(other.chunks_);
+            active_ = std::exchange(other.active_, 0);
             current_ = std::exchange(other.current_, nullptr);
             remaining_ = std::exchange(other.remaining_, 0);
+            objects_ = std::exchange(other.objects_, 0);
+            destructors_ = std::exchange(other.destructors_, nullptr);
         }
         return *this;
     }
 
-    ~ArenaAllocator() = default;
+    ~ArenaAllocator() {
+        run_destructors();
+    }
 
     /**
      * Allocate and construct an object of type T
      *
+     * Objects that are not trivially destructible are registered with the
+     * arena, and have their destructors run when the arena is reset or
+     * destroyed so any memory they own outside of the arena is released.
+     *
      * @tparam T The type to allocate
      * @tparam Args Constructor argument types
      * @param args Constructor arguments
@@ -44,19 +58,57 @@ public:
      */
     template<typename T, typename... Args>
     [[nodiscard]] T* allocate(Args&&... args) {
-        void* ptr = allocate_raw(sizeof(T), alignof(T));
-        return std::construct_at(static_cast<T*>(ptr), std::forward<Args>(args)...);
+        ++objects_;
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            void* ptr = allocate_raw(sizeof(T), alignof(T));
+            return std::construct_at(static_cast<T*>(ptr), std::forward<Args>(args)...);
+        } else {
+            // Reserve the registry entry first so a failed allocation can't
+            // leave behind a constructed object without a destructor
+            void* entry = allocate_raw(sizeof(DestructorEntry), alignof(DestructorEntry));
+            void* ptr = allocate_raw(sizeof(T), alignof(T));
+            T* obj = std::construct_at(static_cast<T*>(ptr), std::forward<Args>(args)...);
+
+            destructors_ = std::construct_at(static_cast<DestructorEntry*>(entry), DestructorEntry{
+                [](void* p) { std::destroy_at(static_cast<T*>(p)); },
+                obj,
+                destructors_
+            });
+            return obj;
+        }
     }
 
     /**
-     * Reset the arena, freeing all allocated memory
+     * Reset the arena, destroying all registered objects and
+     * freeing all allocated memory
      */
     void reset() noexcept {
+        run_destructors();
         chunks_.clear();
+        active_ = 0;
+        objects_ = 0;
         current_ = nullptr;
         remaining_ = 0;
     }
 
+    /**
+     * Rewind the arena, destroying all registered objects but keeping
+     * the allocated chunks around so they can be reused by subsequent
+     * allocations without going back to the system allocator
+     */
+    void rewind() noexcept {
+        run_destructors();
+        active_ = 0;
+        objects_ = 0;
+        if (chunks_.empty()) {
+            current_ = nullptr;
+            remaining_ = 0;
+        } else {
+            current_ = chunks_.front().data.get();
+            remaining_ = chunks_.front().size;
+        }
+    }
+
     /**
      * Get total allocated memory (including overhead)
      */
@@ -75,6 +127,13 @@ public:
         return chunks_.size();
     }
 
+    /**
+     * Get number of objects allocated since the last reset or rewind
+     */
+    [[nodiscard]] size_t object_count() const {
+        return objects_;
+    }
+
 private:
     /**
      * Represents a memory chunk
@@ -84,6 +143,27 @@ private:
         size_t size{};
     };
 
+    /**
+     * Registry entry for an object that needs its destructor called,
+     * entries live inside the arena and form a list in reverse order
+     * of allocation
+     */
+    struct DestructorEntry {
+        void (*destroy)(void*);
+        void* object;
+        DestructorEntry* next;
+    };
+
+    /**
+     * Run the destructors of every registered object, newest first
+     */
+    void run_destructors() noexcept {
+        for (auto entry = destructors_; entry; entry = entry->next) {
+            entry->destroy(entry->object);
+        }
+        destructors_ = nullptr;
+    }
+
     /**
      * Allocate raw memory with proper alignment
      *
@@ -96,15 +176,29 @@ private:
         size_t space = remaining_;
 
         if (!ptr || !std::align(alignment, size, ptr, space)) {
-            // Need a new chunk
-            size_t chunk_size = std::max(size + alignment, CHUNK_SIZE);
-            chunks_.push_back(Chunk{
-                std::make_unique<std::byte[]>(chunk_size),
-                chunk_size
-            });
-            ptr = current_ = chunks_.back().data.get();
-            space = remaining_ = chunk_size;
-            std::align(alignment, size, ptr, space);
+            // Move on to the next retained chunk that fits, if any
+            ptr = nullptr;
+            while (active_ + 1 < chunks_.size()) {
+                auto& chunk = chunks_[++active_];
+                ptr = chunk.data.get();
+                space = chunk.size;
+                if (std::align(alignment, size, ptr, space))
+                    break;
+                ptr = nullptr;
+            }
+
+            if (!ptr) {
+                // Need a new chunk
+                size_t chunk_size = std::max(size + alignment, CHUNK_SIZE);
+                chunks_.push_back(Chunk{
+                    std::make_unique<std::byte[]>(chunk_size),
+                    chunk_size
+                });
+                active_ = chunks_.size() - 1;
+                ptr = chunks_.back().data.get();
+                space = chunk_size;
+                std::align(alignment, size, ptr, space);
+            }
         }
 
         current_ = static_cast<std::byte*>(ptr) + size;
@@ -113,8 +207,11 @@ private:
     }
 
     std::vector<Chunk> chunks_;
+    size_t active_;
     std::byte* current_;
     size_t remaining_;
+    size_t objects_;
+    DestructorEntry* destructors_;
 };
 
 #endif // ARENAALLOCATOR_H
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstring>
+#include "StringInterner.h"
+
+namespace
+{
+	constexpr size_t MIN_SLOTS = 256;
+
+	inline uint64_t Mix(uint64_t h)
+	{
+		h ^= h >> 31;
+		h *= 0xbf58476d1ce4e5b9ull;
+		h ^= h >> 29;
+		return h;
+	}
+}
+
+StringInterner::StringInterner()
+	: slots(MIN_SLOTS, Slot{ nullptr, 0 }), count(0)
+{
+}
+
+/*
+ * Identifiers are short, so this mixes 8 bytes at a time and skips the
+ * per-byte loop of std::hash
+ */
+uint64_t StringInterner::hash(std::string_view str)
+{
+	const char *p = str.data();
+	size_t length = str.length();
+
+	uint64_t h = 0x9e3779b97f4a7c15ull ^ length;
+	while (length >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, 8);
+		h = Mix(h ^ word);
+		p += 8;
+		length -= 8;
+	}
+
+	if (length)
+	{
+		uint64_t word = 0;
+		memcpy(&word, p, length);
+		h = Mix(h ^ word);
+	}
+
+	return Mix(h);
+}
+
+std::string * StringInterner::intern(std::string_view str)
+{
+	auto h = hash(str);
+	auto mask = slots.size() - 1;
+
+	for (auto i = size_t(h) & mask; ; i = (i + 1) & mask)
+	{
+		auto& slot = slots[i];
+		if (!slot.str)
+		{
+			slot = { arena.allocate<std::string>(str), h };
+
+			// Keep the table at most half full, probes stay short
+			if (++count * 2 > slots.size())
+			{
+				auto result = slot.str;
+				grow();
+				return result;
+			}
+
+			return slot.str;
+		}
+
+		if (slot.hash == h && *slot.str == str)
+			return slot.str;
+	}
+}
+
+void StringInterner::grow()
+{
+	std::vector<Slot> old(slots.size() * 2, Slot{ nullptr, 0 });
+	old.swap(slots);
+
+	auto mask = slots.size() - 1;
+	for (const auto& slot : old)
+	{
+		if (!slot.str)
+			continue;
+
+		auto i = size_t(slot.hash) & mask;
+		while (slots[i].str)
+			i = (i + 1) & mask;
+
+		slots[i] = slot;
+	}
+}
+
+void StringInterner::clear()
+{
+	std::fill(slots.begin(), slots.end(), Slot{ nullptr, 0 });
+	count = 0;
+	arena.rewind();
+}
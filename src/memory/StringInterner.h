@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ArenaAllocator.h"
+
+/*
+ * Interns the identifiers and literals of a script, so each distinct string
+ * is stored once and can be compared or used as a key by its address
+ *
+ * Strings are looked up by string_view, so callers don't have to build a
+ * std::string to find out it already exists. The std::string objects live
+ * in an arena owned by the interner (short strings entirely, longer ones
+ * keep their characters on the heap) and stay valid until clear().
+ */
+class StringInterner
+{
+	public:
+		StringInterner();
+		StringInterner(const StringInterner&) = delete;
+		StringInterner& operator=(const StringInterner&) = delete;
+
+		/*
+		 * Returns the interned copy of the string, adding it if needed
+		 */
+		std::string * intern(std::string_view str);
+
+		/*
+		 * Number of distinct strings interned
+		 */
+		size_t size() const;
+
+		/*
+		 * Forgets every string, the pointers returned so far are invalidated.
+		 * The memory is kept for the next script
+		 */
+		void clear();
+
+	private:
+		struct Slot
+		{
+			std::string *str;
+			uint64_t hash;
+		};
+
+		ArenaAllocator<16 * 1024> arena;
+		std::vector<Slot> slots;	// Open addressing, size is a power of two and str is null when empty
+		size_t count;
+
+		static uint64_t hash(std::string_view str);
+		void grow();
+};
+
+inline size_t StringInterner::size() const {
+	return count;
+}
+
+#endif
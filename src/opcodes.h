@@ -170,6 +170,27 @@ namespace opcode
 		}
 	}
 
+	/*
+	 * Ops followed by the op index they jump to
+	 */
+	inline bool IsJumpOp(Opcode opcode)
+	{
+		switch (opcode)
+		{
+		case OP_SET_INDEX:
+		case OP_SET_INDEX_TRUE:
+		case OP_OR:
+		case OP_IF:
+		case OP_AND:
+		case OP_WITH:
+		case OP_FOREACH:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
 	inline bool IsReservedIdentOp(Opcode opcode)
 	{
 		switch (opcode)
@@ -204,67 +225,52 @@ namespace opcode
 		}
 	}
 
-	inline std::string OpcodeToString(Opcode opcode)
+	/*
+	 * Name of the op, or nullptr for values that aren't a known op
+	 */
+	inline const char * OpcodeName(Opcode opcode)
 	{
 		switch (opcode)
 		{
 			case OP_NONE:
 				return "OP_NONE";
 
-			case OP_ASSIGN:
-				return "OP_ASSIGN";
-
 			case OP_SET_INDEX:
 				return "OP_SET_INDEX";
 
 			case OP_SET_INDEX_TRUE:
 				return "OP_SET_INDEX_TRUE";
 
+			case OP_OR:
+				return "OP_OR";
+
 			case OP_IF:
 				return "OP_IF";
 
-			case OP_TYPE_TRUE:
-				return "OP_TRUE";
-
-			case OP_TYPE_FALSE:
-				return "OP_FALSE";
-
-			case OP_TYPE_NULL:
-				return "OP_NULL";
-
-			case OP_ADD:
-				return "OP_ADD";
-
-			case OP_SUB:
-				return "OP_SUB";
-
-			case OP_MUL:
-				return "OP_MUL";
+			case OP_AND:
+				return "OP_AND";
 
-			case OP_DIV:
-				return "OP_DIV";
+			case OP_CALL:
+				return "OP_CALL";
 
-			case OP_MOD:
-				return "OP_MOD";
+			case OP_RET:
+				return "OP_RET";
 
-			case OP_POW:
-				return "OP_POW";
+			case OP_SLEEP:
+				return "OP_SLEEP";
 
-			case OP_INC:
-				return "OP_INC";
+			case OP_CMD_CALL:
+				return "OP_CMD_CALL";
 
-			case OP_DEC:
-				return "OP_DEC";
+			case OP_JMP:
+				return "OP_JMP";
 
-			case OP_UNARYSUB:
-				return "OP_UNARYSUB";
+			case OP_WAITFOR:
+				return "OP_WAITFOR";
 
 			case OP_TYPE_NUMBER:
 				return "OP_TYPE_NUMBER";
 
-			case OP_FORMAT:
-				return "OP_FORMAT";
-
 			case OP_TYPE_STRING:
 				return "OP_TYPE_STRING";
 
@@ -274,8 +280,26 @@ namespace opcode
 			case OP_TYPE_ARRAY:
 				return "OP_TYPE_ARRAY";
 
-			case OP_ARRAY_END:
-				return "OP_ARRAY_END";
+			case OP_TYPE_TRUE:
+				return "OP_TRUE";
+
+			case OP_TYPE_FALSE:
+				return "OP_FALSE";
+
+			case OP_TYPE_NULL:
+				return "OP_NULL";
+
+			case OP_PI:
+				return "OP_PI";
+
+			case OP_COPY_LAST_OP:
+				return "OP_COPY_LAST_OP";
+
+			case OP_SWAP_LAST_OPS:
+				return "OP_SWAP_LAST_OPS";
+
+			case OP_INDEX_DEC:
+				return "OP_INDEX_DEC";
 
 			case OP_CONV_TO_FLOAT:
 				return "OP_CONV_TO_FLOAT";
@@ -289,26 +313,83 @@ namespace opcode
 			case OP_CONV_TO_OBJECT:
 				return "OP_CONV_TO_OBJECT";
 
+			case OP_ARRAY_END:
+				return "OP_ARRAY_END";
+
+			case OP_ARRAY_NEW:
+				return "OP_ARRAY_NEW";
+
+			case OP_SETARRAY:
+				return "OP_SETARRAY";
+
+			case OP_INLINE_NEW:
+				return "OP_INLINE_NEW";
+
+			case OP_MAKEVAR:
+				return "OP_MAKEVAR";
+
 			case OP_NEW_OBJECT:
 				return "OP_NEW_OBJECT";
 
+			case OP_OBJ_FROM_STR:
+				return "OP_OBJ_FROM_STR";
+
+			case OP_INLINE_CONDITIONAL:
+				return "OP_INLINE_CONDITIONAL";
+
+			case OP_UNKNOWN_45:
+				return "OP_UNKNOWN_45";
+
+			case OP_UNKNOWN_46:
+				return "OP_UNKNOWN_46";
+
+			case OP_UNKNOWN_47:
+				return "OP_UNKNOWN_47";
+
+			case OP_ASSIGN:
+				return "OP_ASSIGN";
+
 			case OP_FUNC_PARAMS_END:
 				return "OP_FUNC_PARAMS_END";
 
-			case OP_CALL:
-				return "OP_CALL";
+			case OP_INC:
+				return "OP_INC";
 
-			case OP_CMD_CALL:
-				return "OP_CMD_CALL";
+			case OP_DEC:
+				return "OP_DEC";
 
-			case OP_JMP:
-				return "OP_JMP";
+			case OP_UNKNOWN_54:
+				return "OP_UNKNOWN_54";
 
-			case OP_INDEX_DEC:
-				return "OP_INDEX_DEC";
+			case OP_ADD:
+				return "OP_ADD";
 
-			case OP_RET:
-				return "OP_RET";
+			case OP_SUB:
+				return "OP_SUB";
+
+			case OP_MUL:
+				return "OP_MUL";
+
+			case OP_DIV:
+				return "OP_DIV";
+
+			case OP_MOD:
+				return "OP_MOD";
+
+			case OP_POW:
+				return "OP_POW";
+
+			case OP_UNKNOWN_66:
+				return "OP_UNKNOWN_66";
+
+			case OP_UNKNOWN_67:
+				return "OP_UNKNOWN_67";
+
+			case OP_NOT:
+				return "OP_NOT";
+
+			case OP_UNARYSUB:
+				return "OP_UNARYSUB";
 
 			case OP_EQ:
 				return "OP_EQ";
@@ -328,26 +409,17 @@ namespace opcode
 			case OP_GTE:
 				return "OP_GTE";
 
-			case OP_NOT:
-				return "OP_NOT";
-
-			case OP_AND:
-				return "OP_AND";
-
-			case OP_OR:
-				return "OP_OR";
+			case OP_BWO:
+				return "OP_BWO";
 
-			case OP_ARRAY:
-				return "OP_ARRAY[]";
+			case OP_BWA:
+				return "OP_BWA";
 
-			case OP_OBJ_CHARAT:
-				return "OP_OBJ_CHARAT";
+			case OP_BWX:
+				return "OP_BWX";
 
-			case OP_OBJ_CLEAR:
-				return "OP_OBJ_CLEAR";
-
-			case OP_OBJ_ENDS:
-				return "OP_OBJ_ENDS";
+			case OP_BWI:
+				return "OP_BWI";
 
 			case OP_IN_RANGE:
 				return "OP_IN_RANGE";
@@ -358,44 +430,152 @@ namespace opcode
 			case OP_OBJ_INDEX:
 				return "OP_OBJ_INDEX";
 
+			case OP_OBJ_TYPE:
+				return "OP_OBJ_TYPE";
+
+			case OP_FORMAT:
+				return "OP_FORMAT";
+
+			case OP_INT:
+				return "OP_INT";
+
+			case OP_ABS:
+				return "OP_ABS";
+
+			case OP_RANDOM:
+				return "OP_RANDOM";
+
+			case OP_SIN:
+				return "OP_SIN";
+
+			case OP_COS:
+				return "OP_COS";
+
+			case OP_ARCTAN:
+				return "OP_ARCTAN";
+
+			case OP_EXP:
+				return "OP_EXP";
+
+			case OP_LOG:
+				return "OP_LOG";
+
+			case OP_MIN:
+				return "OP_MIN";
+
+			case OP_MAX:
+				return "OP_MAX";
+
+			case OP_GETANGLE:
+				return "OP_GETANGLE";
+
+			case OP_GETDIR:
+				return "OP_GETDIR";
+
+			case OP_VECX:
+				return "OP_VECX";
+
+			case OP_VECY:
+				return "OP_VECY";
+
 			case OP_OBJ_INDICES:
 				return "OP_OBJ_INDICES";
 
-			case OP_OBJ_LENGTH:
-				return "OP_OBJ_LENGTH";
-
 			case OP_OBJ_LINK:
 				return "OP_OBJ_LINK";
 
+			case OP_BW_LEFTSHIFT:
+				return "OP_BW_LEFTSHIFT";
+
+			case OP_BW_RIGHTSHIFT:
+				return "OP_BW_RIGHTSHIFT";
+
+			case OP_CHAR:
+				return "OP_CHAR";
+
+			case OP_OBJ_COMPARE:
+				return "OP_OBJ_COMPARE";
+
+			case OP_OBJ_TRIM:
+				return "OP_OBJ_TRIM";
+
+			case OP_OBJ_LENGTH:
+				return "OP_OBJ_LENGTH";
+
 			case OP_OBJ_POS:
 				return "OP_OBJ_POS";
 
+			case OP_JOIN:
+				return "OP_JOIN";
+
+			case OP_OBJ_CHARAT:
+				return "OP_OBJ_CHARAT";
+
+			case OP_OBJ_SUBSTR:
+				return "OP_OBJ_SUBSTR";
+
+			case OP_OBJ_STARTS:
+				return "OP_OBJ_STARTS";
+
+			case OP_OBJ_ENDS:
+				return "OP_OBJ_ENDS";
+
+			case OP_OBJ_TOKENIZE:
+				return "OP_OBJ_TOKENIZE";
+
+			case OP_TRANSLATE:
+				return "OP_TRANSLATE";
+
 			case OP_OBJ_POSITIONS:
 				return "OP_OBJ_POSITIONS";
 
 			case OP_OBJ_SIZE:
 				return "OP_OBJ_SIZE";
 
-			case OP_OBJ_STARTS:
-				return "OP_OBJ_STARTS";
+			case OP_ARRAY:
+				return "OP_ARRAY[]";
+
+			case OP_ARRAY_ASSIGN:
+				return "OP_ARRAY_ASSIGN";
+
+			case OP_ARRAY_MULTIDIM:
+				return "OP_ARRAY_MULTIDIM";
+
+			case OP_ARRAY_MULTIDIM_ASSIGN:
+				return "OP_ARRAY_MULTIDIM_ASSIGN";
 
 			case OP_OBJ_SUBARRAY:
 				return "OP_OBJ_SUBARRAY";
 
-			case OP_OBJ_SUBSTR:
-				return "OP_OBJ_SUBSTR";
+			case OP_OBJ_ADDSTRING:
+				return "OP_OBJ_ADDSTRING";
 
-			case OP_OBJ_TOKENIZE:
-				return "OP_OBJ_TOKENIZE";
+			case OP_OBJ_DELETESTRING:
+				return "OP_OBJ_DELETESTRING";
 
-			case OP_OBJ_TRIM:
-				return "OP_OBJ_TRIM";
+			case OP_OBJ_REMOVESTRING:
+				return "OP_OBJ_REMOVESTRING";
 
-			case OP_OBJ_TYPE:
-				return "OP_OBJ_TYPE";
+			case OP_OBJ_REPLACESTRING:
+				return "OP_OBJ_REPLACESTRING";
 
-			case OP_JOIN:
-				return "OP_JOIN";
+			case OP_OBJ_INSERTSTRING:
+				return "OP_OBJ_INSERTSTRING";
+
+			case OP_OBJ_CLEAR:
+				return "OP_OBJ_CLEAR";
+
+			case OP_ARRAY_NEW_MULTIDIM:
+				return "OP_ARRAY_NEW_MULTIDIM";
+
+			case OP_WITH:
+				return "OP_WITH";
+
+			case OP_WITHEND:
+				return "OP_WITHEND";
+
+			case OP_FOREACH:
+				return "OP_FOREACH";
 
 			case OP_THIS:
 				return "OP_THIS";
@@ -415,11 +595,20 @@ namespace opcode
 			case OP_TEMP:
 				return "OP_TEMP";
 
+			case OP_PARAMS:
+				return "OP_PARAMS";
+
 			default:
-				return std::string("OP ").append(std::to_string((int)opcode));
+				return nullptr;
 		}
+	}
+
+	inline std::string OpcodeToString(Opcode opcode)
+	{
+		if (auto name = OpcodeName(opcode))
+			return name;
 
-		return "Unknown opcode";
+		return std::string("OP ").append(std::to_string((int)opcode));
 	}
 }
 
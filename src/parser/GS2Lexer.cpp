@@ -0,0 +1,594 @@
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include "GS2Lexer.h"
+
+// Define GS2LEXER_SCALAR to test the fallback used on other architectures
+#if defined(GS2LEXER_SCALAR)
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define GS2LEXER_VECTOR_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define GS2LEXER_VECTOR_WIDTH 16
+#endif
+
+namespace
+{
+	const char EMPTY_INPUT[] = "";
+
+	inline bool IsBlank(uint8_t c) { return c == ' ' || c == '\t'; }
+	inline bool IsDigit(uint8_t c) { return c >= '0' && c <= '9'; }
+	inline bool IsHex(uint8_t c) { return IsDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f'); }
+	inline bool IsAlnum(uint8_t c) { return IsDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_'; }
+
+	// ALPHA in the flex rules, `$` can start an identifier but not continue it
+	inline bool IsAlpha(uint8_t c) { return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_' || c == '$'; }
+
+#ifdef GS2LEXER_VECTOR_WIDTH
+	/*
+	 * Thin wrappers so the masks below read the same for SSE2 and AVX2, the
+	 * masks have one bit per byte of the vector
+	 */
+#if GS2LEXER_VECTOR_WIDTH == 32
+	using Vector = __m256i;
+	constexpr uint32_t LANE_MASK = 0xFFFFFFFFu;
+
+	inline Vector Load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+	inline Vector Splat(char c) { return _mm256_set1_epi8(c); }
+	inline Vector Or(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+	inline Vector Equal(Vector v, char c) { return _mm256_cmpeq_epi8(v, Splat(c)); }
+	inline Vector InRange(Vector v, char lo, char hi) { return _mm256_and_si256(_mm256_cmpgt_epi8(v, Splat(char(lo - 1))), _mm256_cmpgt_epi8(Splat(char(hi + 1)), v)); }
+	inline uint32_t Mask(Vector v) { return uint32_t(_mm256_movemask_epi8(v)); }
+#else
+	using Vector = __m128i;
+	constexpr uint32_t LANE_MASK = 0xFFFFu;
+
+	inline Vector Load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+	inline Vector Splat(char c) { return _mm_set1_epi8(c); }
+	inline Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+	inline Vector Equal(Vector v, char c) { return _mm_cmpeq_epi8(v, Splat(c)); }
+	inline Vector InRange(Vector v, char lo, char hi) { return _mm_and_si128(_mm_cmpgt_epi8(v, Splat(char(lo - 1))), _mm_cmpgt_epi8(Splat(char(hi + 1)), v)); }
+	inline uint32_t Mask(Vector v) { return uint32_t(_mm_movemask_epi8(v)); }
+#endif
+
+	inline uint32_t NonBlankMask(Vector v) { return ~Mask(Or(Equal(v, ' '), Equal(v, '\t'))) & LANE_MASK; }
+	inline uint32_t LineEndMask(Vector v) { return Mask(Or(Equal(v, '\n'), Equal(v, '\0'))); }
+	inline uint32_t CommentMarkMask(Vector v) { return Mask(Or(Or(Equal(v, '*'), Equal(v, '\n')), Equal(v, '\0'))); }
+	inline uint32_t QuoteMask(Vector v) { return Mask(Or(Equal(v, '"'), Equal(v, '\0'))); }
+
+	inline uint32_t NonIdentifierMask(Vector v)
+	{
+		auto letters = InRange(Or(v, Splat(0x20)), 'a', 'z');
+		auto alnum = Or(Or(letters, InRange(v, '0', '9')), Equal(v, '_'));
+		return ~Mask(alnum) & LANE_MASK;
+	}
+
+	#define VECTOR_MATCH(fn) [](Vector v) { return fn(v); }
+#else
+	#define VECTOR_MATCH(fn) nullptr
+#endif
+
+	/*
+	 * Returns the first byte from p that the scalar predicate accepts. Whole
+	 * vectors are only loaded while they fit before end, the rest is scanned
+	 * one byte at a time. Every predicate accepts the null byte at the end of
+	 * the input, so the scalar loop needs no bounds check
+	 */
+	template<typename VectorMatch, typename ScalarMatch>
+	inline const char * FindFirst(const char *p, const char *end, [[maybe_unused]] VectorMatch vectorMatch, ScalarMatch scalarMatch)
+	{
+#ifdef GS2LEXER_VECTOR_WIDTH
+		while (end - p >= GS2LEXER_VECTOR_WIDTH)
+		{
+			if (uint32_t bits = vectorMatch(Load(p)))
+				return p + std::countr_zero(bits);
+
+			p += GS2LEXER_VECTOR_WIDTH;
+		}
+#endif
+
+		while (!scalarMatch(uint8_t(*p)))
+			++p;
+
+		return p;
+	}
+
+	const char * SkipBlanks(const char *p, const char *end)
+	{
+		return FindFirst(p, end, VECTOR_MATCH(NonBlankMask), [](uint8_t c) { return !IsBlank(c); });
+	}
+
+	const char * SkipIdentifier(const char *p, const char *end)
+	{
+		return FindFirst(p, end, VECTOR_MATCH(NonIdentifierMask), [](uint8_t c) { return !IsAlnum(c); });
+	}
+
+	const char * FindLineEnd(const char *p, const char *end)
+	{
+		return FindFirst(p, end, VECTOR_MATCH(LineEndMask), [](uint8_t c) { return c == '\n' || c == '\0'; });
+	}
+
+	const char * FindCommentMark(const char *p, const char *end)
+	{
+		return FindFirst(p, end, VECTOR_MATCH(CommentMarkMask), [](uint8_t c) { return c == '*' || c == '\n' || c == '\0'; });
+	}
+
+	const char * FindQuote(const char *p, const char *end)
+	{
+		return FindFirst(p, end, VECTOR_MATCH(QuoteMask), [](uint8_t c) { return c == '"' || c == '\0'; });
+	}
+
+	/*
+	 * Keywords are looked up with a perfect hash of the length and the first
+	 * and last character, checked for collisions at compile time
+	 */
+	struct Keyword
+	{
+		std::string_view name;
+		int token;
+		int cval;	// semantic value for the '@' aliases, -1 if none
+	};
+
+	constexpr Keyword KEYWORDS[] = {
+		{ "xor", T_OPBWXOR, -1 }, { "public", T_KWPUBLIC, -1 }, { "if", T_KWIF, -1 },
+		{ "else", T_KWELSE, -1 }, { "elseif", T_KWELSEIF, -1 }, { "for", T_KWFOR, -1 },
+		{ "while", T_KWWHILE, -1 }, { "break", T_KWBREAK, -1 }, { "continue", T_KWCONTINUE, -1 },
+		{ "return", T_KWRETURN, -1 }, { "function", T_KWFUNCTION, -1 }, { "new", T_KWNEW, -1 },
+		{ "with", T_KWWITH, -1 }, { "switch", T_KWSWITCH, -1 }, { "case", T_KWCASE, -1 },
+		{ "default", T_KWDEFAULT, -1 }, { "const", T_KWCONST, -1 }, { "enum", T_KWENUM, -1 },
+		{ "int", T_KWCAST_INT, -1 }, { "float", T_KWCAST_FLOAT, -1 }, { "in", T_KWIN, -1 },
+		{ "_", T_KWTRANSLATE, -1 }, { "NL", '@', '\n' }, { "SPC", '@', ' ' }, { "TAB", '@', '\t' },
+	};
+
+	constexpr size_t KEYWORD_TABLE_SIZE = 64;
+	constexpr size_t MAX_KEYWORD_LENGTH = 8;
+
+	constexpr size_t KeywordHash(const char *str, size_t length)
+	{
+		return (uint8_t(str[0]) * 3u + uint8_t(str[length - 1]) * 5u + length * 5u) & (KEYWORD_TABLE_SIZE - 1);
+	}
+
+	struct KeywordTable
+	{
+		int8_t slots[KEYWORD_TABLE_SIZE];
+	};
+
+	constexpr KeywordTable BuildKeywordTable()
+	{
+		KeywordTable table{};
+		for (auto& slot : table.slots)
+			slot = -1;
+
+		for (size_t i = 0; i < std::size(KEYWORDS); i++)
+		{
+			auto& name = KEYWORDS[i].name;
+			if (name.length() > MAX_KEYWORD_LENGTH)
+				throw "keyword is longer than MAX_KEYWORD_LENGTH";
+
+			auto& slot = table.slots[KeywordHash(name.data(), name.length())];
+			if (slot != -1)
+				throw "keyword hash collision, pick new multipliers for KeywordHash";
+
+			slot = int8_t(i);
+		}
+
+		return table;
+	}
+
+	constexpr KeywordTable KEYWORD_TABLE = BuildKeywordTable();
+
+	const Keyword * FindKeyword(const char *str, size_t length)
+	{
+		if (length > MAX_KEYWORD_LENGTH)
+			return nullptr;
+
+		auto slot = KEYWORD_TABLE.slots[KeywordHash(str, length)];
+		if (slot < 0)
+			return nullptr;
+
+		auto& keyword = KEYWORDS[slot];
+		return keyword.name == std::string_view(str, length) ? &keyword : nullptr;
+	}
+}
+
+GS2Lexer::GS2Lexer(ParserContext *context)
+	: context(context), cursor(EMPTY_INPUT), end(EMPTY_INPUT)
+{
+}
+
+void GS2Lexer::setInput(const char *source, size_t length)
+{
+	cursor = source;
+	end = source + length;
+}
+
+void GS2Lexer::consume(size_t length, YYLTYPE *yylloc)
+{
+	context->tokenColumn = context->columnNumber;
+	context->columnNumber += int(length);
+
+	yylloc->first_line = yylloc->last_line = context->lineNumber;
+	yylloc->first_column = context->tokenColumn + 1;
+	yylloc->last_column = context->columnNumber;
+}
+
+void GS2Lexer::newLine(YYLTYPE *yylloc)
+{
+	consume(1, yylloc);
+	context->lineNumber++;
+	context->columnNumber = 0;
+}
+
+int GS2Lexer::lex(YYSTYPE *yylval, YYLTYPE *yylloc)
+{
+	for (;;)
+	{
+		const char *start = cursor;
+		switch (*start)
+		{
+			case '\0':
+				return 0;
+
+			// flex matches each blank on its own, only the last one is visible
+			case ' ':
+			case '\t':
+				cursor = SkipBlanks(start + 1, end);
+				context->columnNumber += int(cursor - start - 1);
+				consume(1, yylloc);
+				continue;
+
+			case '\n':
+				cursor++;
+				newLine(yylloc);
+				continue;
+
+			case '/':
+				if (start[1] == '/' || start[1] == '*')
+				{
+					if (!skipComment(start, yylloc))
+						return 0;
+
+					continue;
+				}
+				break;
+
+			case '"':
+			{
+				// `"(\\.|[^"])*"`, the longest match runs on to the next quote as long
+				// as the one before it is escaped. A backslash can also match [^"] by
+				// itself, so `"\\"` keeps going as well
+				const char *last = nullptr;
+				for (const char *p = start + 1; ; p++)
+				{
+					p = FindQuote(p, end);
+					if (*p == '\0')
+						break;
+
+					last = p + 1;
+					if (p[-1] != '\\')
+						break;
+				}
+
+				if (!last)
+					break;
+
+				cursor = last;
+				consume(cursor - start, yylloc);
+				yylval->sval = context->saveString(start + 1, int(cursor - start - 2), true);
+				return T_STRCONSTANT;
+			}
+
+			case '\'':
+			{
+				// `'(\\.|[^'])'`
+				size_t length = 0;
+				if (start[1] == '\\' && start[2] != '\n' && start[2] != '\0' && start[3] == '\'')
+					length = 4;
+				else if (start[1] != '\'' && start[1] != '\0' && start[2] == '\'')
+					length = 3;
+
+				if (!length)
+					break;
+
+				cursor = start + length;
+				consume(length, yylloc);
+				yylval->sval = context->saveString(start + 1, int(length - 2), true);
+				return T_STRCONSTANT;
+			}
+
+			case '@':
+				if (start[1] == '=')
+				{
+					cursor = start + 2;
+					consume(2, yylloc);
+					return T_OPCATASSIGN;
+				}
+
+				cursor = start + 1;
+				consume(1, yylloc);
+				yylval->cval = 0;
+				return '@';
+
+			default:
+				break;
+		}
+
+		auto c = uint8_t(*start);
+		if (IsDigit(c) || (c == '.' && IsDigit(uint8_t(start[1]))))
+			return lexNumber(yylval, start, yylloc);
+
+		if (IsAlpha(c))
+			return lexIdentifier(yylval, start, yylloc);
+
+		if (int token = lexOperator(start))
+		{
+			consume(cursor - start, yylloc);
+			return token;
+		}
+
+		// Nothing matches, flex would echo the character to stdout
+		cursor = start + 1;
+		consume(1, yylloc);
+	}
+}
+
+bool GS2Lexer::skipComment(const char *start, YYLTYPE *yylloc)
+{
+	if (start[1] == '/')
+	{
+		const char *p = FindLineEnd(start + 2, end);
+		if (*p == '\n')
+		{
+			cursor = p + 1;
+			consume(cursor - start, yylloc);
+			context->lineNumber++;
+			context->columnNumber = 0;
+		}
+		else
+		{
+			cursor = p;
+			consume(cursor - start, yylloc);
+		}
+
+		return true;
+	}
+
+	cursor = start + 2;
+	consume(2, yylloc);
+
+	for (;;)
+	{
+		const char *p = FindCommentMark(cursor, end);
+		if (p != cursor)
+		{
+			// Everything up to the mark is matched one character at a time
+			context->columnNumber += int(p - cursor - 1);
+			consume(1, yylloc);
+			cursor = p;
+		}
+
+		switch (*p)
+		{
+			case '\0':
+				return false;
+
+			case '\n':
+				cursor++;
+				newLine(yylloc);
+				break;
+
+			default:
+				if (p[1] == '/')
+				{
+					cursor += 2;
+					consume(2, yylloc);
+					return true;
+				}
+
+				cursor++;
+				consume(1, yylloc);
+				break;
+		}
+	}
+}
+
+int GS2Lexer::lexNumber(YYSTYPE *yylval, const char *start, YYLTYPE *yylloc)
+{
+	if (start[0] == '0' && start[1] == 'x' && IsHex(uint8_t(start[2])))
+	{
+		const char *p = start + 3;
+		while (IsHex(uint8_t(*p)))
+			p++;
+
+		cursor = p;
+		consume(cursor - start, yylloc);
+		yylval->ival = std::stoul(std::string(start, cursor), nullptr, 16);
+		return T_INT;
+	}
+
+	const char *p = start;
+	while (IsDigit(uint8_t(*p)))
+		p++;
+
+	if (p[0] == '.' && IsDigit(uint8_t(p[1])))
+	{
+		p += 2;
+		while (IsDigit(uint8_t(*p)))
+			p++;
+
+		cursor = p;
+		consume(cursor - start, yylloc);
+		yylval->sval = context->saveString(start, int(cursor - start));
+		return T_FLOAT;
+	}
+
+	// The digits are followed by a non-digit, so atoi stops at the end of the token
+	cursor = p;
+	consume(cursor - start, yylloc);
+	yylval->ival = atoi(start);
+	return T_INT;
+}
+
+int GS2Lexer::lexIdentifier(YYSTYPE *yylval, const char *start, YYLTYPE *yylloc)
+{
+	const char *p = SkipIdentifier(start + 1, end);
+	const char *identEnd = p;
+
+	// Scoped names, ex: `EnumName::member` or `Class::function`
+	while (p[0] == ':' && p[1] == ':' && IsAlpha(uint8_t(p[2])))
+		p = SkipIdentifier(p + 3, end);
+
+	cursor = p;
+	consume(cursor - start, yylloc);
+
+	if (p == identEnd)
+	{
+		if (auto keyword = FindKeyword(start, p - start))
+		{
+			if (keyword->cval >= 0)
+				yylval->cval = char(keyword->cval);
+
+			return keyword->token;
+		}
+	}
+
+	yylval->sval = context->saveString(start, int(p - start));
+	return T_IDENTIFIER;
+}
+
+int GS2Lexer::lexOperator(const char *start)
+{
+	// Longest match first, same as flex
+	auto match = [&](size_t length, int token) {
+		cursor = start + length;
+		return token;
+	};
+
+	char next = start[1];
+	switch (start[0])
+	{
+		case '.': return match(1, '.');
+		case ',': return match(1, ',');
+		case ';': return match(1, ';');
+		case '(': return match(1, '(');
+		case ')': return match(1, ')');
+		case '{': return match(1, '{');
+		case '}': return match(1, '}');
+		case '[': return match(1, '[');
+		case ']': return match(1, ']');
+		case '?': return match(1, T_OPTERNARY);
+		case '~': return match(1, T_OPBWINVERT);
+
+		case ':':
+			return next == '=' ? match(2, '=') : match(1, ':');
+
+		case '|':
+			if (next == '|') return match(2, T_OPOR);
+			if (next == '=') return match(2, T_OPBWORASSIGN);
+			return match(1, '|');
+
+		case '&':
+			if (next == '&') return match(2, T_OPAND);
+			if (next == '=') return match(2, T_OPBWANDASSIGN);
+			return match(1, '&');
+
+		case '!':
+			return next == '=' ? match(2, T_OPNOTEQUALS) : match(1, '!');
+
+		case '<':
+			if (next == '<') return start[2] == '=' ? match(3, T_OPBWLSHIFTASSIGN) : match(2, T_OPBWLSHIFT);
+			if (next == '=') return match(2, T_OPLESSTHANEQUAL);
+			if (next == '>') return match(2, T_OPNOTEQUALS);
+			return match(1, '<');
+
+		case '>':
+			if (next == '>') return start[2] == '=' ? match(3, T_OPBWRSHIFTASSIGN) : match(2, T_OPBWRSHIFT);
+			if (next == '=') return match(2, T_OPGREATERTHANEQUAL);
+			return match(1, '>');
+
+		case '=':
+			if (next == '=') return match(2, T_OPEQUALS);
+			if (next == '<') return match(2, T_OPLESSTHANEQUAL);
+			if (next == '>') return match(2, T_OPGREATERTHANEQUAL);
+			return match(1, '=');
+
+		case '+':
+			if (next == '=') return match(2, T_OPADDASSIGN);
+			if (next == '+') return match(2, T_OPINCREMENT);
+			return match(1, '+');
+
+		case '-':
+			if (next == '=') return match(2, T_OPSUBASSIGN);
+			if (next == '-') return match(2, T_OPDECREMENT);
+			return match(1, '-');
+
+		case '*': return next == '=' ? match(2, T_OPMULASSIGN) : match(1, '*');
+		case '/': return next == '=' ? match(2, T_OPDIVASSIGN) : match(1, '/');
+		case '^': return next == '=' ? match(2, T_OPPOWASSIGN) : match(1, '^');
+		case '%': return next == '=' ? match(2, T_OPMODASSIGN) : match(1, '%');
+
+		default:
+			return 0;
+	}
+}
+
+#ifdef GS2PARSER_HANDWRITTEN_LEXER
+
+struct yy_buffer_state
+{
+	const char *base;
+	size_t length;
+};
+
+namespace
+{
+	struct Scanner
+	{
+		GS2Lexer lexer;
+		yy_buffer_state buffer;
+	};
+}
+
+int yylex_init_extra(ParserContext *extra, yyscan_t *scanner)
+{
+	*scanner = new Scanner{ GS2Lexer(extra), {} };
+	return 0;
+}
+
+int yylex_destroy(yyscan_t scanner)
+{
+	delete static_cast<Scanner *>(scanner);
+	return 0;
+}
+
+YY_BUFFER_STATE yy_scan_buffer(char *base, size_t size, yyscan_t scanner)
+{
+	// Same contract as flex, the buffer ends with two null bytes
+	if (size < 2 || base[size - 2] != '\0' || base[size - 1] != '\0')
+		return nullptr;
+
+	auto s = static_cast<Scanner *>(scanner);
+	s->buffer = { base, size - 2 };
+	s->lexer.setInput(base, size - 2);
+	return &s->buffer;
+}
+
+void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner)
+{
+	auto s = static_cast<Scanner *>(scanner);
+	if (buffer == &s->buffer)
+		s->lexer.setInput(EMPTY_INPUT, 0);
+}
+
+int yylex(YYSTYPE *yylvalp, YYLTYPE *yyllocp, class ParserContext *, yyscan_t scanner)
+{
+	return static_cast<Scanner *>(scanner)->lexer.lex(yylvalp, yyllocp);
+}
+
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef GS2LEXER_H
+#define GS2LEXER_H
+
+#include <cstddef>
+#include "Parser.h"
+#include "gs2parser.tab.hh"
+
+/*
+ * Hand-written replacement for the flex scanner (gs2scanner.l)
+ *
+ * Produces the same tokens, semantic values and locations as the flex rules,
+ * including their longest-match quirks (ex: `=<` is T_OPLESSTHANEQUAL, a
+ * string keeps going past an escaped quote, `a::b` is a single identifier).
+ * Runs of whitespace, comments, identifiers and strings are scanned a vector
+ * at a time with SSE2/AVX2 when available, keywords are looked up with a
+ * perfect hash instead of the flex state tables.
+ *
+ * The only intentional difference is how characters no rule matches are
+ * handled: flex echoes them to stdout, they are skipped silently here.
+ *
+ * Configure with -DGS2PARSER_HANDWRITTEN_LEXER=ON to have the parser use it
+ * instead of flex, otherwise it is only used by the lexer differential test
+ * and benchmark.
+ */
+class GS2Lexer
+{
+	public:
+		explicit GS2Lexer(ParserContext *context);
+
+		/*
+		 * Starts scanning a new input, source[length] must be a null byte.
+		 * Scanning also stops at the first null byte inside the input
+		 */
+		void setInput(const char *source, size_t length);
+
+		/*
+		 * Scans the next token, and updates the line/column of the context
+		 * the same way YY_USER_ACTION does in the flex scanner
+		 *
+		 * @return the token, or 0 at the end of the input
+		 */
+		int lex(YYSTYPE *yylval, YYLTYPE *yylloc);
+
+	private:
+		ParserContext *context;
+		const char *cursor;
+		const char *end;
+
+		int lexNumber(YYSTYPE *yylval, const char *start, YYLTYPE *yylloc);
+		int lexIdentifier(YYSTYPE *yylval, const char *start, YYLTYPE *yylloc);
+		int lexOperator(const char *start);
+
+		/*
+		 * Skips a // or block comment
+		 *
+		 * @return false if the input ended inside the comment
+		 */
+		bool skipComment(const char *start, YYLTYPE *yylloc);
+
+		/*
+		 * Matches the next length characters as a rule, same as YY_USER_ACTION
+		 */
+		void consume(size_t length, YYLTYPE *yylloc);
+		void newLine(YYLTYPE *yylloc);
+};
+
+#ifdef GS2PARSER_HANDWRITTEN_LEXER
+
+/*
+ * The subset of the flex scanner interface used by ParserContext and the
+ * bison parser, backed by GS2Lexer
+ */
+int yylex_init_extra(ParserContext *extra, yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+YY_BUFFER_STATE yy_scan_buffer(char *base, size_t size, yyscan_t scanner);
+void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+
+#endif
+
+#endif
@@ -1,27 +1,14 @@
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include "Parser.h"
 
 #include "gs2parser.tab.hh"
+#ifdef GS2PARSER_HANDWRITTEN_LEXER
+#include "GS2Lexer.h"
+#else
 #include "lex.yy.h"
-
-std::string GetLineByLineNumber(const std::string& subject, uint32_t lineNumber)
-{
-	size_t pos = 0;
-	for (uint32_t i = 0; i < lineNumber - 1; i++)
-	{
-		pos = subject.find("\n", pos);
-		if (pos == std::string::npos)
-			return {};
-
-		++pos;
-	}
-
-	auto end = subject.find("\n", pos);
-	if (end == std::string::npos)
-		return subject.substr(pos);
-	return subject.substr(pos, end - pos);
-}
+#endif
 
 void ReplaceStringInPlace(std::string& subject, const std::string& search, const std::string& replace)
 {
@@ -33,9 +20,9 @@ void ReplaceStringInPlace(std::string& subject, const std::string& search, const
 	}
 }
 
-std::string unquoteString(std::string_view str)
+void unquoteString(std::string_view str, std::string& result)
 {
-	std::string result;
+	result.clear();
 	result.reserve(str.length());
 
 	for (size_t i = 0; i < str.length(); i++)
@@ -58,12 +45,11 @@ std::string unquoteString(std::string_view str)
 			result += str[i];
 		}
 	}
-	return result;
 }
 
 ParserContext::ParserContext(GS2ErrorService& service)
-		: lineNumber(0), columnNumber(0), scanner(nullptr), buffer(nullptr), failed(false), inputStringPtr(nullptr),
-		  lambdaFunctionCount(0), programNode(nullptr), errorService(service)
+		: lineNumber(0), columnNumber(0), tokenColumn(0), scanner(nullptr), buffer(nullptr), failed(false),
+		  lambdaFunctionCount(0), programNode(nullptr), ruleLocation{ 0, 0 }, errorService(service)
 {
 	yylex_init_extra(this, &scanner);
 }
@@ -88,8 +74,9 @@ void ParserContext::cleanup()
 		nodeArena.total_allocated(), nodeArena.chunk_count());
 #endif
 
-	// Reset arena - frees all nodes at once
-	nodeArena.reset();
+	// Rewind arena - destroys all nodes at once, but keeps the chunks
+	// around so the next parse doesn't need to allocate them again
+	nodeArena.rewind();
 }
 
 void ParserContext::reset()
@@ -97,10 +84,11 @@ void ParserContext::reset()
 	// Cleanup any allocated nodes
 	cleanup();
 
-	// Reset our tables
-	constantsTable = {};
-	switchCases = {};
-	stringTable = {};
+	// Reset our tables, clearing them keeps their bucket capacity
+	constantsTable.clear();
+	strings.clear();
+	while (!switchCases.empty())
+		switchCases.pop();
 
 	// Delete the buffer associated with the parser
 	if (buffer)
@@ -111,23 +99,23 @@ void ParserContext::reset()
 
 	lineNumber = 1;
 	columnNumber = 0;
+	tokenColumn = 0;
 	programNode = nullptr;
-	inputStringPtr = nullptr;
+	ruleLocation = { 0, 0 };
+	inputSource = {};
+	lineOffsets.clear();
 	lambdaFunctionCount = 0;
 	failed = false;
 }
 
 std::string* ParserContext::saveString(const char* str, int length, bool unquote)
 {
-	auto tmpStr = unquote ? unquoteString(std::string_view(str, length)) : std::string(str, length);
-
-	auto it = stringTable.find(tmpStr);
-	if (it != stringTable.end())
-		return it->second.get();
+	// Most literals have no escapes, and can be looked up as they are
+	if (!unquote || !memchr(str, '\\', length))
+		return strings.intern(std::string_view(str, length));
 
-	auto ptr = std::make_shared<std::string>(std::move(tmpStr));
-	stringTable.insert({ *ptr, ptr });
-	return ptr.get();
+	unquoteString(std::string_view(str, length), unquoteBuffer);
+	return strings.intern(unquoteBuffer);
 }
 
 std::string * ParserContext::generateLambdaFuncName()
@@ -216,13 +204,42 @@ void ParserContext::addConstant(const std::string& ident, ExpressionNode *node)
 	constantsTable[ident] = node;
 }
 
+void ParserContext::indexLines()
+{
+	lineOffsets.push_back(0);
+
+	const char *data = inputSource.data();
+	size_t length = inputSource.length();
+	for (auto nl = data ? (const char *)memchr(data, '\n', length) : nullptr; nl;
+		 nl = (const char *)memchr(nl + 1, '\n', length - (nl + 1 - data)))
+	{
+		lineOffsets.push_back(uint32_t(nl + 1 - data));
+	}
+}
+
+std::string_view ParserContext::getLineText(int line)
+{
+	if (line < 1 || size_t(line) > lineOffsets.size())
+		return {};
+
+	size_t start = lineOffsets[line - 1];
+	size_t end = size_t(line) < lineOffsets.size() ? lineOffsets[line] - 1 : inputSource.length();
+	return inputSource.substr(start, end - start);
+}
+
 void ParserContext::addParserError(const std::string& errmsg)
 {
-	assert(inputStringPtr != nullptr);
+	assert(inputSource.data() != nullptr);
 
-	std::string lineText;
-	if (inputStringPtr)
-		lineText = GetLineByLineNumber(*inputStringPtr, lineNumber);
+	auto lineText = getLineText(lineNumber);
+
+	// The scanner has already moved past the token the error was raised at
+	GS2SourceLocation location{ uint32_t(lineNumber), 0, 0 };
+	if (columnNumber > tokenColumn)
+	{
+		location.column = uint32_t(tokenColumn + 1);
+		location.length = uint32_t(columnNumber - tokenColumn);
+	}
 
 	std::string msg;
 	if (lineText.empty())
@@ -234,16 +251,40 @@ void ParserContext::addParserError(const std::string& errmsg)
 		msg = std::format("{} at line {}: {}", errmsg, lineNumber, lineText);
 	}
 
-	addError({ ErrorLevel::E_ERROR, GS2CompilerError::ErrorCategory::Parser, std::move(msg) });
+	addError({ ErrorLevel::E_ERROR, GS2CompilerError::ErrorCategory::Parser, std::move(msg), location });
 }
 
-bool ParserContext::parse(const std::string& source)
+bool ParserContext::parse(std::string_view source)
+{
+	// Copy the source into our scan buffer, followed by the two null bytes
+	// flex uses as end-of-buffer markers. The buffer is kept between parses
+	// so this only allocates when a larger script comes along
+	scanBuffer.assign(source.begin(), source.end());
+	scanBuffer.push_back('\0');
+	scanBuffer.push_back('\0');
+
+	return parseInPlace(scanBuffer.data(), source.length());
+}
+
+bool ParserContext::parseInPlace(char* source, size_t length)
 {
 	reset();
 
-	// Holding a pointer to the source incase we have an error msg raised
-	inputStringPtr = &source;
-	buffer = yy_scan_string(source.c_str(), scanner);
+	// Holding a view of the source incase we have an error msg raised
+	inputSource = std::string_view(source, length);
+
+	// Flex scans the source in place, and while it runs an action it holds
+	// the character after the token, often a newline, overwritten with a
+	// null byte. The lines have to be found before it starts
+	indexLines();
+
+	buffer = yy_scan_buffer(source, length + 2, scanner);
+	if (!buffer)
+	{
+		addParserError("input buffer is not terminated by two null bytes");
+		return false;
+	}
+
 	yyparse(this, scanner);
 	return !failed;
 }
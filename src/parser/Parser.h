@@ -6,8 +6,10 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <set>
 #include <stack>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -15,6 +17,7 @@
 #include <format>
 #include "ast/ast.h"
 #include "memory/ArenaAllocator.h"
+#include "memory/StringInterner.h"
 #include "exceptions/GS2CompilerError.h"
 
 typedef void* yyscan_t;
@@ -48,7 +51,19 @@ class ParserContext
 		 *
 		 * @return true if success, false otherwise
 		 */
-		bool parse(const std::string& source);
+		bool parse(std::string_view source);
+
+		/**
+		 * Parse an input without copying it, flex scans the buffer directly
+		 * and temporarily writes into it while doing so. The buffer must hold
+		 * two null bytes after the script, source[length] and source[length + 1],
+		 * and outlive any use of the resulting AST
+		 * @param source
+		 * @param length length of the script, excluding the null bytes
+		 *
+		 * @return true if success, false otherwise
+		 */
+		bool parseInPlace(char *source, size_t length);
 
 		/**
 		 * Pushes a compile error to the error service
@@ -69,6 +84,7 @@ class ParserContext
 	public:
 		int lineNumber;
 		int columnNumber;
+		int tokenColumn;	// Column the last scanned token starts at
 
 		std::string * saveString(const char* str, int length, bool unquote = false);
 		std::string * generateLambdaFuncName();
@@ -105,6 +121,12 @@ class ParserContext
 		 */
 		void setRootStatement(StatementBlock *block);
 
+		/*
+		 * Used by bison before reducing a rule, nodes allocated while
+		 * reducing it are stamped with where the rule starts
+		 */
+		void setRuleLocation(int line, int column);
+
 		/*
 		 * Allocates a node for the parser, the memory is managed
 		 * by the parser context
@@ -112,6 +134,12 @@ class ParserContext
 		template<typename T, typename... P>
 		T *alloc(P&&... params);
 
+		/*
+		 * Arena holding the nodes of the current AST, exposed for
+		 * memory statistics
+		 */
+		const ArenaAllocator<>& getNodeArena() const;
+
 	private:
 		/**
 		 * Cleanup any nodes allocated
@@ -123,19 +151,35 @@ class ParserContext
 		 */
 		void reset();
 
+		/**
+		 * Records where every line of the input starts, before the scanner
+		 * modifies it
+		 */
+		void indexLines();
+
+		/**
+		 * Returns the text of a line in the input (1-based), without the
+		 * newline
+		 */
+		std::string_view getLineText(int line);
+
 	private:
 		yyscan_t scanner;
 		YY_BUFFER_STATE buffer;
 
 		bool failed;
-		const std::string *inputStringPtr;
+		std::string_view inputSource;
+		std::vector<uint32_t> lineOffsets;	// Start of each line in inputSource
+		std::vector<char> scanBuffer;
 		size_t lambdaFunctionCount;
 		std::unordered_map<std::string, ExpressionNode *> constantsTable;
-		std::unordered_map<std::string, std::shared_ptr<std::string>> stringTable;
+		StringInterner strings;
+		std::string unquoteBuffer;	// Scratch space for saveString
 		std::stack<SwitchCaseState> switchCases;
 
 		ArenaAllocator<> nodeArena;
 		StatementBlock* programNode;
+		NodeLocation ruleLocation;
 		GS2ErrorService& errorService;
 };
 
@@ -184,6 +228,16 @@ inline void ParserContext::setRootStatement(StatementBlock *block)
 	programNode = block;
 }
 
+inline void ParserContext::setRuleLocation(int line, int column)
+{
+	ruleLocation = NodeLocation::make(line, column);
+}
+
+inline const ArenaAllocator<>& ParserContext::getNodeArena() const
+{
+	return nodeArena;
+}
+
 /*
  * Push errors to the error service
  */
@@ -199,12 +253,15 @@ inline void ParserContext::addError(GS2CompilerError error)
  * Memory Allocation for Nodes
  *
  * Uses arena allocator for fast allocation with excellent cache locality.
- * All nodes are freed together when the ParserContext is destroyed or reset.
+ * All nodes are destroyed together when the ParserContext is reset, the
+ * arena keeps its chunks for the next parse and frees them on destruction.
  */
 template<typename T, typename ...P>
 inline T *ParserContext::alloc(P && ...params)
 {
 	T *n = nodeArena.allocate<T>(std::forward<P>(params)...);
+	if constexpr (std::is_base_of_v<Node, T>)
+		n->location = ruleLocation;
 	return n;
 }
 
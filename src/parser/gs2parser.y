@@ -7,6 +7,27 @@
 %code {
   int yylex(YYSTYPE* yylvalp, YYLTYPE* yyllocp, class ParserContext *parser, yyscan_t scanner);
   void yyerror(YYLTYPE* yyllocp, class ParserContext *parser, yyscan_t unused, const char* msg);
+
+  /*
+   * Same as the default location of a rule, but also hands the start of
+   * the rule to the parser so the nodes allocated by its action get it
+   */
+  #define YYLLOC_DEFAULT(Current, Rhs, N)                                     \
+    do {                                                                      \
+      if (N)                                                                  \
+      {                                                                       \
+        (Current).first_line   = YYRHSLOC(Rhs, 1).first_line;                 \
+        (Current).first_column = YYRHSLOC(Rhs, 1).first_column;               \
+        (Current).last_line    = YYRHSLOC(Rhs, N).last_line;                  \
+        (Current).last_column  = YYRHSLOC(Rhs, N).last_column;                \
+      }                                                                       \
+      else                                                                    \
+      {                                                                       \
+        (Current).first_line   = (Current).last_line   = YYRHSLOC(Rhs, 0).last_line;   \
+        (Current).first_column = (Current).last_column = YYRHSLOC(Rhs, 0).last_column; \
+      }                                                                       \
+      parser->setRuleLocation((Current).first_line, (Current).first_column);  \
+    } while (0)
 }
 
 %{
@@ -453,7 +474,11 @@ expr_new:
 
 %%
 
+#ifdef GS2PARSER_HANDWRITTEN_LEXER
+#include "GS2Lexer.h"
+#else
 #include "lex.yy.h"
+#endif
 
 void yyerror(YYLTYPE* yyllocp, class ParserContext *parser, yyscan_t unused, const char* s)
 {
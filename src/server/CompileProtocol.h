@@ -0,0 +1,242 @@
+#pragma once
+
+#ifndef COMPILEPROTOCOL_H
+#define COMPILEPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiler/GS2Context.h"
+
+/*
+ * Messages exchanged with gs2test --serve. Every message is a frame, the
+ * length of the payload (big endian uint32) followed by the payload.
+ * Numbers are big endian, strings are written as their uint32 length
+ * followed by the bytes.
+ *
+ * Request:  id (uint32), saveToDisk (uint8), scriptType, scriptName, source
+ *
+ * Response: id (uint32), success (uint8), bytecode (as a string),
+ *           joined class count (uint32) followed by the class names,
+ *           error count (uint32) followed by each error: level (uint8),
+ *           category (uint8), line, column, length (uint32) and message
+ *
+ * Requests can be pipelined. Responses are sent as soon as their script is
+ * compiled, so they can arrive out of order and are matched by id. Without a
+ * script type and name the bytecode has no header, same as gs2test output.
+ */
+namespace protocol
+{
+	constexpr size_t FRAME_HEADER_LENGTH = 4;
+	constexpr uint32_t MAX_FRAME_LENGTH = 64 * 1024 * 1024;
+
+	struct CompileRequest
+	{
+		uint32_t id = 0;
+		bool saveToDisk = false;
+		std::string scriptType;
+		std::string scriptName;
+		std::string source;
+	};
+
+	struct CompileError
+	{
+		ErrorLevel level;
+		GS2CompilerError::ErrorCategory category;
+		GS2SourceLocation location;
+		std::string msg;
+	};
+
+	/*
+	 * Decoded response, as seen by a client
+	 */
+	struct CompileResult
+	{
+		uint32_t id = 0;
+		bool success = false;
+		std::string bytecode;
+		std::vector<std::string> joinedClasses;
+		std::vector<CompileError> errors;
+	};
+
+	/*
+	 * Bounds-checked reads from a frame payload, once a read runs past the
+	 * end every following read returns nothing and ok() is false
+	 */
+	class Reader
+	{
+		public:
+			Reader(const uint8_t *data, size_t length)
+				: data(data), length(length), pos(0), failed(false)
+			{
+			}
+
+			bool ok() const { return !failed; }
+			bool atEnd() const { return pos == length; }
+
+			uint8_t u8()
+			{
+				if (!require(1))
+					return 0;
+				return data[pos++];
+			}
+
+			uint32_t u32()
+			{
+				if (!require(4))
+					return 0;
+				auto val = (uint32_t(data[pos]) << 24) | (uint32_t(data[pos + 1]) << 16) | (uint32_t(data[pos + 2]) << 8) | data[pos + 3];
+				pos += 4;
+				return val;
+			}
+
+			std::string_view str()
+			{
+				auto len = u32();
+				if (!require(len))
+					return {};
+
+				std::string_view val(reinterpret_cast<const char *>(data + pos), len);
+				pos += len;
+				return val;
+			}
+
+		private:
+			const uint8_t *data;
+			size_t length;
+			size_t pos;
+			bool failed;
+
+			bool require(size_t count)
+			{
+				if (failed || count > length - pos)
+					failed = true;
+				return !failed;
+			}
+	};
+
+	/*
+	 * Length of the payload of the frame starting at `data`, which
+	 * must hold at least FRAME_HEADER_LENGTH bytes
+	 */
+	inline uint32_t FrameLength(const uint8_t *data)
+	{
+		return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+	}
+
+	inline void WriteU8(std::vector<uint8_t>& buf, uint8_t val)
+	{
+		buf.push_back(val);
+	}
+
+	inline void WriteU32(std::vector<uint8_t>& buf, uint32_t val)
+	{
+		uint8_t out[4] = { uint8_t(val >> 24), uint8_t(val >> 16), uint8_t(val >> 8), uint8_t(val) };
+		buf.insert(buf.end(), out, out + 4);
+	}
+
+	inline void WriteString(std::vector<uint8_t>& buf, std::string_view str)
+	{
+		WriteU32(buf, uint32_t(str.length()));
+		buf.insert(buf.end(), str.begin(), str.end());
+	}
+
+	/*
+	 * The payload length is patched in once the payload is written
+	 */
+	inline size_t BeginFrame(std::vector<uint8_t>& buf)
+	{
+		auto start = buf.size();
+		WriteU32(buf, 0);
+		return start;
+	}
+
+	inline void EndFrame(std::vector<uint8_t>& buf, size_t start)
+	{
+		auto length = uint32_t(buf.size() - start - FRAME_HEADER_LENGTH);
+		buf[start] = uint8_t(length >> 24);
+		buf[start + 1] = uint8_t(length >> 16);
+		buf[start + 2] = uint8_t(length >> 8);
+		buf[start + 3] = uint8_t(length);
+	}
+
+	inline void WriteRequest(std::vector<uint8_t>& buf, const CompileRequest& request)
+	{
+		auto frame = BeginFrame(buf);
+		WriteU32(buf, request.id);
+		WriteU8(buf, request.saveToDisk);
+		WriteString(buf, request.scriptType);
+		WriteString(buf, request.scriptName);
+		WriteString(buf, request.source);
+		EndFrame(buf, frame);
+	}
+
+	inline bool ReadRequest(const uint8_t *payload, size_t length, CompileRequest& request)
+	{
+		Reader reader(payload, length);
+		request.id = reader.u32();
+		request.saveToDisk = reader.u8() != 0;
+		request.scriptType = reader.str();
+		request.scriptName = reader.str();
+		request.source = reader.str();
+		return reader.ok() && reader.atEnd();
+	}
+
+	inline void WriteResponse(std::vector<uint8_t>& buf, uint32_t id, const CompilerResponse& response)
+	{
+		auto frame = BeginFrame(buf);
+		WriteU32(buf, id);
+		WriteU8(buf, response.success);
+		WriteString(buf, { reinterpret_cast<const char *>(response.bytecode.buffer()), response.bytecode.length() });
+
+		WriteU32(buf, uint32_t(response.joinedClasses.size()));
+		for (const auto& cls : response.joinedClasses)
+			WriteString(buf, cls);
+
+		WriteU32(buf, uint32_t(response.errors.size()));
+		for (const auto& error : response.errors)
+		{
+			WriteU8(buf, uint8_t(error.level()));
+			WriteU8(buf, uint8_t(error.code()));
+			WriteU32(buf, error.location().line);
+			WriteU32(buf, error.location().column);
+			WriteU32(buf, error.location().length);
+			WriteString(buf, error.msg());
+		}
+		EndFrame(buf, frame);
+	}
+
+	inline bool ReadResponse(const uint8_t *payload, size_t length, CompileResult& result)
+	{
+		Reader reader(payload, length);
+		result.id = reader.u32();
+		result.success = reader.u8() != 0;
+		result.bytecode = reader.str();
+
+		// Nothing is reserved up front, a corrupt count stops at the first read past the end
+		auto classCount = reader.u32();
+		result.joinedClasses.clear();
+		for (uint32_t i = 0; i < classCount && reader.ok(); i++)
+			result.joinedClasses.emplace_back(reader.str());
+
+		auto errorCount = reader.u32();
+		result.errors.clear();
+		for (uint32_t i = 0; i < errorCount && reader.ok(); i++)
+		{
+			auto& error = result.errors.emplace_back();
+			error.level = ErrorLevel(reader.u8());
+			error.category = GS2CompilerError::ErrorCategory(reader.u8());
+			error.location.line = reader.u32();
+			error.location.column = reader.u32();
+			error.location.length = reader.u32();
+			error.msg = reader.str();
+		}
+
+		return reader.ok() && reader.atEnd();
+	}
+}
+
+#endif
@@ -0,0 +1,452 @@
+#include "CompileServer.h"
+
+#ifdef GS2_HAVE_UNIX_SOCKETS
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	// Connections with this many requests in flight, or this much output the
+	// client hasn't read yet, aren't read from until they catch up. Requests
+	// past the limit wait in the input buffer until earlier ones are answered
+	constexpr size_t MAX_PIPELINED_REQUESTS = 256;
+	constexpr size_t MAX_BUFFERED_OUTPUT = 4 * 1024 * 1024;
+
+	// Input buffered per connection, unless it is the start of a single larger frame
+	constexpr size_t MAX_BUFFERED_INPUT = 1024 * 1024;
+
+	// Read from a connection per poll round, so a client that keeps sending
+	// can't hold up the others
+	constexpr size_t MAX_READ_PER_ROUND = 256 * 1024;
+
+	constexpr size_t READ_CHUNK = 64 * 1024;
+
+#ifdef MSG_NOSIGNAL
+	constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+	constexpr int SEND_FLAGS = 0;
+#endif
+
+	bool SetNonBlocking(int fd)
+	{
+		int flags = fcntl(fd, F_GETFL, 0);
+		return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+
+	bool MakeAddress(const std::filesystem::path& path, sockaddr_un& addr)
+	{
+		addr = {};
+		addr.sun_family = AF_UNIX;
+
+		const auto& str = path.native();
+		if (str.size() >= sizeof(addr.sun_path))
+			return false;
+
+		memcpy(addr.sun_path, str.c_str(), str.size() + 1);
+		return true;
+	}
+}
+
+CompileServer::CompileServer(std::filesystem::path socketPath, int jobs, const GS2CompilerOptions& options, bool verbose)
+	: socketPath(std::move(socketPath)), options(options), jobs(jobs), verbose(verbose)
+{
+}
+
+CompileServer::~CompileServer()
+{
+	pool.reset();
+
+	for (auto& [id, conn] : connections)
+		::close(conn.fd);
+
+	if (listenFd >= 0)
+	{
+		::close(listenFd);
+		std::error_code ec;
+		std::filesystem::remove(socketPath, ec);
+	}
+
+	for (int fd : wakeFds)
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+}
+
+bool CompileServer::listen(std::string& error)
+{
+	sockaddr_un addr;
+	if (!MakeAddress(socketPath, addr))
+	{
+		error = "Socket path is too long";
+		return false;
+	}
+
+	// A socket file nobody accepts on is left over from a server that didn't exit cleanly
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe >= 0)
+	{
+		bool inUse = connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+		::close(probe);
+		if (inUse)
+		{
+			error = "Another server is listening on the socket";
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	if (std::filesystem::is_socket(socketPath, ec))
+		std::filesystem::remove(socketPath, ec);
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0 || !SetNonBlocking(listenFd)
+		|| bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+		|| ::listen(listenFd, SOMAXCONN) != 0)
+	{
+		error = std::format("Cannot listen on the socket: {}", strerror(errno));
+		if (listenFd >= 0)
+			::close(listenFd);
+		listenFd = -1;
+		return false;
+	}
+
+	if (pipe(wakeFds) != 0 || !SetNonBlocking(wakeFds[0]) || !SetNonBlocking(wakeFds[1]))
+	{
+		error = std::format("Cannot create the wake pipe: {}", strerror(errno));
+		return false;
+	}
+
+	running = true;
+	return true;
+}
+
+void CompileServer::stop()
+{
+	running = false;
+	wake();
+}
+
+void CompileServer::wake()
+{
+	// Only fails when the pipe is already full, which wakes the loop just the same
+	char byte = 0;
+	[[maybe_unused]] auto written = write(wakeFds[1], &byte, 1);
+}
+
+void CompileServer::run()
+{
+	pool = std::make_unique<CustomThreadPool<CallbackThreadJob>>(jobs);
+
+	std::vector<pollfd> fds;
+	std::vector<uint64_t> fdConnections;
+
+	while (running)
+	{
+		fds.clear();
+		fdConnections.clear();
+		fds.push_back({ listenFd, POLLIN, 0 });
+		fds.push_back({ wakeFds[0], POLLIN, 0 });
+
+		for (const auto& [id, conn] : connections)
+		{
+			short events = 0;
+			if (wantsInput(conn))
+				events |= POLLIN;
+			if (conn.outputPos < conn.output.size())
+				events |= POLLOUT;
+
+			// Waiting on its last responses, a negative fd is skipped so its hangup isn't reported over and over
+			fds.push_back({ events ? conn.fd : -1, events, 0 });
+			fdConnections.push_back(id);
+		}
+
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			fprintf(stderr, "Error: poll failed: %s\n", strerror(errno));
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			char drain[64];
+			while (read(wakeFds[0], drain, sizeof(drain)) > 0)
+			{
+			}
+
+			collectCompletions();
+		}
+
+		for (size_t i = 2; i < fds.size(); i++)
+		{
+			auto id = fdConnections[i - 2];
+			auto it = connections.find(id);
+			if (it == connections.end())
+				continue;
+
+			auto& conn = it->second;
+			bool open = true;
+
+			if (fds[i].revents & (POLLERR | POLLNVAL))
+				open = false;
+			if (open && (fds[i].revents & (POLLIN | POLLHUP)))
+				open = readRequests(id, conn);
+			else if (open)
+				open = queueRequests(id, conn);	// Requests held back until earlier ones were answered
+			if (open && (fds[i].revents & POLLOUT))
+				open = flush(conn);
+
+			if (!open || (conn.closing && !conn.pending && conn.outputPos == conn.output.size()))
+				close(id);
+		}
+
+		if (fds[0].revents & POLLIN)
+			accept();
+	}
+
+	// Jobs still queued are dropped, along with their connections
+	pool->stop();
+	collectCompletions();
+}
+
+void CompileServer::accept()
+{
+	while (true)
+	{
+		int fd = ::accept(listenFd, nullptr, nullptr);
+		if (fd < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				fprintf(stderr, "Error: accept failed: %s\n", strerror(errno));
+			return;
+		}
+
+		if (!SetNonBlocking(fd))
+		{
+			::close(fd);
+			continue;
+		}
+
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+		auto id = nextConnectionId++;
+		connections.emplace(id, Connection{ fd });
+
+		if (verbose)
+			printf("Connection %llu opened\n", static_cast<unsigned long long>(id));
+	}
+}
+
+bool CompileServer::wantsInput(const Connection& conn)
+{
+	if (conn.closing || conn.pending >= MAX_PIPELINED_REQUESTS || conn.output.size() >= MAX_BUFFERED_OUTPUT)
+		return false;
+
+	// A frame larger than the input limit is still received whole
+	size_t limit = MAX_BUFFERED_INPUT;
+	if (conn.input.size() >= protocol::FRAME_HEADER_LENGTH)
+	{
+		auto frameLength = std::min<size_t>(protocol::FrameLength(conn.input.data()), protocol::MAX_FRAME_LENGTH);
+		limit = std::max(limit, protocol::FRAME_HEADER_LENGTH + frameLength);
+	}
+
+	return conn.input.size() < limit;
+}
+
+bool CompileServer::readRequests(uint64_t id, Connection& conn)
+{
+	size_t budget = MAX_READ_PER_ROUND;
+	while (budget && wantsInput(conn))
+	{
+		size_t received = conn.input.size();
+		size_t chunk = std::min(READ_CHUNK, budget);
+		conn.input.resize(received + chunk);
+
+		auto len = recv(conn.fd, conn.input.data() + received, chunk, 0);
+		conn.input.resize(received + (len > 0 ? size_t(len) : 0));
+		if (len > 0)
+		{
+			budget -= size_t(len);
+			if (!queueRequests(id, conn))
+				return false;
+			continue;
+		}
+
+		if (len == 0)
+		{
+			conn.closing = true;
+			break;
+		}
+
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		return false;
+	}
+
+	return queueRequests(id, conn);
+}
+
+bool CompileServer::queueRequests(uint64_t id, Connection& conn)
+{
+	// Queue complete frames up to the pipelining limit, a partial one waits for the rest of its bytes
+	size_t pos = 0;
+	while (conn.pending < MAX_PIPELINED_REQUESTS && conn.input.size() - pos >= protocol::FRAME_HEADER_LENGTH)
+	{
+		auto length = protocol::FrameLength(conn.input.data() + pos);
+		if (length > protocol::MAX_FRAME_LENGTH)
+		{
+			if (verbose)
+				printf("Connection %llu sent a frame of %u bytes, closing\n", static_cast<unsigned long long>(id), length);
+			return false;
+		}
+
+		if (conn.input.size() - pos - protocol::FRAME_HEADER_LENGTH < length)
+			break;
+
+		protocol::CompileRequest request;
+		if (!protocol::ReadRequest(conn.input.data() + pos + protocol::FRAME_HEADER_LENGTH, length, request))
+		{
+			if (verbose)
+				printf("Connection %llu sent a malformed request, closing\n", static_cast<unsigned long long>(id));
+			return false;
+		}
+
+		pos += protocol::FRAME_HEADER_LENGTH + length;
+		++conn.pending;
+		queueCompile(id, std::move(request));
+	}
+
+	conn.input.erase(conn.input.begin(), conn.input.begin() + pos);
+	return true;
+}
+
+void CompileServer::queueCompile(uint64_t connectionId, protocol::CompileRequest request)
+{
+	++requestCount;
+
+	auto shared = std::make_shared<protocol::CompileRequest>(std::move(request));
+	pool->queue(CallbackThreadJob([this, connectionId, shared](CallbackThreadJob::thread_context& th_context, CallbackThreadJob::promise_type& promise) {
+		auto& context = th_context.gs2context;
+		context.setOptions(options);
+
+		auto& req = *shared;
+		CompilerResponse response;
+		if (req.scriptType.empty() && req.scriptName.empty())
+		{
+			// The scanner needs two null bytes after the script, std::string guarantees one
+			auto length = req.source.size();
+			req.source.push_back('\0');
+			response = context.compileInPlace(req.source.data(), length);
+		}
+		else
+			response = context.compile(req.source, req.scriptType, req.scriptName, req.saveToDisk);
+
+		std::vector<uint8_t> frame;
+		frame.reserve(response.bytecode.length() + 64);
+		protocol::WriteResponse(frame, req.id, response);
+
+		bool wasEmpty;
+		{
+			std::scoped_lock lock(completionLock);
+			wasEmpty = completions.empty();
+			completions.push_back({ connectionId, std::move(frame) });
+		}
+
+		if (wasEmpty)
+			wake();
+
+		promise.set_value({});
+	}));
+}
+
+void CompileServer::collectCompletions()
+{
+	std::vector<Completion> finished;
+	{
+		std::scoped_lock lock(completionLock);
+		finished.swap(completions);
+	}
+
+	for (auto& completion : finished)
+	{
+		// The client may have disconnected while its script was compiling
+		auto it = connections.find(completion.connectionId);
+		if (it == connections.end())
+			continue;
+
+		auto& conn = it->second;
+		if (conn.output.empty())
+			conn.output = std::move(completion.frame);
+		else
+			conn.output.insert(conn.output.end(), completion.frame.begin(), completion.frame.end());
+		--conn.pending;
+
+		// Requests held back by the pipelining limit are queued before the
+		// connection is considered finished, a client that stopped sending
+		// may still have some waiting in its input
+		if (!queueRequests(completion.connectionId, conn))
+		{
+			close(completion.connectionId);
+			continue;
+		}
+
+		// Most responses fit in the socket buffer, so they are written right away
+		if (!flush(conn) || (conn.closing && !conn.pending && conn.output.empty()))
+			close(completion.connectionId);
+	}
+}
+
+bool CompileServer::flush(Connection& conn)
+{
+	while (conn.outputPos < conn.output.size())
+	{
+		auto len = send(conn.fd, conn.output.data() + conn.outputPos, conn.output.size() - conn.outputPos, SEND_FLAGS);
+		if (len > 0)
+		{
+			conn.outputPos += size_t(len);
+			continue;
+		}
+
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		return false;
+	}
+
+	conn.output.clear();
+	conn.outputPos = 0;
+	return true;
+}
+
+void CompileServer::close(uint64_t id)
+{
+	auto it = connections.find(id);
+	if (it == connections.end())
+		return;
+
+	::close(it->second.fd);
+	connections.erase(it);
+
+	if (verbose)
+		printf("Connection %llu closed\n", static_cast<unsigned long long>(id));
+}
+
+#endif
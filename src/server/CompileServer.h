@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef COMPILESERVER_H
+#define COMPILESERVER_H
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GS2_HAVE_UNIX_SOCKETS
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompileProtocol.h"
+#include "CompilerThreadJob.h"
+#include "compiler/GS2CompilerOptions.h"
+#include "utils/ContextThreadPool.h"
+
+/*
+ * Long-lived compiler listening on a Unix domain socket, see
+ * CompileProtocol.h for the messages.
+ *
+ * A single thread accepts connections and reads requests, each request is
+ * compiled on a thread pool where every worker keeps its own GS2Context
+ * warm between requests. Finished responses are handed back to the socket
+ * thread, which writes them out as the clients read them.
+ */
+class CompileServer
+{
+	public:
+		CompileServer(std::filesystem::path socketPath, int jobs, const GS2CompilerOptions& options, bool verbose = false);
+		~CompileServer();
+
+		CompileServer(const CompileServer&) = delete;
+		CompileServer& operator=(const CompileServer&) = delete;
+
+		/*
+		 * Creates the socket, a stale socket file left by a previous
+		 * server is replaced but a running server is not
+		 *
+		 * @return false with `error` set if the socket can't be created
+		 */
+		bool listen(std::string& error);
+
+		/*
+		 * Serves requests until stop() is called
+		 */
+		void run();
+
+		/*
+		 * Makes run() return, safe to call from another thread or a signal handler
+		 */
+		void stop();
+
+		uint64_t getRequestCount() const { return requestCount; }
+		const std::filesystem::path& getSocketPath() const { return socketPath; }
+
+	private:
+		struct Connection
+		{
+			int fd;
+			std::vector<uint8_t> input;
+			std::vector<uint8_t> output;
+			size_t outputPos = 0;
+			size_t pending = 0;		// Requests still being compiled
+			bool closing = false;	// Client stopped sending, close once everything is answered
+		};
+
+		struct Completion
+		{
+			uint64_t connectionId;
+			std::vector<uint8_t> frame;
+		};
+
+		std::filesystem::path socketPath;
+		GS2CompilerOptions options;
+		int jobs;
+		bool verbose;
+
+		int listenFd = -1;
+		int wakeFds[2] = { -1, -1 };
+		std::atomic<bool> running{ false };
+		uint64_t requestCount = 0;
+
+		uint64_t nextConnectionId = 0;
+		std::unordered_map<uint64_t, Connection> connections;
+
+		// Filled by the workers, drained by the socket thread
+		std::mutex completionLock;
+		std::vector<Completion> completions;
+
+		// Destroyed first, so no worker is left to touch the members above
+		std::unique_ptr<CustomThreadPool<CallbackThreadJob>> pool;
+
+		void wake();
+		void accept();
+		void collectCompletions();
+		static bool wantsInput(const Connection& conn);
+		bool readRequests(uint64_t id, Connection& conn);
+		bool queueRequests(uint64_t id, Connection& conn);
+		bool flush(Connection& conn);
+		void close(uint64_t id);
+		void queueCompile(uint64_t connectionId, protocol::CompileRequest request);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "DirectoryWatcher.h"
+
+#ifdef GS2_HAVE_INOTIFY
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr uint32_t CHANGED_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO;
+	constexpr uint32_t REMOVED_EVENTS = IN_DELETE | IN_MOVED_FROM;
+
+	void AddUnique(std::vector<std::filesystem::path>& paths, const std::filesystem::path& path)
+	{
+		if (std::find(paths.begin(), paths.end(), path) == paths.end())
+			paths.push_back(path);
+	}
+
+	void Remove(std::vector<std::filesystem::path>& paths, const std::filesystem::path& path)
+	{
+		paths.erase(std::remove(paths.begin(), paths.end(), path), paths.end());
+	}
+}
+
+DirectoryWatcher::DirectoryWatcher(std::filesystem::path directory)
+	: directory(std::move(directory))
+{
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	if (inotifyFd >= 0)
+		close(inotifyFd);
+
+	for (int fd : wakeFds)
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
+bool DirectoryWatcher::start(std::string& error)
+{
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), CHANGED_EVENTS | REMOVED_EVENTS | IN_ONLYDIR) < 0)
+	{
+		error = std::format("Cannot watch {}: {}", directory.string(), strerror(errno));
+		return false;
+	}
+
+	if (pipe2(wakeFds, O_NONBLOCK | O_CLOEXEC) != 0)
+	{
+		error = std::format("Cannot create the wake pipe: {}", strerror(errno));
+		return false;
+	}
+
+	running = true;
+	return true;
+}
+
+void DirectoryWatcher::stop()
+{
+	running = false;
+
+	char byte = 0;
+	[[maybe_unused]] auto written = write(wakeFds[1], &byte, 1);
+}
+
+bool DirectoryWatcher::wait(std::vector<std::filesystem::path>& changed, std::vector<std::filesystem::path>& removed,
+	std::chrono::milliseconds quiet)
+{
+	changed.clear();
+	removed.clear();
+
+	while (running)
+	{
+		pollfd fds[] = { { inotifyFd, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } };
+
+		// Block for the first event, after that only wait out the burst
+		bool waitingForBurst = !changed.empty() || !removed.empty();
+		int ready = poll(fds, 2, waitingForBurst ? int(quiet.count()) : -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		if (ready == 0)
+			return true;
+
+		if (fds[1].revents & POLLIN)
+			break;
+
+		readEvents(changed, removed);
+	}
+
+	return false;
+}
+
+void DirectoryWatcher::readEvents(std::vector<std::filesystem::path>& changed, std::vector<std::filesystem::path>& removed)
+{
+	alignas(inotify_event) char buffer[16 * 1024];
+
+	while (true)
+	{
+		auto length = read(inotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+			return;
+
+		for (char *ptr = buffer; ptr < buffer + length;)
+		{
+			auto event = reinterpret_cast<const inotify_event *>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			// Events were dropped, the directory itself is reported so it gets rescanned
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				AddUnique(changed, directory);
+				continue;
+			}
+
+			// The directory was removed or unmounted
+			if (event->mask & IN_IGNORED)
+			{
+				running = false;
+				return;
+			}
+
+			if (!event->len || (event->mask & IN_ISDIR))
+				continue;
+
+			auto path = directory / event->name;
+			if (event->mask & CHANGED_EVENTS)
+			{
+				Remove(removed, path);
+				AddUnique(changed, path);
+			}
+			else if (event->mask & REMOVED_EVENTS)
+			{
+				Remove(changed, path);
+				AddUnique(removed, path);
+			}
+		}
+	}
+}
+
+#endif
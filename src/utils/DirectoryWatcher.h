@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#ifdef __linux__
+#define GS2_HAVE_INOTIFY
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/*
+ * Reports the files of a directory that were written, moved in or removed,
+ * using inotify. Editors tend to save in a burst of events (truncate, write,
+ * rename), so wait() keeps collecting until the directory has been quiet for
+ * a moment and returns each file once.
+ */
+class DirectoryWatcher
+{
+	public:
+		explicit DirectoryWatcher(std::filesystem::path directory);
+		~DirectoryWatcher();
+
+		DirectoryWatcher(const DirectoryWatcher&) = delete;
+		DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+		/*
+		 * @return false with `error` set if the directory can't be watched
+		 */
+		bool start(std::string& error);
+
+		/*
+		 * Blocks until files change, then until no event arrived for `quiet`
+		 *
+		 * @return false once stop() was called
+		 */
+		bool wait(std::vector<std::filesystem::path>& changed, std::vector<std::filesystem::path>& removed,
+			std::chrono::milliseconds quiet);
+
+		/*
+		 * Makes wait() return false, safe to call from a signal handler
+		 */
+		void stop();
+
+	private:
+		std::filesystem::path directory;
+		int inotifyFd = -1;
+		int wakeFds[2] = { -1, -1 };
+		std::atomic<bool> running{ false };
+
+		void readEvents(std::vector<std::filesystem::path>& changed, std::vector<std::filesystem::path>& removed);
+};
+
+#endif
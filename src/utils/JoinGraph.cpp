@@ -0,0 +1,183 @@
+#include "JoinGraph.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+
+void JoinGraph::setClass(const std::string& name, const std::set<std::string>& joins)
+{
+	classes[name].assign(joins.begin(), joins.end());
+}
+
+void JoinGraph::removeClass(const std::string& name)
+{
+	classes.erase(name);
+}
+
+/*
+ * Strongly connected components with Tarjan's algorithm. A component is only
+ * completed once every component it joins is, so they come out in load order.
+ * Written without recursion, as a long chain of joins would otherwise need a
+ * stack frame per class
+ */
+std::vector<std::vector<std::string>> JoinGraph::components() const
+{
+	std::vector<const std::string *> names;
+	std::map<std::string_view, size_t> indices;
+	for (const auto& [name, joins] : classes)
+	{
+		indices.emplace(name, names.size());
+		names.push_back(&name);
+	}
+
+	std::vector<std::vector<size_t>> edges;
+	edges.reserve(names.size());
+	for (const auto& [name, joins] : classes)
+	{
+		auto& edge = edges.emplace_back();
+		for (const auto& join : joins)
+		{
+			if (auto it = indices.find(join); it != indices.end())
+				edge.push_back(it->second);
+		}
+	}
+
+	constexpr size_t UNVISITED = size_t(-1);
+	std::vector<size_t> index(names.size(), UNVISITED);
+	std::vector<size_t> lowLink(names.size());
+	std::vector<bool> onStack(names.size());
+	std::vector<size_t> stack;
+	std::vector<std::pair<size_t, size_t>> frames;	// class, next edge
+	size_t counter = 0;
+
+	std::vector<std::vector<std::string>> result;
+
+	auto visit = [&](size_t node) {
+		index[node] = lowLink[node] = counter++;
+		stack.push_back(node);
+		onStack[node] = true;
+		frames.emplace_back(node, 0);
+	};
+
+	for (size_t root = 0; root < names.size(); root++)
+	{
+		if (index[root] != UNVISITED)
+			continue;
+
+		visit(root);
+		while (!frames.empty())
+		{
+			auto [node, next] = frames.back();
+			if (next < edges[node].size())
+			{
+				frames.back().second++;
+
+				auto joined = edges[node][next];
+				if (index[joined] == UNVISITED)
+					visit(joined);
+				else if (onStack[joined])
+					lowLink[node] = std::min(lowLink[node], index[joined]);
+				continue;
+			}
+
+			frames.pop_back();
+			if (!frames.empty())
+				lowLink[frames.back().first] = std::min(lowLink[frames.back().first], lowLink[node]);
+
+			if (lowLink[node] != index[node])
+				continue;
+
+			std::vector<size_t> members;
+			size_t member;
+			do
+			{
+				member = stack.back();
+				stack.pop_back();
+				onStack[member] = false;
+				members.push_back(member);
+			} while (member != node);
+
+			// Names were numbered in sorted order
+			std::sort(members.begin(), members.end());
+
+			auto& component = result.emplace_back();
+			for (auto i : members)
+				component.push_back(*names[i]);
+		}
+	}
+
+	return result;
+}
+
+std::vector<std::string> JoinGraph::order() const
+{
+	std::vector<std::string> result;
+	result.reserve(classes.size());
+
+	for (auto& component : components())
+		std::move(component.begin(), component.end(), std::back_inserter(result));
+
+	return result;
+}
+
+std::vector<std::vector<std::string>> JoinGraph::cycles() const
+{
+	std::vector<std::vector<std::string>> result;
+
+	for (auto& component : components())
+	{
+		const auto& joins = classes.at(component.front());
+		if (component.size() > 1 || std::binary_search(joins.begin(), joins.end(), component.front()))
+			result.push_back(std::move(component));
+	}
+
+	return result;
+}
+
+std::vector<std::string> JoinGraph::affectedBy(const std::vector<std::string>& changed) const
+{
+	std::map<std::string_view, std::vector<std::string_view>> joinedBy;
+	for (const auto& [name, joins] : classes)
+	{
+		for (const auto& join : joins)
+			joinedBy[join].push_back(name);
+	}
+
+	std::set<std::string_view> affected(changed.begin(), changed.end());
+	std::vector<std::string_view> pending(affected.begin(), affected.end());
+	while (!pending.empty())
+	{
+		auto name = pending.back();
+		pending.pop_back();
+
+		if (auto it = joinedBy.find(name); it != joinedBy.end())
+		{
+			for (auto joiner : it->second)
+			{
+				if (affected.insert(joiner).second)
+					pending.push_back(joiner);
+			}
+		}
+	}
+
+	auto result = order();
+	result.erase(std::remove_if(result.begin(), result.end(), [&](const std::string& name) {
+		return !affected.contains(name);
+	}), result.end());
+	return result;
+}
+
+std::vector<std::string> JoinGraph::unresolved() const
+{
+	std::set<std::string> missing;
+	for (const auto& [name, joins] : classes)
+	{
+		for (const auto& join : joins)
+		{
+			if (!classes.contains(join))
+				missing.insert(join);
+		}
+	}
+
+	return { missing.begin(), missing.end() };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef JOINGRAPH_H
+#define JOINGRAPH_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * Which classes every script joins, named after the file they are compiled
+ * from. Joined classes are looked up when the script runs, so a change to a
+ * class never requires compiling the scripts that join it again, but they
+ * have to be reloaded after it, and a class must be loaded before the
+ * scripts that join it.
+ */
+class JoinGraph
+{
+	public:
+		/*
+		 * Adds the class, or replaces the classes it joined before
+		 */
+		void setClass(const std::string& name, const std::set<std::string>& joins);
+
+		void removeClass(const std::string& name);
+
+		const std::map<std::string, std::vector<std::string>>& getClasses() const { return classes; }
+
+		/*
+		 * Every class, each after the classes it joins. The classes of a
+		 * cycle are kept together in name order, they can't be ordered
+		 */
+		std::vector<std::string> order() const;
+
+		/*
+		 * Groups of classes that join each other, including a class that
+		 * joins itself
+		 */
+		std::vector<std::vector<std::string>> cycles() const;
+
+		/*
+		 * The changed classes and every class that joins one of them,
+		 * directly or through another class, in load order. Classes that
+		 * were removed still affect the classes that joined them
+		 */
+		std::vector<std::string> affectedBy(const std::vector<std::string>& changed) const;
+
+		/*
+		 * Joined classes without a script
+		 */
+		std::vector<std::string> unresolved() const;
+
+	private:
+		std::map<std::string, std::vector<std::string>> classes;
+
+		std::vector<std::vector<std::string>> components() const;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+GS2 Diagnostics Test
+Compiles scripts with several syntax errors each, where the token the
+error is raised at ends its line, and checks that every error quotes the
+line it was raised on, serially and with -j.
+"""
+
+import tempfile
+import subprocess
+from pathlib import Path
+from typing import Dict, List
+
+from gs2_test_support import argument_parser, run_tester
+
+# script -> source, and the errors it should report
+SCRIPTS = {
+    "semicolons.gs2": (
+        "function onCreated() {\n"
+        "  temp.x = 5\n"
+        "  temp.y = 1;\n"
+        "  temp.a = 6\n"
+        "  temp.b = 2;\n"
+        "  temp.c = 3;\n"
+        "}\n",
+        [
+            "missing semicolon at line 3:   temp.y = 1;",
+            "missing semicolon at line 5:   temp.b = 2;",
+        ]
+    ),
+    "enum.gs2": (
+        "enum {\n"
+        "  A\n"
+        "  B,\n"
+        "  C\n"
+        "  D,\n"
+        "  E\n"
+        "};\n",
+        [
+            "missing comma in enum list at line 3:   B,",
+            "missing comma in enum list at line 5:   D,",
+        ]
+    ),
+}
+
+ERROR_PREFIX = " -> [ERROR] "
+
+class GS2DiagnosticsTester:
+    """Compiles scripts with syntax errors and checks the reported lines"""
+
+    def __init__(self, compiler_path: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.quiet = quiet
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _errors(self, directory: Path, *options: str) -> Dict[str, List[str]]:
+        """The error lines gs2test reports for every script in the directory"""
+        result = subprocess.run([str(self.compiler_path), str(directory), *options],
+            capture_output=True, timeout=60)
+
+        errors: Dict[str, List[str]] = {}
+        current = None
+        in_error = False
+        for line in result.stdout.decode("utf-8", "replace").split("\n"):
+            if line.startswith("Processing: "):
+                current = line[len("Processing: "):]
+                errors[current] = []
+                in_error = False
+            elif current and line.startswith(ERROR_PREFIX):
+                errors[current].append(line[len(ERROR_PREFIX):])
+                in_error = True
+            elif current and in_error and line:
+                errors[current].append(line)
+            else:
+                in_error = False
+        return errors
+
+    def run(self) -> bool:
+        problems = []
+        with tempfile.TemporaryDirectory(prefix="gs2diag_") as tmp:
+            scripts = Path(tmp)
+            for name, (source, _) in SCRIPTS.items():
+                (scripts / name).write_text(source)
+
+            for options in ([], ["-j", "2"]):
+                errors = self._errors(scripts, *options)
+                mode = " ".join(options) or "serial"
+                for name, (_, expected) in SCRIPTS.items():
+                    if errors.get(name) != expected:
+                        problems.append(f"{name} ({mode}): reported {errors.get(name)}")
+
+        for problem in problems:
+            print(problem)
+
+        if problems:
+            print("Diagnostics failures detected")
+            return False
+
+        self.log("Diagnostics OK")
+        return True
+
+def main():
+    args = argument_parser("GS2 Diagnostics Test", baselines=False).parse_args()
+    run_tester(GS2DiagnosticsTester(args.compiler, args.quiet))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""
+GS2 Disassembler Test
+Disassembles the bytecode baselines with gs2test --disasm and checks that
+every op decodes to a known name with in-range operands, that compiling a
+script in memory lists the same as its baseline bytecode, and that
+truncated bytecode is rejected instead of misread.
+"""
+
+import re
+import sys
+import tempfile
+import subprocess
+from pathlib import Path
+from typing import List
+
+from gs2_test_support import argument_parser, load_baselines, run_tester
+
+FILE_MARKER = re.compile(r"^; file: .*$", re.MULTILINE)
+UNKNOWN_OP = re.compile(r"^ +\d+  OP \d+", re.MULTILINE)
+JUMP = re.compile(r"-> (\d+)$", re.MULTILINE)
+OP_COUNT = re.compile(r"^; \d+ functions, \d+ strings, (\d+) ops", re.MULTILINE)
+
+class GS2DisasmTester:
+    """Runs gs2test --disasm over the baselines and their scripts"""
+
+    def __init__(self, compiler_path: Path, scripts_dir: Path, baselines_dir: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.scripts_dir = scripts_dir
+        self.baselines_dir = baselines_dir
+        self.quiet = quiet
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _disasm(self, inputs: List[Path]) -> subprocess.CompletedProcess:
+        result = subprocess.run(
+            [str(self.compiler_path), "--disasm", *map(str, inputs)],
+            capture_output=True,
+            text=True,
+            timeout=60
+        )
+
+        if result.returncode < 0:
+            raise RuntimeError(f"gs2test crashed with signal {-result.returncode}:\n{result.stderr}")
+
+        return result
+
+    def _listings(self, inputs: List[Path]) -> List[str]:
+        """Listing of every input, in order"""
+        result = self._disasm(inputs)
+        if result.returncode != 0:
+            raise RuntimeError(f"gs2test --disasm failed:\n{result.stderr}")
+
+        return FILE_MARKER.split(result.stdout)[1:] if len(inputs) > 1 else [result.stdout]
+
+    def _check_listing(self, name: str, listing: str) -> List[str]:
+        problems = []
+
+        if UNKNOWN_OP.search(listing):
+            problems.append(f"{name}: op without a name")
+
+        if "(out of range)" in listing:
+            problems.append(f"{name}: string index out of range")
+
+        op_count = OP_COUNT.search(listing)
+        if not op_count:
+            problems.append(f"{name}: missing summary")
+        else:
+            for target in JUMP.findall(listing):
+                if int(target) > int(op_count.group(1)):
+                    problems.append(f"{name}: jump to op {target} past the end")
+                    break
+
+        return problems
+
+    def run(self) -> bool:
+        scripts = [rel for rel, _ in load_baselines(self.scripts_dir, self.baselines_dir, compiled_only=True)]
+
+        if not scripts:
+            print("No baselines found")
+            return False
+
+        problems = []
+        with tempfile.TemporaryDirectory(prefix="gs2disasm_") as tmp:
+            # gs2test recognizes compiled scripts by their extension
+            bytecode_files = []
+            for rel in scripts:
+                path = Path(tmp) / rel.with_suffix(".gs2bc")
+                path.parent.mkdir(parents=True, exist_ok=True)
+                path.write_bytes((self.baselines_dir / rel.with_suffix(".bytecode")).read_bytes())
+                bytecode_files.append(path)
+
+            self.log(f"Disassembling {len(scripts)} baselines")
+            baseline_listings = self._listings(bytecode_files)
+            source_listings = self._listings([self.scripts_dir / rel for rel in scripts])
+
+            for rel, baseline, source in zip(scripts, baseline_listings, source_listings):
+                problems.extend(self._check_listing(str(rel), baseline))
+                if baseline != source:
+                    problems.append(f"{rel}: listing of the compiled script differs from its baseline")
+
+            # Every truncation of a script has to be reported, not crash or list garbage
+            truncated = Path(tmp) / "truncated.gs2bc"
+            data = bytecode_files[0].read_bytes()
+            for length in range(0, len(data) - 1, max(1, len(data) // 64)):
+                truncated.write_bytes(data[:length])
+                if self._disasm([truncated]).returncode != 1:
+                    problems.append(f"{scripts[0]}: truncated to {length} bytes was not rejected")
+                    break
+
+        for problem in problems:
+            print(problem)
+
+        if problems:
+            print("Disassembler failures detected")
+            return False
+
+        self.log("All listings OK")
+        return True
+
+def main():
+    args = argument_parser("GS2 Disassembler Test").parse_args()
+    run_tester(GS2DisasmTester(args.compiler, args.scripts_dir, args.baselines_dir, args.quiet))
+
+if __name__ == "__main__":
+    main()
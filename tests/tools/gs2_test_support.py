@@ -0,0 +1,105 @@
+"""
+Helpers shared by the gs2test test runners in this directory: the
+command line every runner takes, loading the regression baselines,
+decoding compiled scripts and running a tester to an exit code.
+"""
+
+import sys
+import json
+import argparse
+import subprocess
+from pathlib import Path
+from typing import Dict, Iterator, List, NamedTuple, Optional, Tuple
+
+SEGMENT_FUNCTIONS = 2
+SEGMENT_STRINGS = 3
+SEGMENT_BYTECODE = 4
+
+JUMP_OPS = {1, 2, 3, 4, 5, 150, 163}
+OPERAND_SIZE = {0xF0: 1, 0xF1: 2, 0xF2: 4, 0xF3: 1, 0xF4: 2, 0xF5: 4}
+OPERAND_STRING = 0xF6
+
+def argument_parser(description: str, baselines: bool = True) -> argparse.ArgumentParser:
+    """--compiler and --quiet, along with --scripts-dir and --baselines-dir for runners that use the baselines"""
+    parser = argparse.ArgumentParser(description=description)
+    parser.add_argument("--compiler", type=Path, required=True, help="Path to the gs2test executable")
+    if baselines:
+        parser.add_argument("--scripts-dir", type=Path, required=True, help="Directory containing test scripts")
+        parser.add_argument("--baselines-dir", type=Path, required=True, help="Directory containing baseline files")
+    parser.add_argument("--quiet", action="store_true", help="Only print failures")
+    return parser
+
+def load_baselines(scripts_dir: Path, baselines_dir: Path, compiled_only: bool = False) -> List[Tuple[Path, dict]]:
+    """Every script that has a baseline, by its path relative to scripts_dir, in sorted order"""
+    baselines = []
+    for script in sorted(scripts_dir.rglob("*.gs2")):
+        rel = script.relative_to(scripts_dir)
+        baseline = baselines_dir / rel.with_suffix(".json")
+        if not baseline.exists():
+            continue
+
+        with open(baseline, 'r') as f:
+            data = json.load(f)
+
+        if data["compilation_success"] or not compiled_only:
+            baselines.append((rel, data))
+
+    return baselines
+
+class Op(NamedTuple):
+    code: int
+    prefix: Optional[int]      # Operand prefix, None without an operand
+    value: int                 # Unsigned operand value, 0 for strings and ops without an operand
+    offset: Optional[int]      # Offset of the operand value in the script
+
+class Bytecode:
+    """The segments and ops of a compiled script without a header"""
+
+    def __init__(self, data: bytes):
+        self.data = data
+        self.segments: Dict[int, Tuple[int, int, int]] = {}    # type -> offset, offset of its data, length
+        pos = 0
+        while len(data) - pos >= 8:
+            seg_type = int.from_bytes(data[pos:pos + 4], "big")
+            length = int.from_bytes(data[pos + 4:pos + 8], "big")
+            self.segments[seg_type] = (pos, pos + 8, length)
+            pos += 8 + length
+
+        self.strings = self.segment(SEGMENT_STRINGS).split(b"\0")[:-1]
+
+    def segment(self, seg_type: int) -> bytes:
+        _, start, length = self.segments[seg_type]
+        return self.data[start:start + length]
+
+    def ops(self) -> Iterator[Op]:
+        _, start, length = self.segments[SEGMENT_BYTECODE]
+        end = start + length
+        pos = start
+        while pos < end:
+            code = self.data[pos]
+            pos += 1
+            if pos < end and self.data[pos] >= 0xF0:
+                prefix = self.data[pos]
+                offset = pos + 1
+                if prefix == OPERAND_STRING:
+                    pos = self.data.index(0, offset) + 1
+                    yield Op(code, prefix, 0, offset)
+                else:
+                    pos = offset + OPERAND_SIZE[prefix]
+                    yield Op(code, prefix, int.from_bytes(self.data[offset:pos], "big"), offset)
+            else:
+                yield Op(code, None, 0, None)
+
+    def patch(self, offset: int, value: bytes) -> bytes:
+        """A copy of the script with value written over the bytes at offset"""
+        return self.data[:offset] + value + self.data[offset + len(value):]
+
+def run_tester(tester):
+    """Runs the tester and exits with its result, an error running gs2test fails the test"""
+    try:
+        success = tester.run()
+    except (RuntimeError, OSError, subprocess.TimeoutExpired) as e:
+        print(f"Error: {e}")
+        success = False
+
+    sys.exit(0 if success else 1)
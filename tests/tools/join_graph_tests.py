@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+GS2 Join Graph Test
+Compiles directories of scripts that join each other with gs2test --deps.
+Checks the joined classes, that the load order puts every class after the
+classes it joins, that cycles and classes without a script are reported,
+and that after an edit only the edited class and the classes joining it
+are reported as affected, in directory mode with a build cache and in
+watch mode, also after a save that doesn't compile and after inotify
+events were lost.
+"""
+
+import sys
+import json
+import queue
+import signal
+import tempfile
+import threading
+import subprocess
+from pathlib import Path
+from typing import Dict, List
+
+from gs2_test_support import argument_parser, run_tester
+
+# class -> classes it joins, "missing" has no script
+SCRIPTS = {
+    "base": [],
+    "a": ["base"],
+    "b": ["a", "base"],
+    "c": ["b", "missing"],
+    "x": ["y"],
+    "y": ["x"],
+    "self": ["self"],
+}
+
+CHAIN_LENGTH = 3000
+ROUND_TIMEOUT = 30
+OVERFLOW_EVENTS = 20000    # More than the default fs.inotify.max_queued_events, with a higher limit none are lost
+
+def source(joins: List[str], extra: str = "") -> str:
+    return "".join(f'join("{join}");\n' for join in joins) + "function onCreated() { x = 1; }\n" + extra
+
+class GS2JoinGraphTester:
+    """Runs gs2test --deps over generated scripts"""
+
+    def __init__(self, compiler_path: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.quiet = quiet
+        self.problems: List[str] = []
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _compile(self, directory: Path, *options: str) -> dict:
+        deps = directory.parent / "deps.json"
+        result = subprocess.run([str(self.compiler_path), str(directory), "--deps", str(deps), *options],
+            capture_output=True, text=True, timeout=120)
+        if result.returncode != 0:
+            raise RuntimeError(f"gs2test exited with {result.returncode}:\n{result.stderr}")
+        with open(deps, 'r') as f:
+            graph = json.load(f)
+        graph["stdout"] = result.stdout
+        return graph
+
+    def _check_order(self, name: str, graph: dict, classes: Dict[str, List[str]]):
+        order = graph["order"]
+        if sorted(order) != sorted(classes):
+            self.problems.append(f"{name}: order doesn't list every class once")
+            return
+
+        position = {cls: i for i, cls in enumerate(order)}
+        cyclic = {cls for cycle in graph["cycles"] for cls in cycle}
+        for cls, joins in classes.items():
+            for join in joins:
+                if join in position and join not in cyclic and position[join] > position[cls]:
+                    self.problems.append(f"{name}: {cls} is loaded before {join}, which it joins")
+
+    def test_directory(self, tmp: Path):
+        scripts = tmp / "scripts"
+        scripts.mkdir()
+        for cls, joins in SCRIPTS.items():
+            (scripts / f"{cls}.gs2").write_text(source(joins))
+
+        cache = str(tmp / "cache")
+        graph = self._compile(scripts, "--cache-dir", cache)
+
+        if graph["classes"] != {cls: sorted(joins) for cls, joins in SCRIPTS.items()}:
+            self.problems.append(f"joined classes are {graph['classes']}")
+        self._check_order("directory", graph, SCRIPTS)
+        if sorted(graph["cycles"]) != [["self"], ["x", "y"]]:
+            self.problems.append(f"cycles are {graph['cycles']}")
+        if graph["unresolved"] != ["missing"]:
+            self.problems.append(f"unresolved classes are {graph['unresolved']}")
+        if graph["changed"] != sorted(SCRIPTS):
+            self.problems.append(f"first build changed {graph['changed']}")
+        if "Classes join each other: x, y" not in graph["stdout"]:
+            self.problems.append("cycle was not reported")
+
+        # Nothing changed, the joins come back from the cache
+        graph = self._compile(scripts, "--cache-dir", cache)
+        if graph["changed"] or graph["affected"]:
+            self.problems.append(f"rebuild without changes affected {graph['affected']}")
+        if graph["classes"] != {cls: sorted(joins) for cls, joins in SCRIPTS.items()}:
+            self.problems.append("joined classes were lost by the build cache")
+
+        (scripts / "a.gs2").write_text(source(SCRIPTS["a"], "function onPlayerEnters() { y = 2; }\n"))
+        graph = self._compile(scripts, "--cache-dir", cache)
+        if graph["changed"] != ["a"]:
+            self.problems.append(f"editing a changed {graph['changed']}")
+        if graph["affected"] != ["a", "b", "c"]:
+            self.problems.append(f"editing a affected {graph['affected']}")
+
+    def test_chain(self, tmp: Path):
+        """A long chain of joins, every class joins the one after it"""
+        scripts = tmp / "chain"
+        scripts.mkdir()
+        classes = {f"class{i:05}": [f"class{i + 1:05}"] if i + 1 < CHAIN_LENGTH else [] for i in range(CHAIN_LENGTH)}
+        for cls, joins in classes.items():
+            (scripts / f"{cls}.gs2").write_text(source(joins))
+
+        graph = self._compile(scripts)
+        if graph["cycles"]:
+            self.problems.append(f"chain has cycles {graph['cycles'][:3]}")
+        self._check_order("chain", graph, classes)
+
+    def test_watch(self, tmp: Path):
+        scripts = tmp / "watched"
+        scripts.mkdir()
+        for cls, joins in SCRIPTS.items():
+            (scripts / f"{cls}.gs2").write_text(source(joins))
+
+        lines: "queue.Queue" = queue.Queue()
+        watcher = subprocess.Popen([str(self.compiler_path), "--watch", str(scripts)],
+            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+
+        def read():
+            for line in watcher.stdout:
+                lines.put(line.rstrip("\n"))
+            lines.put(None)
+
+        reader = threading.Thread(target=read)
+        reader.start()
+
+        def next_reload() -> str:
+            while True:
+                line = lines.get(timeout=ROUND_TIMEOUT)
+                if line is None:
+                    raise RuntimeError("gs2test exited early")
+                if line.startswith("Reload: "):
+                    return line[len("Reload: "):]
+
+        try:
+            next_reload()
+
+            (scripts / "base.gs2").write_text(source([], "function onPlayerEnters() { y = 2; }\n"))
+            if (reload := next_reload()) != "base, a, b, c":
+                self.problems.append(f"editing base reloads {reload}")
+
+            # c stops joining b, so editing b no longer affects it
+            (scripts / "c.gs2").write_text(source(["missing"]))
+            next_reload()
+            (scripts / "b.gs2").write_text(source(SCRIPTS["b"], "function onPlayerEnters() { y = 2; }\n"))
+            if (reload := next_reload()) != "b":
+                self.problems.append(f"editing b after c stopped joining it reloads {reload}")
+
+            # A save that doesn't compile keeps the joins a had
+            (scripts / "a.gs2").write_text(source(SCRIPTS["a"], "function broken() { y = 2\n}\n"))
+            if (reload := next_reload()) != "a, b":
+                self.problems.append(f"breaking a reloads {reload}")
+            (scripts / "base.gs2").write_text(source([], "function onPlayerEnters() { y = 3; }\n"))
+            if (reload := next_reload()) != "base, a, b":
+                self.problems.append(f"editing base while a doesn't compile reloads {reload}")
+
+            # Removing a class reloads the classes that joined it
+            (scripts / "a.gs2").unlink()
+            if (reload := next_reload()) != "b":
+                self.problems.append(f"removing a reloads {reload}")
+            (scripts / "base.gs2").write_text(source([]))
+            if (reload := next_reload()) != "base, b":
+                self.problems.append(f"editing base after removing a reloads {reload}")
+
+            # Events are lost while gs2test is stopped, among them the removal of
+            # base, which it has to find by scanning the directory again
+            watcher.send_signal(signal.SIGSTOP)
+            try:
+                for i in range(OVERFLOW_EVENTS):
+                    (scripts / f"flood{i % 2}.tmp").write_bytes(b"")
+                (scripts / "base.gs2").unlink()
+                (scripts / "c.gs2").write_text(source(["missing"], "function onPlayerEnters() { y = 2; }\n"))
+            finally:
+                watcher.send_signal(signal.SIGCONT)
+            if (reload := next_reload()) != "b, c":
+                self.problems.append(f"removing base while events were lost reloads {reload}")
+
+            watcher.send_signal(signal.SIGTERM)
+            watcher.wait(timeout=30)
+        except queue.Empty:
+            self.problems.append("timed out waiting for gs2test --watch")
+        finally:
+            if watcher.poll() is None:
+                watcher.kill()
+                watcher.wait()
+            reader.join()
+
+    def run(self) -> bool:
+        with tempfile.TemporaryDirectory(prefix="gs2deps_") as tmp:
+            self.test_directory(Path(tmp))
+            self.test_chain(Path(tmp))
+            if sys.platform.startswith("linux"):
+                self.test_watch(Path(tmp))
+
+        for problem in self.problems[:20]:
+            print(problem)
+
+        if self.problems:
+            print("Join graph failures detected")
+            return False
+
+        self.log("Join graph OK")
+        return True
+
+def main():
+    args = argument_parser("GS2 Join Graph Test", baselines=False).parse_args()
+    run_tester(GS2JoinGraphTester(args.compiler, args.quiet))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+GS2 Jump Width Test
+Compiles generated scripts with more ops than a 16-bit jump target can
+address and checks that every jump lands where it should: targets past
+32767 are written with the 32-bit 0xF5 operand, smaller ones keep the
+compact encoding, and the result passes --verify with and without -O.
+"""
+
+import sys
+import tempfile
+import subprocess
+from pathlib import Path
+from typing import List
+
+from gs2_test_support import JUMP_OPS, Bytecode, argument_parser, run_tester
+
+OP_SET_INDEX = 1
+OP_IF = 4
+OP_TYPE_VAR = 22
+INT16_MAX = 0x7FFF
+
+def generate(statements: int) -> str:
+    """An if block and a while, switch and with loop that each need `statements` * 6 ops"""
+    body = "".join(f"    a = a + {i};\n" for i in range(statements))
+    return (
+        "function onCreated() {\n"
+        f"  if (x) {{\n{body}  }}\n"
+        "  marker = \"end\";\n"
+        f"  while (a < 3) {{\n{body}    a++;\n  }}\n"
+        f"  switch (a) {{\n    case 1:\n{body}      break;\n    default:\n      a = 0;\n  }}\n"
+        f"  with (obj) {{\n{body}  }}\n"
+        "}\n"
+        "function other() {\n  b = 1;\n}\n"
+    )
+
+class GS2JumpTester:
+    """Runs gs2test over generated scripts and checks their jumps"""
+
+    def __init__(self, compiler_path: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.quiet = quiet
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _compile(self, script: Path, args: List[str]) -> bytes:
+        result = subprocess.run(
+            [str(self.compiler_path), "--verify", *args, str(script)],
+            capture_output=True,
+            text=True,
+            timeout=120
+        )
+
+        if result.returncode < 0:
+            raise RuntimeError(f"gs2test crashed with signal {-result.returncode}:\n{result.stderr}")
+
+        output = script.with_suffix(".gs2bc")
+        if result.returncode != 0 or not output.exists():
+            raise RuntimeError(f"{script.name} failed to compile with {' '.join(args)}:\n{result.stdout}{result.stderr}")
+
+        data = output.read_bytes()
+        output.unlink()
+        return data
+
+    def _check(self, name: str, script: Bytecode) -> List[str]:
+        problems = []
+        ops = list(script.ops())
+        op_count = len(ops)
+
+        jumps = [(i, op.prefix, op.value) for i, op in enumerate(ops) if op.code in JUMP_OPS]
+        for i, prefix, target in jumps:
+            if target > op_count:
+                problems.append(f"{name}: jump at op {i} to op {target}, past the end ({op_count} ops)")
+            elif (prefix == 0xF5) != (target > INT16_MAX):
+                problems.append(f"{name}: jump at op {i} to op {target} written with operand {prefix:#x}")
+
+        if problems:
+            return problems
+
+        # The prejump over the functions goes to the end of the script
+        if ops[0].code != OP_SET_INDEX or ops[0].value != op_count:
+            problems.append(f"{name}: prejump at op 0 doesn't skip the functions")
+
+        # The if block is skipped to the assignment following it
+        marker = script.strings.index(b"marker")
+        if_target = next(op.value for op in ops if op.code == OP_IF)
+        if ops[if_target].code != OP_TYPE_VAR or ops[if_target].value != marker:
+            problems.append(f"{name}: if block jumps to op {if_target} instead of the statement after it")
+
+        # The while loop jumps back to its condition, which follows the three ops of the marker assignment
+        condition = if_target + 3
+        loop_end = next(i for i, op in enumerate(ops) if op.code == OP_IF and i > if_target)
+        if not any(op.code == OP_SET_INDEX and op.value == condition for op in ops[loop_end:]):
+            problems.append(f"{name}: while loop at op {loop_end} doesn't jump back to its condition at op {condition}")
+
+        return problems
+
+    def run(self) -> bool:
+        problems = []
+        wide = 0
+        with tempfile.TemporaryDirectory(prefix="gs2jump_") as tmp:
+            # Below the limit, with only some jumps past it, and with the first if block past it
+            for statements in (100, 5400, 7000):
+                script = Path(tmp) / f"generated_{statements}.gs2"
+                script.write_text(generate(statements))
+
+                for args in ([], ["-O"]):
+                    name = f"{script.name} {' '.join(args)}".strip()
+                    try:
+                        compiled = Bytecode(self._compile(script, args))
+                    except RuntimeError as e:
+                        problems.append(str(e))
+                        continue
+
+                    problems.extend(self._check(name, compiled))
+                    ops = list(compiled.ops())
+                    wide += sum(1 for op in ops if op.code in JUMP_OPS and op.prefix == 0xF5)
+                    self.log(f"{name}: {len(ops)} ops")
+
+        if not wide:
+            problems.append("no jump was written with a 32-bit target")
+
+        for problem in problems:
+            print(problem)
+
+        if problems:
+            print("Jump width failures detected")
+            return False
+
+        self.log(f"All jumps OK, {wide} with 32-bit targets")
+        return True
+
+def main():
+    args = argument_parser("GS2 Jump Width Test", baselines=False).parse_args()
+    run_tester(GS2JumpTester(args.compiler, args.quiet))
+
+if __name__ == "__main__":
+    main()
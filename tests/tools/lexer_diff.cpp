@@ -0,0 +1,337 @@
+/*
+ * Differential test for the hand-written lexer (src/parser/GS2Lexer.cpp)
+ *
+ * Tokenizes every script under the given directory, a set of edge cases
+ * and randomly generated token soup with both the flex scanner and GS2Lexer,
+ * and compares the tokens, their semantic values and the line/column state
+ * of the parser context after each token.
+ *
+ * Usage: lexer_diff [scripts dir]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define close _close
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+#include "Parser.h"
+#include "gs2parser.tab.hh"
+#include "lex.yy.h"
+#include "GS2Lexer.h"
+
+int yylex(YYSTYPE *yylvalp, YYLTYPE *yyllocp, class ParserContext *parser, yyscan_t scanner);
+
+/*
+ * flex echoes the characters no rule matches, which the random inputs are
+ * full of. stdout is pointed at the null device while flex scans, so only
+ * mismatches and the summary are printed. This works on the file descriptor
+ * since not every scanner writes through yyout
+ */
+class EchoSilencer
+{
+public:
+	EchoSilencer()
+	{
+#ifdef _WIN32
+		static FILE *sink = std::fopen("NUL", "w");
+#else
+		static FILE *sink = std::fopen("/dev/null", "w");
+#endif
+		if (!sink)
+			return;
+
+		fflush(stdout);
+		saved = dup(fileno(stdout));
+		if (saved >= 0)
+			dup2(fileno(sink), fileno(stdout));
+	}
+
+	~EchoSilencer()
+	{
+		if (saved < 0)
+			return;
+
+		fflush(stdout);
+		dup2(saved, fileno(stdout));
+		close(saved);
+	}
+
+	EchoSilencer(const EchoSilencer&) = delete;
+	EchoSilencer& operator=(const EchoSilencer&) = delete;
+
+private:
+	int saved = -1;
+};
+
+struct Token
+{
+	int token;
+	std::string value;
+	int lineNumber;
+	int columnNumber;
+	YYLTYPE location;
+};
+
+struct Input
+{
+	std::string name;
+	std::string source;
+};
+
+namespace
+{
+	// Larger than any script, stops a lexer that doesn't advance
+	constexpr size_t MAX_TOKENS = 1000000;
+
+	const char *EDGE_CASES[] = {
+		// Strings and escapes
+		R"("")", R"("abc")", R"("a\"b")", R"("a\\" + "b")", R"("a\\\"b" "c")", R"("a
+b" x)", R"("unterminated)", R"(x = "a\" ; y = "b";)", "\"tab\tin\\tside\"",
+		// Character constants
+		"'a'", "'\\n'", "'\\''", "''", "'ab'", "'\\\n'", "'\n'", "'", "'\\",
+		// Numbers
+		"0x1F 0xff 0XFF 0x 0xg 0x1.5", "1.5 .5 1. 1..2 1.2.3 00012 3.x", "a.b.c", "2147483648 99999999999",
+		// Operators, longest match
+		"<<= >>= << >> <= >= => =< <> == != := @= @ ~ ? ! && || &= |= ^= %= += -= *= /= ++ -- ---",
+		"a=<b a=>b a<>b a:=b a::b ::a a:: : :",
+		// Identifiers and keywords
+		"$x a$b _ __ _a a_ NL SPC TAB NLx iffy in int intx float elseif else if xor",
+		"if::x Enum::member a::b::c a::$b a::1 function public const enum new with switch case default",
+		"continue return while for break",
+		// Comments
+		"a // comment\nb", "a // comment at end", "a /* block */ b", "a /* multi\nline\n*/ b",
+		"/***/ x /**/ y /* ** / */ z", "a /* unterminated\n", "a // */\nb", "a /* // */ b", "a/b/=c",
+		"/", "//", "/*",
+		// Whitespace and characters no rule matches
+		"a\r\nb\r\n", "\t \t a \t\n\n\n b", "# ` \\ \x01 \xc3\xa9 x", "",
+		// Longer than a vector
+		"averyveryveryveryveryveryveryveryveryverylongidentifier_0123456789 x",
+		"                                                                      x",
+		"\"a string that is long enough to cover a few vectors of the scanner\\\" and keeps going\"",
+		"/* a comment that is long enough to cover a few vectors of the scanner * / ** */ x",
+		"// a comment that is long enough to cover a few vectors of the scanner ******\nx",
+	};
+
+	std::string tokenValue(int token, const YYSTYPE& yylval)
+	{
+		switch (token)
+		{
+			case T_INT:
+				return std::to_string(yylval.ival);
+
+			case T_FLOAT:
+			case T_IDENTIFIER:
+			case T_STRCONSTANT:
+				return *yylval.sval;
+
+			case '@':
+				return std::to_string(int(yylval.cval));
+
+			default:
+				return {};
+		}
+	}
+
+	/*
+	 * Tokens of the input, and whether the lexer filled in the locations
+	 */
+	template<typename Lex>
+	bool tokenize(ParserContext& context, Lex&& lex, std::vector<Token>& tokens)
+	{
+		context.lineNumber = 1;
+		context.columnNumber = 0;
+		context.tokenColumn = 0;
+
+		// Kept between calls like bison does, a lexer only updates it when a rule matches
+		YYLTYPE yylloc{ -1, -1, -1, -1 };
+		for (;;)
+		{
+			YYSTYPE yylval{};
+			int token = lex(&yylval, &yylloc);
+
+			tokens.push_back({ token, tokenValue(token, yylval), context.lineNumber, context.columnNumber, yylloc });
+			if (token == 0 || tokens.size() >= MAX_TOKENS)
+				break;
+		}
+
+		bool hasLocations = yylloc.first_line != -1;
+		return hasLocations;
+	}
+
+	std::vector<Token> tokenizeFlex(ParserContext& context, const std::string& source, bool& hasLocations)
+	{
+		// flex writes into the buffer while scanning, so it gets its own copy
+		std::string buffer = source;
+		buffer.push_back('\0');
+		buffer.push_back('\0');
+
+		EchoSilencer silencer;
+
+		yyscan_t scanner;
+		yylex_init_extra(&context, &scanner);
+		auto state = yy_scan_buffer(buffer.data(), buffer.size(), scanner);
+
+		std::vector<Token> tokens;
+		hasLocations = tokenize(context, [&](YYSTYPE *yylval, YYLTYPE *yylloc) {
+			return yylex(yylval, yylloc, &context, scanner);
+		}, tokens);
+
+		yy_delete_buffer(state, scanner);
+		yylex_destroy(scanner);
+		return tokens;
+	}
+
+	std::vector<Token> tokenizeGS2Lexer(ParserContext& context, const std::string& source)
+	{
+		GS2Lexer lexer(&context);
+		lexer.setInput(source.c_str(), source.length());
+
+		std::vector<Token> tokens;
+		tokenize(context, [&](YYSTYPE *yylval, YYLTYPE *yylloc) {
+			return lexer.lex(yylval, yylloc);
+		}, tokens);
+
+		return tokens;
+	}
+
+	std::string describe(const Token& token, bool withLocation)
+	{
+		auto str = std::format("token {} value \"{}\" line {} column {}", token.token, token.value, token.lineNumber, token.columnNumber);
+		if (withLocation)
+		{
+			str += std::format(" location {}:{}-{}:{}", token.location.first_line, token.location.first_column,
+				token.location.last_line, token.location.last_column);
+		}
+		return str;
+	}
+
+	bool sameToken(const Token& a, const Token& b, bool withLocation)
+	{
+		if (a.token != b.token || a.value != b.value || a.lineNumber != b.lineNumber || a.columnNumber != b.columnNumber)
+			return false;
+
+		return !withLocation
+			|| (a.location.first_line == b.location.first_line && a.location.first_column == b.location.first_column
+				&& a.location.last_line == b.location.last_line && a.location.last_column == b.location.last_column);
+	}
+
+	/*
+	 * @return the number of tokens compared, or -1 on a mismatch
+	 */
+	long compare(const Input& input)
+	{
+		GS2ErrorService errorService;
+		ParserContext flexContext(errorService);
+		ParserContext lexerContext(errorService);
+
+		bool hasLocations;
+		auto expected = tokenizeFlex(flexContext, input.source, hasLocations);
+		auto actual = tokenizeGS2Lexer(lexerContext, input.source);
+
+		for (size_t i = 0; i < std::max(expected.size(), actual.size()); i++)
+		{
+			if (i < expected.size() && i < actual.size() && sameToken(expected[i], actual[i], hasLocations))
+				continue;
+
+			fprintf(stderr, "\n%s: token #%zu differs\n", input.name.c_str(), i);
+			if (i < expected.size())
+				fprintf(stderr, "  flex:     %s\n", describe(expected[i], hasLocations).c_str());
+			if (i < actual.size())
+				fprintf(stderr, "  GS2Lexer: %s\n", describe(actual[i], hasLocations).c_str());
+			return -1;
+		}
+
+		return long(expected.size());
+	}
+
+	std::string randomSource(std::mt19937& rng)
+	{
+		static const char *pieces[] = {
+			" ", "\t", "\n", "\"", "'", "\\", "/", "*", "a", "b_", "$", "0", "9", "x", "0x", ".", ":", "::", "=",
+			"<", ">", "@", "!", "|", "&", "+", "-", "%", "^", "(", ")", "{", "}", "[", "]", ";", ",", "?", "~",
+			"if", "NL", "int", "//", "/*", "*/", "\r",
+		};
+
+		std::uniform_int_distribution<size_t> pick(0, std::size(pieces) - 1);
+		std::uniform_int_distribution<int> length(0, 80);
+
+		std::string source;
+		for (int i = length(rng); i > 0; i--)
+			source += pieces[pick(rng)];
+
+		return source;
+	}
+
+	std::vector<Input> loadScripts(const std::filesystem::path& dir)
+	{
+		std::vector<Input> inputs;
+
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(dir, ec))
+		{
+			if (!entry.is_regular_file() || entry.path().extension() != ".gs2")
+				continue;
+
+			std::ifstream file(entry.path(), std::ios::binary);
+			inputs.push_back({
+				entry.path().lexically_relative(dir).generic_string(),
+				std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>())
+			});
+		}
+
+		std::sort(inputs.begin(), inputs.end(), [](const Input& a, const Input& b) { return a.name < b.name; });
+		return inputs;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<Input> inputs;
+	if (argc > 1)
+	{
+		inputs = loadScripts(argv[1]);
+		if (inputs.empty())
+		{
+			fprintf(stderr, "No scripts found in %s\n", argv[1]);
+			return 1;
+		}
+	}
+
+	for (size_t i = 0; i < std::size(EDGE_CASES); i++)
+		inputs.push_back({ std::format("edge case #{}", i), EDGE_CASES[i] });
+
+	// Fixed seed, so a failure can be reproduced
+	std::mt19937 rng(1234);
+	for (int i = 0; i < 2000; i++)
+		inputs.push_back({ std::format("random input #{}", i), randomSource(rng) });
+
+	long tokens = 0;
+	int failures = 0;
+	for (const auto& input : inputs)
+	{
+		long count = compare(input);
+		if (count < 0)
+			failures++;
+		else
+			tokens += count;
+	}
+
+	printf("\nCompared %ld tokens in %zu inputs, %d mismatched\n", tokens, inputs.size(), failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+#!/usr/bin/env python3
+"""
+GS2 Compile Server Test
+Starts gs2test --serve and sends it every test script over several
+connections at once, with requests pipelined and answered out of order.
+Checks the bytecode against the baselines, that failing scripts come
+back with their errors, that a burst of more requests than the server
+takes at once is answered in full, also when the client closes its side
+right after sending it, that a malformed request only closes its own
+connection, and that the server removes its socket when terminated.
+"""
+
+import sys
+import time
+import signal
+import socket
+import hashlib
+import tempfile
+import threading
+import subprocess
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+from gs2_test_support import argument_parser, load_baselines, run_tester
+
+CONNECTIONS = 4
+BURST_REQUESTS = 5000
+HALF_CLOSED_REQUESTS = 300
+HALF_CLOSED_ROUNDS = 20
+
+def frame(payload: bytes) -> bytes:
+    return len(payload).to_bytes(4, "big") + payload
+
+def string(data: bytes) -> bytes:
+    return len(data).to_bytes(4, "big") + data
+
+def request(request_id: int, source: bytes, script_type: bytes = b"", script_name: bytes = b"", save_to_disk: bool = False) -> bytes:
+    return frame(request_id.to_bytes(4, "big") + bytes([save_to_disk]) + string(script_type) + string(script_name) + string(source))
+
+class Reader:
+    def __init__(self, data: bytes):
+        self.data = data
+        self.pos = 0
+
+    def take(self, count: int) -> bytes:
+        if count > len(self.data) - self.pos:
+            raise ValueError("response ends early")
+        value = self.data[self.pos:self.pos + count]
+        self.pos += count
+        return value
+
+    def u8(self) -> int:
+        return self.take(1)[0]
+
+    def u32(self) -> int:
+        return int.from_bytes(self.take(4), "big")
+
+    def str(self) -> bytes:
+        return self.take(self.u32())
+
+def parse_response(payload: bytes) -> dict:
+    reader = Reader(payload)
+    response = {
+        "id": reader.u32(),
+        "success": reader.u8() != 0,
+        "bytecode": reader.str(),
+        "classes": [reader.str() for _ in range(reader.u32())],
+    }
+    response["errors"] = [
+        {"level": reader.u8(), "category": reader.u8(), "line": reader.u32(), "column": reader.u32(),
+         "length": reader.u32(), "msg": reader.str().decode(errors="replace")}
+        for _ in range(reader.u32())
+    ]
+    if reader.pos != len(payload):
+        raise ValueError("trailing bytes in response")
+    return response
+
+def recv_exact(sock: socket.socket, count: int) -> Optional[bytes]:
+    data = bytearray()
+    while len(data) < count:
+        chunk = sock.recv(count - len(data))
+        if not chunk:
+            return None
+        data.extend(chunk)
+    return bytes(data)
+
+def recv_response(sock: socket.socket) -> Optional[dict]:
+    header = recv_exact(sock, 4)
+    if header is None:
+        return None
+    payload = recv_exact(sock, int.from_bytes(header, "big"))
+    if payload is None:
+        raise ValueError("connection closed in the middle of a response")
+    return parse_response(payload)
+
+class GS2ServerTester:
+    """Runs gs2test --serve and compiles the test scripts through it"""
+
+    def __init__(self, compiler_path: Path, scripts_dir: Path, baselines_dir: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.scripts_dir = scripts_dir
+        self.baselines_dir = baselines_dir
+        self.quiet = quiet
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _connect(self, path: Path) -> socket.socket:
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.settimeout(60)
+        sock.connect(str(path))
+        return sock
+
+    def _compile_all(self, path: Path, baselines: List[Tuple[Path, dict]], offset: int) -> Tuple[Dict[int, dict], List[str]]:
+        """Sends every script down one connection before reading any response"""
+        problems = []
+        responses = {}
+        sock = self._connect(path)
+
+        # Read on another thread, so neither side blocks on a full socket buffer
+        def read():
+            try:
+                while len(responses) < len(baselines):
+                    response = recv_response(sock)
+                    if response is None:
+                        problems.append("connection closed before every response arrived")
+                        return
+                    if response["id"] in responses:
+                        problems.append(f"response {response['id']} received twice")
+                    responses[response["id"]] = response
+            except (ValueError, OSError) as e:
+                problems.append(f"reading responses failed: {e}")
+
+        reader = threading.Thread(target=read)
+        reader.start()
+
+        data = b"".join(request(offset + i, (self.scripts_dir / rel).read_bytes()) for i, (rel, _) in enumerate(baselines))
+        sock.sendall(data)
+        sock.shutdown(socket.SHUT_WR)
+
+        reader.join()
+        sock.close()
+        return {id - offset: response for id, response in responses.items()}, problems
+
+    def _burst(self, path: Path, count: int) -> Tuple[Dict[int, dict], List[str]]:
+        """Sends count small requests in one write, reading the responses on another thread"""
+        problems = []
+        responses = {}
+        sock = self._connect(path)
+
+        def read():
+            try:
+                while len(responses) < count:
+                    response = recv_response(sock)
+                    if response is None:
+                        problems.append("connection closed before every burst response arrived")
+                        return
+                    responses[response["id"]] = response
+            except (ValueError, OSError) as e:
+                problems.append(f"reading burst responses failed: {e}")
+
+        reader = threading.Thread(target=read)
+        reader.start()
+
+        sock.sendall(b"".join(request(i, f"x = {i};".encode()) for i in range(count)))
+        sock.shutdown(socket.SHUT_WR)
+
+        reader.join()
+        sock.close()
+        return responses, problems
+
+    def _check(self, baselines: List[Tuple[Path, dict]], responses: Dict[int, dict]) -> List[str]:
+        problems = []
+        for i, (rel, baseline) in enumerate(baselines):
+            response = responses.get(i)
+            if response is None:
+                problems.append(f"{rel}: no response")
+                continue
+
+            if response["success"] != baseline["compilation_success"]:
+                problems.append(f"{rel}: success is {response['success']}, expected {baseline['compilation_success']}")
+            elif response["success"]:
+                if hashlib.sha256(response["bytecode"]).hexdigest() != baseline["bytecode_hash"]:
+                    problems.append(f"{rel}: bytecode differs from the baseline")
+                if response["errors"]:
+                    problems.append(f"{rel}: compiled with errors")
+            elif not response["errors"] or not all(error["msg"] for error in response["errors"]):
+                problems.append(f"{rel}: failed without an error message")
+
+        return problems
+
+    def run(self) -> bool:
+        baselines = load_baselines(self.scripts_dir, self.baselines_dir)
+        if not baselines:
+            print("No baselines found")
+            return False
+
+        problems = []
+        with tempfile.TemporaryDirectory(prefix="gs2serve_") as tmp:
+            path = Path(tmp) / "gs2.sock"
+            server = subprocess.Popen(
+                [str(self.compiler_path), "--serve", str(path), "-j", "2"],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                text=True
+            )
+
+            try:
+                deadline = time.monotonic() + 30
+                while not path.exists():
+                    if server.poll() is not None or time.monotonic() > deadline:
+                        raise RuntimeError(f"server did not start:\n{server.stderr.read()}")
+                    time.sleep(0.01)
+
+                # A second server must not take over the socket
+                second = subprocess.run([str(self.compiler_path), "--serve", str(path)], capture_output=True, text=True, timeout=30)
+                if second.returncode == 0:
+                    problems.append("a second server started on the same socket")
+
+                # Every connection sends the whole corpus at once, with its own range of ids
+                self.log(f"Compiling {len(baselines)} scripts on {CONNECTIONS} connections")
+                results: List[Tuple[Dict[int, dict], List[str]]] = [None] * CONNECTIONS
+                def client(n: int):
+                    results[n] = self._compile_all(path, baselines, n * 100000)
+
+                clients = [threading.Thread(target=client, args=(n,)) for n in range(CONNECTIONS)]
+                for thread in clients:
+                    thread.start()
+                for thread in clients:
+                    thread.join()
+
+                for responses, errors in results:
+                    problems.extend(errors)
+                    problems.extend(self._check(baselines, responses))
+
+                # Joined classes and the script header
+                with self._connect(path) as sock:
+                    sock.sendall(request(7, b'join("a"); join("b"); function onCreated() { x = 1; }', b"weapon", b"-Test", True))
+                    response = recv_response(sock)
+                    if response is None or response["id"] != 7 or not response["success"]:
+                        problems.append("script with a header did not compile")
+                    else:
+                        if sorted(response["classes"]) != [b"a", b"b"]:
+                            problems.append(f"joined classes are {response['classes']}")
+                        if b"weapon,-Test,1," not in response["bytecode"][:32]:
+                            problems.append("bytecode is missing the script header")
+
+                # More pipelined requests than the server takes at once, sent in one burst
+                burst, burst_problems = self._burst(path, BURST_REQUESTS)
+                problems.extend(burst_problems)
+                if sorted(burst) != list(range(BURST_REQUESTS)):
+                    problems.append(f"burst of {BURST_REQUESTS} requests got {len(burst)} responses")
+                elif not all(response["success"] for response in burst.values()):
+                    problems.append("burst requests failed to compile")
+
+                # Just over the pipelining limit, with the write side closed right away, so the
+                # server sees the end of the input while requests are still held back
+                for _ in range(HALF_CLOSED_ROUNDS):
+                    held, held_problems = self._burst(path, HALF_CLOSED_REQUESTS)
+                    if held_problems or sorted(held) != list(range(HALF_CLOSED_REQUESTS)):
+                        problems.extend(held_problems)
+                        problems.append(f"half-closed connection got {len(held)} of {HALF_CLOSED_REQUESTS} responses")
+                        break
+
+                # A malformed request closes its connection, and nothing else
+                with self._connect(path) as sock:
+                    sock.sendall(frame(b"\x00\x00\x00\x01\x00\xff\xff\xff\xff"))
+                    if recv_exact(sock, 1) is not None:
+                        problems.append("malformed request was answered")
+
+                with self._connect(path) as sock:
+                    sock.sendall(request(1, b"x = 1;"))
+                    response = recv_response(sock)
+                    if response is None or not response["success"]:
+                        problems.append("server stopped serving after a malformed request")
+
+                server.send_signal(signal.SIGTERM)
+                stdout, stderr = server.communicate(timeout=30)
+                if server.returncode != 0:
+                    problems.append(f"server exited with {server.returncode}:\n{stderr}")
+                if path.exists():
+                    problems.append("socket was not removed on exit")
+                self.log(stdout.strip())
+            finally:
+                if server.poll() is None:
+                    server.kill()
+                    server.wait()
+
+        for problem in problems[:20]:
+            print(problem)
+
+        if problems:
+            print("Compile server failures detected")
+            return False
+
+        self.log("Compile server OK")
+        return True
+
+def main():
+    args = argument_parser("GS2 Compile Server Test").parse_args()
+    run_tester(GS2ServerTester(args.compiler, args.scripts_dir, args.baselines_dir, args.quiet))
+
+if __name__ == "__main__":
+    main()
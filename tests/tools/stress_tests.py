@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+GS2 Parser Concurrency Stress Test
+Compiles the test scripts on many threads at once (gs2test -j) and checks that
+every result matches a single-threaded compile, so any state shared between
+GS2Context instances shows up as corrupted bytecode.
+
+Build with -DGS2PARSER_ENABLE_TSAN=ON to also have ThreadSanitizer report any
+data race, the test fails as soon as a race is detected.
+"""
+
+import os
+import sys
+import shutil
+import hashlib
+import tempfile
+import subprocess
+from pathlib import Path
+from typing import Dict, List
+
+from gs2_test_support import argument_parser, load_baselines, run_tester
+
+# Exit code used by ThreadSanitizer when it reports a race, see TSAN_OPTIONS below
+TSAN_EXIT_CODE = 66
+
+class GS2StressTester:
+    """Runs concurrent compiles and compares them against reference outputs"""
+
+    def __init__(self, compiler_path: Path, scripts_dir: Path, baselines_dir: Path,
+                 jobs: int, rounds: int, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.scripts_dir = scripts_dir
+        self.baselines_dir = baselines_dir
+        self.jobs = jobs
+        self.rounds = rounds
+        self.quiet = quiet
+
+        self.env = dict(os.environ)
+        self.env["TSAN_OPTIONS"] = f"halt_on_error=1 exitcode={TSAN_EXIT_CODE} " + self.env.get("TSAN_OPTIONS", "")
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _output_path(self, script_path: Path) -> Path:
+        return script_path.with_suffix(script_path.suffix + "bc")
+
+    def _compile(self, scripts: List[Path], extra_args: List[str]) -> Dict[Path, str]:
+        """Compile the scripts in one gs2test process, returning the hash of each output"""
+        result = subprocess.run(
+            [str(self.compiler_path), *extra_args, *map(str, scripts)],
+            capture_output=True,
+            text=True,
+            env=self.env,
+            timeout=300
+        )
+
+        if result.returncode == TSAN_EXIT_CODE or "ThreadSanitizer" in result.stderr:
+            raise RuntimeError(f"ThreadSanitizer reported a data race:\n{result.stderr}")
+
+        if result.returncode < 0:
+            raise RuntimeError(f"gs2test crashed with signal {-result.returncode}:\n{result.stderr}")
+
+        hashes = {}
+        for script in scripts:
+            output = self._output_path(script)
+            if output.exists():
+                hashes[script] = hashlib.sha256(output.read_bytes()).hexdigest()
+                output.unlink()
+            else:
+                hashes[script] = ""
+
+        return hashes
+
+    def _load_baseline_hashes(self, work_dir: Path, scripts: List[Path]) -> Dict[Path, str]:
+        """Expected hashes for the default compiler options, from the regression baselines"""
+        return {
+            work_dir / rel: data["bytecode_hash"] if data["compilation_success"] else ""
+            for rel, data in load_baselines(work_dir, self.baselines_dir)
+        }
+
+    def _compare(self, expected: Dict[Path, str], actual: Dict[Path, str], work_dir: Path) -> List[str]:
+        mismatches = []
+        for script, expected_hash in expected.items():
+            if actual.get(script, "") != expected_hash:
+                mismatches.append(str(script.relative_to(work_dir)))
+        return mismatches
+
+    def run(self) -> bool:
+        with tempfile.TemporaryDirectory(prefix="gs2stress_") as tmp:
+            # Outputs are written next to the scripts, so compile a copy of them
+            work_dir = Path(tmp) / "scripts"
+            shutil.copytree(self.scripts_dir, work_dir)
+            scripts = sorted(work_dir.rglob("*.gs2"))
+
+            # Each variant is checked against its own reference: the baselines
+            # for the default options, a single-threaded compile for -O
+            variants = [
+                ("default", [], self._load_baseline_hashes(work_dir, scripts)),
+                ("optimized", ["-O"], self._compile(scripts, ["-O"])),
+            ]
+
+            self.log(f"Stress testing {len(scripts)} scripts, {self.rounds} rounds on {self.jobs} threads")
+
+            failures = 0
+            for round_idx in range(self.rounds):
+                for name, args, expected in variants:
+                    actual = self._compile(scripts, ["-j", str(self.jobs), *args])
+                    mismatches = self._compare(expected, actual, work_dir)
+
+                    if mismatches:
+                        failures += 1
+                        print(f"Round {round_idx + 1} ({name}): {len(mismatches)} mismatched outputs")
+                        for path in mismatches[:10]:
+                            print(f"  {path}")
+                    else:
+                        self.log(f"Round {round_idx + 1} ({name}): OK")
+
+            if failures:
+                print("Concurrency failures detected")
+                return False
+
+            self.log("All rounds matched")
+            return True
+
+def main():
+    parser = argument_parser("GS2 Parser Concurrency Stress Test")
+    parser.add_argument("--jobs", type=int, default=8, help="Number of compiler threads")
+    parser.add_argument("--rounds", type=int, default=5, help="Number of times every script is compiled")
+
+    args = parser.parse_args()
+
+    run_tester(GS2StressTester(args.compiler, args.scripts_dir, args.baselines_dir,
+                               args.jobs, args.rounds, args.quiet))
+
+if __name__ == "__main__":
+    main()
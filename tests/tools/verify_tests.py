@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""
+GS2 Bytecode Verifier Test
+Checks that the verifier accepts everything the compiler produces: every
+baseline, and every script compiled with --verify (with and without -O)
+still matching its baseline. Then corrupts a baseline in the ways a
+compiler bug would (jumps past the end, string indices past the string
+table, unknown ops, broken segments) and checks each one is rejected.
+"""
+
+import sys
+import shutil
+import hashlib
+import tempfile
+import subprocess
+from pathlib import Path
+from typing import List, Optional, Set, Tuple
+
+from gs2_test_support import (JUMP_OPS, SEGMENT_BYTECODE, SEGMENT_FUNCTIONS, Bytecode,
+    argument_parser, load_baselines, run_tester)
+
+STRING_OPS = {21, 22}
+
+def corruptions(script: Bytecode) -> List[Tuple[str, Optional[bytes]]]:
+    """Every way of breaking the script, paired with the corrupted bytes"""
+    ops = list(script.ops())
+    _, bytecode_start, _ = script.segments[SEGMENT_BYTECODE]
+    _, function_table, function_table_length = script.segments[SEGMENT_FUNCTIONS]
+    first_segment = min(offset for offset, _, _ in script.segments.values())
+
+    def first(codes: Set[int], prefix: int) -> Optional[int]:
+        return next((op.offset for op in ops if op.code in codes and op.prefix == prefix), None)
+
+    jump = first(JUMP_OPS, 0xF4)
+    string = first(STRING_OPS, 0xF1)
+    string_byte = first(STRING_OPS, 0xF0)
+
+    return [
+        ("jump past the end", jump and script.patch(jump, (0xFFFF).to_bytes(2, "big"))),
+        ("string index past the string table", string and script.patch(string, (0xFFFF).to_bytes(2, "big"))),
+        ("string index past the string table", string_byte and len(script.strings) < 256 and script.patch(string_byte, bytes([0xFF]))),
+        ("unknown op", script.patch(bytecode_start, bytes([12]))),
+        ("stray operand prefix", script.patch(bytecode_start, bytes([0xF3]))),
+        ("jump without a target", jump and script.patch(jump - 1, bytes([0xF0]))),
+        ("function past the end", function_table_length and script.patch(function_table, (0x7FFFFFFF).to_bytes(4, "big"))),
+        ("missing line feed", script.data[:-1]),
+        ("truncated", script.data[:len(script.data) // 2]),
+        ("segments out of order", script.patch(first_segment, SEGMENT_FUNCTIONS.to_bytes(4, "big"))),
+    ]
+
+class GS2VerifyTester:
+    """Runs gs2test --verify over the baselines and corrupted copies of them"""
+
+    def __init__(self, compiler_path: Path, scripts_dir: Path, baselines_dir: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.scripts_dir = scripts_dir
+        self.baselines_dir = baselines_dir
+        self.quiet = quiet
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _run(self, args: List[str]) -> subprocess.CompletedProcess:
+        result = subprocess.run(
+            [str(self.compiler_path), *args],
+            capture_output=True,
+            text=True,
+            timeout=120
+        )
+
+        if result.returncode < 0:
+            raise RuntimeError(f"gs2test crashed with signal {-result.returncode}:\n{result.stderr}")
+
+        return result
+
+    def _baselines(self) -> List[Tuple[Path, str]]:
+        """Scripts that compile, with the hash of their baseline bytecode"""
+        return [(rel, data["bytecode_hash"]) for rel, data in load_baselines(self.scripts_dir, self.baselines_dir, compiled_only=True)]
+
+    def run(self) -> bool:
+        baselines = self._baselines()
+        if not baselines:
+            print("No baselines found")
+            return False
+
+        problems = []
+        with tempfile.TemporaryDirectory(prefix="gs2verify_") as tmp:
+            work_dir = Path(tmp) / "scripts"
+            shutil.copytree(self.scripts_dir, work_dir)
+            scripts = [work_dir / rel for rel, _ in baselines]
+
+            # The verifier must accept, and not change, anything the compiler produces
+            self.log(f"Compiling {len(scripts)} scripts with --verify")
+            for args in ([], ["-O"]):
+                result = self._run(["--verify", *args, *map(str, scripts)])
+                for (rel, expected_hash), script in zip(baselines, scripts):
+                    output = script.with_suffix(".gs2bc")
+                    if not output.exists():
+                        problems.append(f"{rel}: rejected with --verify {' '.join(args)}")
+                        continue
+
+                    if not args and hashlib.sha256(output.read_bytes()).hexdigest() != expected_hash:
+                        problems.append(f"{rel}: output with --verify differs from the baseline")
+                    output.unlink()
+
+                if "bytecode verification failed" in result.stdout + result.stderr:
+                    problems.append(f"verification failed with --verify {' '.join(args)}:\n{result.stdout}")
+
+            bytecode_dir = Path(tmp) / "bytecode"
+            bytecode_dir.mkdir()
+            for i, (rel, _) in enumerate(baselines):
+                shutil.copy(self.baselines_dir / rel.with_suffix(".bytecode"), bytecode_dir / f"{i}.gs2bc")
+
+            result = self._run(["--disasm", "--verify", str(bytecode_dir), "-o", str(Path(tmp) / "listing.txt")])
+            if result.returncode != 0:
+                problems.append(f"baselines rejected:\n{result.stderr}")
+
+            # Corrupt the largest baseline, it has every kind of operand
+            largest = max((self.baselines_dir / rel.with_suffix(".bytecode") for rel, _ in baselines), key=lambda p: p.stat().st_size)
+            script = Bytecode(largest.read_bytes())
+            corrupted_path = Path(tmp) / "corrupted.gs2bc"
+
+            tested = rejected = 0
+            for name, data in corruptions(script):
+                if not data:
+                    continue
+
+                corrupted_path.write_bytes(data)
+                result = self._run(["--disasm", "--verify", str(corrupted_path)])
+                tested += 1
+                if result.returncode == 1 and "bytecode verification failed" in result.stderr:
+                    rejected += 1
+                else:
+                    problems.append(f"{largest.name}: {name} was not rejected")
+
+            self.log(f"Rejected {rejected} of {tested} corrupted scripts")
+
+        for problem in problems:
+            print(problem)
+
+        if problems:
+            print("Verifier failures detected")
+            return False
+
+        self.log("Verifier OK")
+        return True
+
+def main():
+    args = argument_parser("GS2 Bytecode Verifier Test").parse_args()
+    run_tester(GS2VerifyTester(args.compiler, args.scripts_dir, args.baselines_dir, args.quiet))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""
+GS2 Watch Mode Test
+Copies the test scripts into a temporary directory and runs gs2test --watch
+on it. Checks the initial build against the baselines, then edits the
+directory the way editors do (writing in place, saving over the file with
+a rename, saving without changes, adding a file) and checks that every
+round compiles exactly the scripts that changed. Finally rewrites a script
+many times in a row, and checks that gs2test survives and its output
+matches the last save.
+"""
+
+import os
+import sys
+import queue
+import signal
+import time
+import hashlib
+import tempfile
+import threading
+import subprocess
+from pathlib import Path
+from typing import Dict, List, Optional, Set
+
+from gs2_test_support import argument_parser, load_baselines, run_tester
+
+ROUND_TIMEOUT = 30
+REWRITES = 200
+
+class GS2WatchTester:
+    """Runs gs2test --watch and edits the directory it watches"""
+
+    def __init__(self, compiler_path: Path, scripts_dir: Path, baselines_dir: Path, quiet: bool = False):
+        self.compiler_path = compiler_path
+        self.scripts_dir = scripts_dir
+        self.baselines_dir = baselines_dir
+        self.quiet = quiet
+        self.lines: "queue.Queue[Optional[str]]" = queue.Queue()
+
+    def log(self, msg: str):
+        if not self.quiet:
+            print(msg)
+
+    def _read_output(self, stream):
+        for line in stream:
+            self.lines.put(line.rstrip("\n"))
+        self.lines.put(None)
+
+    def _next_line(self) -> str:
+        try:
+            line = self.lines.get(timeout=ROUND_TIMEOUT)
+        except queue.Empty:
+            raise RuntimeError("timed out waiting for gs2test")
+        if line is None:
+            raise RuntimeError("gs2test exited early")
+        return line
+
+    def _wait_for(self, prefix: str) -> List[str]:
+        """Returns the output up to and including the first line starting with prefix"""
+        lines = []
+        while True:
+            line = self._next_line()
+            lines.append(line)
+            if line.startswith(prefix):
+                return lines
+
+    @staticmethod
+    def _compiled(lines: List[str]) -> Set[str]:
+        # The scanner echoes characters it can't match, which can end up in front of the name
+        return {line.partition("Compiled: ")[2] for line in lines if "Compiled: " in line}
+
+    def _round(self) -> Set[str]:
+        """Returns the names of the scripts compiled in the next round"""
+        return self._compiled(self._wait_for("Compiled "))
+
+    @staticmethod
+    def _hash(path: Path) -> str:
+        return hashlib.sha256(path.read_bytes()).hexdigest()
+
+    def run(self) -> bool:
+        baselines = load_baselines(self.scripts_dir, self.baselines_dir)
+        compiled = [(rel, baseline) for rel, baseline in baselines if baseline["compilation_success"]]
+        if len(compiled) < 2:
+            print("No baselines found")
+            return False
+
+        problems = []
+        with tempfile.TemporaryDirectory(prefix="gs2watch_") as tmp:
+            watched = Path(tmp)
+
+            # Watching isn't recursive, the scripts are flattened into one directory
+            names: Dict[str, dict] = {}
+            for rel, baseline in baselines:
+                name = "__".join(rel.parts)
+                (watched / name).write_bytes((self.scripts_dir / rel).read_bytes())
+                names[name] = baseline
+
+            watcher = subprocess.Popen(
+                [str(self.compiler_path), "--watch", str(watched), "-j", "2"],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.DEVNULL,
+                text=True
+            )
+            reader = threading.Thread(target=self._read_output, args=(watcher.stdout,))
+            reader.start()
+
+            try:
+                initial = self._compiled(self._wait_for("Watching "))
+                if initial != set(names):
+                    problems.append(f"initial build compiled {len(initial)} of {len(names)} scripts")
+
+                for name, baseline in names.items():
+                    if baseline["compilation_success"] and self._hash((watched / name).with_suffix(".gs2bc")) != baseline["bytecode_hash"]:
+                        problems.append(f"{name}: bytecode differs from the baseline")
+
+                target = "__".join(compiled[0][0].parts)
+                target_path = watched / target
+                other_source = (self.scripts_dir / compiled[1][0]).read_bytes()
+                other_hash = compiled[1][1]["bytecode_hash"]
+
+                # Written in place
+                self.log(f"Editing {target}")
+                target_path.write_bytes(other_source)
+                changed = self._round()
+                if changed != {target}:
+                    problems.append(f"editing {target} compiled {sorted(changed)}")
+                if self._hash(target_path.with_suffix(".gs2bc")) != other_hash:
+                    problems.append(f"{target}: bytecode was not updated")
+
+                # Saved without changes, then a new file: only the new file is compiled
+                target_path.write_bytes(other_source)
+                (watched / "new.gs2").write_bytes(other_source)
+                changed = self._round()
+                if changed != {"new.gs2"}:
+                    problems.append(f"saving without changes and adding a file compiled {sorted(changed)}")
+                if not (watched / "new.gs2bc").exists() or self._hash(watched / "new.gs2bc") != other_hash:
+                    problems.append("new.gs2: bytecode is missing or wrong")
+
+                # Saved through a temporary file that is renamed over the script
+                original = self.scripts_dir / compiled[0][0]
+                swap = watched / f".{target}.swp"
+                swap.write_bytes(original.read_bytes())
+                os.rename(swap, target_path)
+                changed = self._round()
+                if changed != {target}:
+                    problems.append(f"renaming over {target} compiled {sorted(changed)}")
+                if self._hash(target_path.with_suffix(".gs2bc")) != compiled[0][1]["bytecode_hash"]:
+                    problems.append(f"{target}: bytecode was not updated after the rename")
+
+                # Rewritten in place over and over while rounds compile it, gs2test must
+                # survive and the output must end up matching the last save
+                original_source = original.read_bytes()
+                for i in range(REWRITES + 1):
+                    target_path.write_bytes(other_source if i % 2 == 0 else original_source)
+
+                deadline = time.monotonic() + ROUND_TIMEOUT
+                while self._hash(target_path.with_suffix(".gs2bc")) != other_hash:
+                    if watcher.poll() is not None or time.monotonic() > deadline:
+                        problems.append(f"{target}: bytecode doesn't match the last of {REWRITES} saves")
+                        break
+                    time.sleep(0.01)
+
+                watcher.send_signal(signal.SIGTERM)
+                watcher.wait(timeout=30)
+                if watcher.returncode != 0:
+                    problems.append(f"gs2test exited with {watcher.returncode}")
+            finally:
+                if watcher.poll() is None:
+                    watcher.kill()
+                    watcher.wait()
+                reader.join()
+
+        for problem in problems[:20]:
+            print(problem)
+
+        if problems:
+            print("Watch mode failures detected")
+            return False
+
+        self.log("Watch mode OK")
+        return True
+
+def main():
+    args = argument_parser("GS2 Watch Mode Test").parse_args()
+    run_tester(GS2WatchTester(args.compiler, args.scripts_dir, args.baselines_dir, args.quiet))
+
+if __name__ == "__main__":
+    main()